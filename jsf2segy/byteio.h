@@ -0,0 +1,269 @@
+/*
+ * byteio.h
+ *
+ * Allocation free load and store primitives for the fields of JSF
+ * messages (little-endian) and SEG Y headers and samples (big-endian).
+ *
+ * All loads and stores go through memcpy so they are safe on unaligned
+ * addresses; gcc turns them into a single move (plus a bswap when the
+ * byte order differs).  The host byte order is resolved at compile time
+ * so there is no run time test and no heap traffic.
+ *
+ * get_short(), get_int(), get_float() and get_double() keep the calling
+ * convention of the old calloc based routines in jsf2segy.c: a buffer
+ * and a byte location, returning the little-endian JSF value.
+ */
+
+#ifndef _BYTEIO_H_
+#define _BYTEIO_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined (__BYTE_ORDER__) && defined (__ORDER_BIG_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BIG_ENDIAN 1
+#else
+#define HOST_BIG_ENDIAN 0
+#endif
+#elif defined (mc68000) || defined (sony) || defined(sgi) || defined(sun) || defined (_BIG_ENDIAN)
+#define HOST_BIG_ENDIAN 1
+#else
+#define HOST_BIG_ENDIAN 0
+#endif
+
+#define bswap16(x) __builtin_bswap16 (x)
+#define bswap32(x) __builtin_bswap32 (x)
+#define bswap64(x) __builtin_bswap64 (x)
+
+/*
+ * Little-endian loads (JSF)
+ */
+
+static inline uint16_t
+ld_le16 (const unsigned char *p)
+{
+  uint16_t v;
+
+  memcpy (&v, p, sizeof (v));
+  return HOST_BIG_ENDIAN ? bswap16 (v) : v;
+}
+
+static inline uint32_t
+ld_le32 (const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy (&v, p, sizeof (v));
+  return HOST_BIG_ENDIAN ? bswap32 (v) : v;
+}
+
+static inline uint64_t
+ld_le64 (const unsigned char *p)
+{
+  uint64_t v;
+
+  memcpy (&v, p, sizeof (v));
+  return HOST_BIG_ENDIAN ? bswap64 (v) : v;
+}
+
+static inline float
+ld_lef32 (const unsigned char *p)
+{
+  uint32_t v = ld_le32 (p);
+  float f;
+
+  memcpy (&f, &v, sizeof (f));
+  return f;
+}
+
+static inline double
+ld_lef64 (const unsigned char *p)
+{
+  uint64_t v = ld_le64 (p);
+  double d;
+
+  memcpy (&d, &v, sizeof (d));
+  return d;
+}
+
+/*
+ * Big-endian loads and stores (SEG Y)
+ */
+
+static inline uint16_t
+ld_be16 (const unsigned char *p)
+{
+  uint16_t v;
+
+  memcpy (&v, p, sizeof (v));
+  return HOST_BIG_ENDIAN ? v : bswap16 (v);
+}
+
+static inline uint32_t
+ld_be32 (const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy (&v, p, sizeof (v));
+  return HOST_BIG_ENDIAN ? v : bswap32 (v);
+}
+
+static inline void
+st_be16 (unsigned char *p, uint16_t v)
+{
+  if (!HOST_BIG_ENDIAN)
+    v = bswap16 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_be32 (unsigned char *p, uint32_t v)
+{
+  if (!HOST_BIG_ENDIAN)
+    v = bswap32 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_be64 (unsigned char *p, uint64_t v)
+{
+  if (!HOST_BIG_ENDIAN)
+    v = bswap64 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_bef32 (unsigned char *p, float f)
+{
+  uint32_t v;
+
+  memcpy (&v, &f, sizeof (v));
+  st_be32 (p, v);
+}
+
+static inline void
+st_le16 (unsigned char *p, uint16_t v)
+{
+  if (HOST_BIG_ENDIAN)
+    v = bswap16 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_le32 (unsigned char *p, uint32_t v)
+{
+  if (HOST_BIG_ENDIAN)
+    v = bswap32 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_le64 (unsigned char *p, uint64_t v)
+{
+  if (HOST_BIG_ENDIAN)
+    v = bswap64 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+/*
+ * JSF field decoders
+ */
+
+static inline short
+get_short (const unsigned char *inbuf, int location)
+{
+  return (short) ld_le16 (inbuf + location);
+}
+
+static inline int
+get_int (const unsigned char *buf, int location)
+{
+  return (int) ld_le32 (buf + location);
+}
+
+static inline float
+get_float (const unsigned char *inbuf, int location)
+{
+  return ld_lef32 (inbuf + location);
+}
+
+static inline double
+get_double (const unsigned char *inbuf, int location)
+{
+  return ld_lef64 (inbuf + location);
+}
+
+/*
+ * Byte swapping routines
+ */
+
+//! Byte swap unsigned short
+static inline uint16_t
+swap_uint16 (uint16_t val)
+{
+  return bswap16 (val);
+}
+
+//! Byte swap short
+static inline int16_t
+swap_int16 (int16_t val)
+{
+  return (int16_t) bswap16 ((uint16_t) val);
+}
+
+//! Byte swap unsigned int
+static inline uint32_t
+swap_uint32 (uint32_t val)
+{
+  return bswap32 (val);
+}
+
+//! Byte swap int
+static inline int32_t
+swap_int32 (int32_t val)
+{
+  return (int32_t) bswap32 ((uint32_t) val);
+}
+
+//! Byte swap 64 bit signed int
+static inline int64_t
+swap_int64 (int64_t val)
+{
+  return (int64_t) bswap64 ((uint64_t) val);
+}
+
+//! Byte swap 64 bit unsigned int
+static inline uint64_t
+swap_uint64 (uint64_t val)
+{
+  return bswap64 (val);
+}
+
+//! Return the byte swapped value of a float
+static inline float
+floatFlip (float *value)
+{
+  uint32_t v;
+  float f;
+
+  memcpy (&v, value, sizeof (v));
+  v = bswap32 (v);
+  memcpy (&f, &v, sizeof (f));
+  return f;
+}
+
+//! Byte reverse 4 bytes into a float
+static inline float
+floatSwap (char *value)
+{
+  uint32_t v;
+  float f;
+
+  memcpy (&v, value, sizeof (v));
+  v = bswap32 (v);
+  memcpy (&f, &v, sizeof (f));
+  return f;
+}
+
+#endif /* _BYTEIO_H_ */
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <signal.h>
+#include "byteio.h"
 
 #define Bit6 0x20
 #define Bit9 0x200
@@ -8,117 +10,77 @@
 #define _JSF2_H_
 #endif
 
-int  get_int (unsigned char *buf, int location);
-
-short get_short (unsigned char *buf, int location);
-
 void err_exit (void);
 void ascebc (char *inbuf, char *outbuf, int nchars);
 void *calloc (size_t count, size_t size);
 void free (void *ptr);
 void usage (void);
-void do_ebcdic (void);
-void do_bcd (void);
-void do_calloc (void);
-void do_start_new_file(void);
-
-float floatFlip (float *value);
-float floatSwap (char *value);
 
-double get_double (unsigned char *inbuf, int location);
-float get_float   (unsigned char *inbuf, int location);
-int get_int       (unsigned char *buf, int location);
-short get_short   (unsigned char *inbuf, int location);
+//	Field decoders and byte swapping routines are inline in byteio.h
 
-//	Byte swapping routines
 
-uint16_t swap_uint16 (uint16_t val);
-int16_t  swap_int16  (int16_t val );
-uint32_t swap_uint32 (uint32_t val );
-int32_t  swap_int32  (int32_t val );
-int64_t  swap_int64  (int64_t val );
-uint64_t swap_uint64 (uint64_t val );
-
-
-#if defined (mc68000) || defined (sony) || defined(sgi) || defined(sun) || defined (_BIG_ENDIAN)
-#define BIG 1
-#else
-#define BIG 0
-#endif
+/*
+ * Host byte order, from the compiler's own macros (see byteio.h)
+ */
 
-#if defined  (ultrix) || defined (__alpha) || defined (INTEL) ||  defined (__APPLE__)
-#define LITTLE 1
-#else
-#define LITTLE 0
-#endif
+#define BIG HOST_BIG_ENDIAN
+#define LITTLE (!HOST_BIG_ENDIAN)
 
 
 #define EBCHDLEN 3200    /* length of EBCDIC reel header block                   */
 #define BCDHDLEN 400     /* length of BCD reel header block                      */
 #define TRHDLEN 240      /* length of the binary header part of trace block      */
 
-  int i = 0;
-  int j = 0;
   int c = 0;
-  int in_fd;                    /* file descriptor */
-  int temp_i = 0;
-  int outlu = 0;
-  int bytes_written;
-  int tseq_reel = 0;
-  int tseq_line = 0;
-  int asciiIndex;
-  int doing_SB = 0;
   int do_Analytic = 0;
   int do_Envelope = 0;
   int do_Real = 0;
   int xt_Real = 0;
-  int done_Calloc = 0;
-  int sp_retn;
-  int ProcessedPing = 0;
-  int SeismicRecords = 0;
-  int inbytes;
-  int SegBytes = 0;
-  int Year = 0;
-  int Day = 0;
-  int Hour = 0;
-  int Second = 0;
-  int Minute = 0;
-  int got_start_time = 0;
-  int start_sb_size = 0;
-  int current_sb_size = 0;
-  int iFirst = 0;
-  int outOpened = 0;
-
-  unsigned short sweepLength;
-  unsigned short sampInterval;
-  unsigned short VFlag = 0;
-  unsigned short numberOfSamples = 0;
-
-  unsigned int  pingNum = 0;
+  int do_Precise = 0;
+  int in_mode = 0;              /* JSF_READ, JSF_MMAP (-m) or JSF_URING; - is a stream */
+  int uringDepth = 0;           /* --uring=DEPTH: reads in flight, 0 default */
+  size_t uringBlock = 0;        /* --uring=DEPTH,KB: bytes per read, 0 default */
+  int do_Index = 0;
+  int nWorkers = 0;             /* conversion threads (-j) */
+  int convDepth = 16;           /* pings queued for conversion (-q) */
+  int writeDepth = 32;          /* converted pings queued for writing */
+  int do_Direct = 0;             /* O_DIRECT output (-d) */
+  int do_Batch = 0;
+  int nBatch = 0;               /* batch threads (-b), 0 one per CPU */
+  int segyFd = -1;              /* -o -: SEG Y to (a copy of) stdout */
+  int do_Sidescan = 0;          /* -s, -S: sidescan to SEG Y, raw */
+  int ss_Raw = 0;
+  int segyFormat = 5;          /* --format: SEG Y sample format code */
+  int segyLittle = 0;           /* --little-endian: SEG Y rev 2, little-endian */
+  int segySwap = LITTLE;        /* output byte order is not the host's */
+  int do_Gate = 0;              /* --window, --samples or --decimate */
+  int gateTime = 0;             /* --window=T0,T1: two-way time, ms */
+  double gateT0, gateT1;
+  int gateFirst = 0;            /* --samples=FIRST[,LAST], from 0 */
+  int gateLast = -1;            /* -1 to the end of the trace */
+  int gateDecim = 1;            /* --decimate=N: every Nth sample */
+  int gateFilter = 1;           /* --no-antialias clears */
+  int do_Range = 0;             /* --start/--end or --first/--last */
+  int rangeBy = -1;             /* JSFSEEK_TIME or JSFSEEK_PING */
+  int64_t rangeStart = INT64_MIN;       /* first key in range */
+  int64_t rangeEnd = INT64_MAX; /* last key in range */
+  int do_Static = 0;            /* --static: STATIC_DEPTH | STATIC_HEAVE */
+  double soundVel = 1500.0;     /* --sound-velocity, m/s */
+  int do_Stats = 0;             /* --stats: stage timing report */
+  int statsEvery = 0;           /* --stats-interval=SECS: and every SECS */
+  FILE *statsFp;                /* --stats=FILE, else standard error */
+  int do_Split = 0;             /* --split: one file in chunks at once */
+  int nSplit = 0;               /* --split=N: chunks, 0 one per CPU */
+  int do_Follow = 0;            /* --follow: wait for the input to grow */
+  int followIdle = 0;           /* --follow=SECS: stop after SECS idle */
+  volatile sig_atomic_t stopFollow = 0; /* SIGINT or SIGTERM in --follow */
 
-  size_t JSFmsgSize = 16;
   size_t trhedlen = 240;
-  size_t DataSize = 0;
-  size_t nval = 0;
+  size_t outBlock = 0;          /* output block bytes (-w), 0 default */
 
-  short Weighting;
-  short Data_Fmt;
-
-  off_t offset;                 /* offset for seeking starting record */
-  off_t where;
-
-  char samps_per_shot[10];
-  char temp[255];
-  char inputFileName[40] = "";
-  char nextFileName[40] = "";
-  char outFileName [40] = "";
-  char ebcdic[3200];            /* ebcdic header */
-  char ebcbuf[3200];
-  char tempBuffer[21];
   char segy[] = ".sgy";
   char *outputFile;
+  char *manifestFile;
+  char *headerMapFile;          /* --header-map: trace header mapping changes */
 
-  unsigned char *JSFData;
-  unsigned char *JSFmsg;
-  unsigned char JSFSEGYHead[TRHDLEN];
-
+  const unsigned char noSEGYHead[TRHDLEN];      /* zeros until the first ping */
@@ -66,13 +66,27 @@
 #include "jsf2.h"
 #include "ebcdic.h"
 #include "segy_rev_1.h"
+#include "jsfconv.h"
+#include "libjsf.h"
+#include "jsfpipe.h"
+#include "jsfaux.h"
+#include "jsfstats.h"
+#include "jsfmap.h"
+
+#include "jsfbatch.h"
+#include "segyout.h"
+#include <limits.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <stddef.h>
 
 unsigned short Sonar_Data_Msg = 80;
 unsigned short SubBottom = 0;
 char *progname;
 
-BCDHeader bhead, *bcdhead = &bhead;
-
 /*
  * Let's get things aligned
  */
@@ -83,17 +97,508 @@ typedef union
   float dummies[60];
 } ForceFloat;
 
-ForceFloat floatSegy;
+/*
+ * Products: what -e, -a, -r and -x each make from subbottom data, and
+ * from which JSF data format, and the sidescan of -s and -S, one product
+ * per sidescan subsystem whatever its format.  One pass over the input
+ * feeds every product asked for, each into its own output file.
+ */
+
+#define PROD_ENV	0	/* -e Envelope */
+#define PROD_ANA	1	/* -a Envelope from Analytic */
+#define PROD_REAL	2	/* -r Real */
+#define PROD_XREAL	3	/* -x Real part of Analytic */
+#define PROD_SSLF	4	/* -s, -S Low frequency sidescan */
+#define PROD_SSHF	5	/* -s, -S High frequency sidescan */
+#define NPROD		6
+#define NSUBBOTTOM	4	/* products 0 .. NSUBBOTTOM-1 are subbottom */
+
+static const struct
+{
+  short fmt;			/* JSF data format it is made from, -1 any */
+  const char *suffix;		/* output name suffix when several are made */
+} product[NPROD] =
+{
+  {Env_Data, "_env"},
+  {Ana_Data, "_ana"},
+  {Real_Data, "_real"},
+  {Ana_Data, "_xreal"},
+  {-1, "_sslf"},
+  {-1, "_sshf"},
+};
+
+#define IS_SIDESCAN(type, sub) \
+  (((type) == Sonar_Data_Msg || (type) == Sidescan_Msg) \
+   && ((sub) == Low_Sidescan || (sub) == Hi_Sidescan))
+
+/*
+ * One product's part of a PING_TRACE slot
+ */
+
+typedef struct
+{
+  SegyOut *out;			/* NULL if the ping is not for this product */
+  int raw;			/* samples only, no trace header */
+  short dt;			/* bhead.mdt, already swapped */
+  unsigned int ping;
+  unsigned int tseq_line;
+  unsigned int tseq_reel;
+
+  ForceFloat segy;		/* SEG Y trace header */
+  float *sig;			/* converted samples, packed in the output
+				 * format */
+  float *tmp;			/* --static: samples before the shift */
+  size_t sig_alloc;
+  size_t nval;			/* bytes of sig to write */
+} PingOut;
+
+/*
+ * One pipeline slot (jsfpipe.h): a trace on its way from the reader
+ * through conversion to the writers, or a file event that has to happen
+ * in order with the traces around it.
+ */
+
+#define PING_TRACE	0	/* convert and write a trace */
+#define PING_HEADERS	1	/* write EBCDIC and BCD headers to out */
+#define PING_CLOSE	2	/* flush and close out */
+#define PING_FLUSH	3	/* --follow: bring out up to date */
+
+typedef struct
+{
+  int kind;
+  SegyOut *out;			/* PING_HEADERS, PING_CLOSE output file */
+
+  const unsigned char *head;	/* JSF trace header */
+  const unsigned char *data;	/* JSF trace data */
+  unsigned char head_buf[TRHDLEN];	/* storage for both when not mapped */
+  unsigned char *data_buf;
+  size_t data_alloc;
+  size_t data_size;
+
+  short fmt;			/* JSF data format */
+  short weight;			/* -Weighting */
+  unsigned short nsamp;
+  short chan;			/* sidescan channel, 0 port 1 starboard */
+  int dead;			/* no data: a sidescan channel that is missing */
+  AuxFix fix;			/* navigation and attitude at the ping */
+  int navSeen;			/* a position fix used in the file by now */
+  PingOut prod[NPROD];
+
+  char ebcdic[EBCHDLEN];	/* PING_HEADERS */
+  BCDHeader bhead;
+
+  unsigned long ntraces;	/* PING_FLUSH: traces now in out, or 0 for
+				 * raw output, which has no header to patch */
+  struct timespec since;	/* PING_FLUSH: oldest trace's arrival */
+} Ping;
+
+/*
+ * --split: one input converted in byte ranges (chunks) at once, each by
+ * its own Conversion.  A first, light pass over each chunk reads just
+ * the message headers and sonar headers, and counts the traces of each
+ * product in runs of one record length.  Put together in chunk order
+ * the runs give the output files, which are then made, headers and all,
+ * and for each chunk which file its first trace goes in, where, and its
+ * ping and trace numbers.  The second pass converts the chunks and
+ * writes each one's traces straight to their place in the files.
+ */
+
+#define SPLIT_MIN	(8 * 1024 * 1024)	/* smallest chunk */
+#define SPLIT_WARMUP	(4 * 1024 * 1024)	/* sensor messages read ahead of
+						 * a chunk, for its first pings */
+
+typedef struct
+{
+  int size;			/* JSF message size of its pings */
+  unsigned long count;		/* traces */
+  off_t bytes;			/* SEG Y bytes of them, headers included */
+  off_t first;			/* file offset of the first ping's message */
+} SplitRun;
+
+typedef struct
+{
+  off_t lo;			/* the messages that start in lo .. hi-1 */
+  off_t hi;
+  off_t warm;			/* where to start reading sensor messages */
+  off_t end;			/* first pass: the message it ended at */
+  int stop;			/* a ping past --end or --last ended it */
+  int status;			/* 0, -1 failed */
+  SplitRun *run[NSUBBOTTOM];
+  size_t nrun[NSUBBOTTOM];
+  size_t arun[NSUBBOTTOM];
+  size_t file[NSUBBOTTOM];	/* output file of the first trace */
+  off_t at[NSUBBOTTOM];		/* its offset in the file */
+  unsigned long left[NSUBBOTTOM];	/* traces the file takes from here */
+  unsigned long seq[NSUBBOTTOM];	/* traces of the product before it */
+} SplitChunk;
+
+typedef struct
+{
+  char name[PATH_MAX];
+  int size;			/* JSF message size of its pings */
+  unsigned long count;
+  off_t bytes;
+  off_t first;
+  BCDHeader bhead;
+} SplitFile;
+
+typedef struct
+{
+  const char *path;
+  int want[NSUBBOTTOM];
+  SplitChunk *chunk;
+  size_t nchunk;
+  SplitFile *file[NSUBBOTTOM];	/* output files of each product */
+  size_t nfile[NSUBBOTTOM];
+  size_t afile[NSUBBOTTOM];
+} Split;
+
+/*
+ * Everything one conversion of one input file works with.  A single
+ * file run uses one; batch mode (-b) has one per input file and runs
+ * several at a time.
+ */
+
+#define EBCDIC_NAME	71	/* room for the file name on card C2 */
+#define BCD_ORDER	96	/* binary header: 0x01020304 in the byte order
+				 * of the file (bytes 3297-3300, rev 2) */
+#define BCD_NTRACES	312	/* binary header: traces in the file, 8 bytes
+				 * (bytes 3313-3320, from SEG Y rev 2) */
+#define FOLLOW_FLUSH	1000	/* --follow: longest a trace waits, ms */
+#define JSF_AUXMAX	4096	/* longest sensor message decoded */
+#define AUX_AHEAD	(8 * 1024 * 1024)	/* sensor messages read ahead of
+						 * a ping, at most */
+#define AHEAD_BLOCK	(256 * 1024)	/* and the reads doing it */
+#define STATIC_DEPTH	1	/* --static: vehicle depth */
+#define STATIC_HEAVE	2	/* --static: heave */
+#define TH_PITCH	232	/* trace header: pitch, 0.01 degrees */
+#define TH_ROLL		234	/* roll, 0.01 degrees */
+#define TH_HEADING	236	/* heading, 0.01 degrees, unsigned */
+#define TH_HEAVE	238	/* heave, mm */
+#define XY_XSC		1	/* sonar_xy() fields, in sonarXY */
+#define XY_XRC		2
+#define XY_YSC		4
+#define XY_YRC		8
+#define XY_UNIT		16	/* map_unit */
+#define XY_SCALE	32	/* map_scale */
+#define SAMPLE_BYTES(f)	((f) == 3 ? 2 : (f) == 8 ? 1 : 4)	/* SEG Y format f */
+
+/*
+ * SEG Y fields in the byte order of the output: big-endian, or with
+ * --little-endian the little-endian of SEG Y rev 2.  segySwap is set
+ * once from the options, so on a host of the output's own order these
+ * are straight copies.
+ */
+
+static inline uint16_t
+seg_u16 (uint16_t v)
+{
+  return segySwap ? swap_uint16 (v) : v;
+}
+
+static inline int16_t
+seg_i16 (int16_t v)
+{
+  return segySwap ? swap_int16 (v) : v;
+}
+
+static inline uint32_t
+seg_u32 (uint32_t v)
+{
+  return segySwap ? swap_uint32 (v) : v;
+}
+
+static inline int32_t
+seg_i32 (int32_t v)
+{
+  return segySwap ? swap_int32 (v) : v;
+}
+
+static inline void
+st_seg16 (unsigned char *p, uint16_t v)
+{
+  v = seg_u16 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_seg32 (unsigned char *p, uint32_t v)
+{
+  v = seg_u32 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+st_seg64 (unsigned char *p, uint64_t v)
+{
+  if (segySwap)
+    v = swap_uint64 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+/*
+ * Output of one product: its file, headers and counters.  Record length
+ * changes are tracked per product, on its own pings only.
+ */
+
+typedef struct
+{
+  int want;
+  int raw;			/* -S: samples only, no SEG Y headers */
+  const char *ext;		/* .sgy, or .raw */
+  char *nextFileName;		/* output name without .sgy */
+  char outFileName[PATH_MAX];	/* output file being written */
+  SegyOut *outlu;
+
+  int doing_SB;
+  int iFirst;
+  int start_sb_size;
+  int current_sb_size;
+  unsigned int pingNum;
+  int tseq_reel;
+  int tseq_line;
+  unsigned long nchange;	/* record length changes */
+  unsigned long ntraces;	/* traces sent to this output file */
+  int unflushed;		/* --follow: of those, not yet flushed */
+  struct timespec pending;	/* --follow: when the first of them came */
+
+  int ss_expect;		/* sidescan: port written, starboard next */
+  unsigned int ss_ping;		/* JSF ping number of that port trace */
+  unsigned char ss_head[TRHDLEN];	/* and its JSF header */
+
+  char ebcdic[EBCHDLEN];	/* ebcdic header */
+  char ebcbuf[EBCHDLEN];
+  BCDHeader bhead;
+} Product;
+
+typedef struct
+{
+  const char *inputFileName;
+  char *nextFileName;		/* output name without .sgy */
+  Product prod[NPROD];
+  off_t inbytes;		/* size of the input file */
+
+  JSFReader reader;
+  JSFMessage msg;
+  JSFIndex jsfindex;
+  char *idxFileName;
+  int use_index;
+  size_t idx_next;		/* next index entry to visit */
+  AuxCache aux;			/* sensor messages read so far */
+  off_t auxAhead;		/* read ahead of the pings up to here, -1
+				   not at all (a stream) */
+  unsigned char *aheadBuf;	/* AHEAD_BLOCK bytes of the file from */
+  off_t aheadAt;
+  size_t aheadLen;
+  int navSeen;			/* a ping has had a position fix */
+  off_t rangeFrom;		/* --start, --first: sensor messages only
+				   before this offset */
+  JSFStats stats;		/* --stats */
+
+  Split *split;			/* --split: the plan, and this chunk of it */
+  SplitChunk *chunk;
+
+  JSFPipe pipe;
+  int failed;			/* a write failed, stop reading */
+  int filling;			/* reader holds a slot from pipe_next() */
+  int nflush;			/* --follow, writer side: flushes done */
+  double lat_sum;		/* and ping to trace latency, ms */
+  double lat_max;
+
+  const unsigned char *JSFmsg;	/* views returned by the reader */
+  const unsigned char *JSFSEGYHead;
+
+  int got_start_time;
+  int SeismicRecords;
+  int SidescanRecords;
+  int Year;
+  int Day;
+  int Hour;
+  int Minute;
+  int Second;
+  short endTime[5];		/* year, day, hour, minute, second of the
+				   last ping, a copy: the header is a view */
+
+  unsigned short sweepLength;
+  unsigned short sampInterval;
+  unsigned short numberOfSamples;
+  short Data_Fmt;
+
+  int status;			/* 0 converted, -1 failed */
+} Conversion;
+
+int convert_file (Conversion * cv);
+int open_input (JSFReader * r, const char *path);
+int convert_loop (Conversion * cv);
+int read_ping (Conversion * cv, Ping * p);
+void convert_ping (void *arg, void *slot);
+int convert_product (Ping * p, int k, PingOut * po, JSFStats * st);
+void aux_fix (Conversion * cv, Ping * p);
+const unsigned char *ahead_read (Conversion * cv, off_t at, size_t n);
+int aux_field (double v, double scale, int lo, int hi);
+void sonar_xy (const unsigned char *h, ShotHeader * t);
+void sonar_xy_fields (void);
+float static_shift (const Ping * p, double *ms);
+int gate_range (const unsigned char *h, int *first);
+int gate_samples (Conversion * cv);
+int ping_range (const unsigned char *head);
+int ss_out_of_range (const unsigned char *head);
+void end_time (Conversion * cv, const unsigned char *head);
+int range_seek (Conversion * cv);
+void index_from (Conversion * cv, off_t at);
+void write_ping (void *arg, void *slot);
+void write_slot (Conversion * cv, Ping * p);
+void free_ping (void *arg, void *slot);
+int product_names (Conversion * cv);
+void do_ebcdic (Conversion * cv, Product * pr);
+void do_bcd (Conversion * cv, Product * pr);
+int do_start_file (Conversion * cv, Product * pr);
+int do_start_new_file (Conversion * cv, Product * pr);
+void close_output (Conversion * cv, Product * pr);
+void flush_output (Conversion * cv, Product * pr);
+void follow_flush (void *arg);
+void stop_follow (int sig);
+int end_of_input (Conversion * cv);
+void trace_out (Conversion * cv, Ping * p, int k);
+void follow_check (Conversion * cv);
+int do_sidescan (Conversion * cv);
+int ss_dead (Conversion * cv, int k, int chan, const unsigned char *head);
+void do_prealloc (Conversion * cv, Product * pr);
+int next_message (Conversion * cv);
+const unsigned char *read_payload (Conversion * cv, size_t n);
+Ping *next_slot (Conversion * cv);
+void stats_report (Conversion * cv, int final);
+void add_input (const char *path);
+void add_manifest (const char *path);
+char *batch_name (const char *input);
+void batch_one (void *arg, size_t job);
+int do_batch (void);
+void split_count (void *arg, size_t job);
+size_t split_peek (const JSFMessage * m, void *arg);
+int split_add (SplitChunk * ch, int k, int size, off_t bytes, off_t first);
+int split_files (Split * sp, int fd);
+int split_start (Conversion * cv);
+int split_where (Conversion * cv);
+int split_output (Conversion * cv, int k);
+void split_one (void *arg, size_t job);
+int do_split (const char *path);
+
+float gateTaps[CONV_TAPS (CONV_DECIM_MAX)] = { 1.0f };	/* --decimate */
+int gateNtaps = 1;	/* anti-alias filter, 1 tap without */
+
+/*
+ * The SEG Y trace header fields, for the JSF sonar header mapping
+ */
+
+#define TH_FIELD(f)	{ #f, offsetof (ShotHeader, f), \
+			  sizeof (((ShotHeader *) 0)->f) }
+
+static const MapField thFields[] = {
+  TH_FIELD (tseq_line), TH_FIELD (tseq_reel), TH_FIELD (fldrec),
+  TH_FIELD (fldtr), TH_FIELD (sorcpt), TH_FIELD (cdpno), TH_FIELD (cdptr),
+  TH_FIELD (trcode), TH_FIELD (nvsum), TH_FIELD (nhsum), TH_FIELD (prod),
+  TH_FIELD (offset), TH_FIELD (elev), TH_FIELD (selev), TH_FIELD (sdepth),
+  TH_FIELD (rdatum), TH_FIELD (sdatum), TH_FIELD (swdepth),
+  TH_FIELD (rwdepth), TH_FIELD (survey_scale), TH_FIELD (map_scale),
+  TH_FIELD (xsc), TH_FIELD (ysc), TH_FIELD (xrc), TH_FIELD (yrc),
+  TH_FIELD (map_unit), TH_FIELD (wvel), TH_FIELD (swvel),
+  TH_FIELD (suphole), TH_FIELD (ruphole), TH_FIELD (delay),
+  TH_FIELD (strtmute), TH_FIELD (endmute), TH_FIELD (nttr), TH_FIELD (dt),
+  TH_FIELD (gaintype), TH_FIELD (gaincon), TH_FIELD (initgain),
+  TH_FIELD (correl), TH_FIELD (stfreq), TH_FIELD (enfreq),
+  TH_FIELD (swplen), TH_FIELD (swptyp), TH_FIELD (sttaplen),
+  TH_FIELD (entaplen), TH_FIELD (taptyp), TH_FIELD (aafilt),
+  TH_FIELD (aaslope), TH_FIELD (notfilt), TH_FIELD (notslope),
+  TH_FIELD (lcfilt), TH_FIELD (hcfilt), TH_FIELD (lcslope),
+  TH_FIELD (hcslope), TH_FIELD (year), TH_FIELD (julday), TH_FIELD (hour),
+  TH_FIELD (minute), TH_FIELD (second), TH_FIELD (tbasis),
+  TH_FIELD (tweight), TH_FIELD (ggnr), TH_FIELD (ggnt), TH_FIELD (ggnlt),
+  TH_FIELD (gap_size), TH_FIELD (over_trvl), TH_FIELD (X_ens),
+  TH_FIELD (Y_ens), TH_FIELD (inline_numb), TH_FIELD (xline_numb),
+  TH_FIELD (Sp_numb), TH_FIELD (Sp_scalar), TH_FIELD (T_unit),
+  TH_FIELD (T_cons), TH_FIELD (T_units), TH_FIELD (DT_ident),
+  TH_FIELD (UH_scalar), TH_FIELD (S_orient), TH_FIELD (SE_dir),
+  TH_FIELD (S_measure), TH_FIELD (S_unit),
+  {NULL, 0, 0}
+};
+
+/*
+ * JSF sonar header to SEG Y trace header, changed by --header-map.
+ * The sequence and trace numbers, trace code of dead traces, samples,
+ * delay, sample interval, weighting and the sensor fixes are set for
+ * each trace after these.  So is the position of a ping without a fix
+ * in a file that has had one, put in the fixes' units by sonar_xy() in
+ * the position fields here that --header-map leaves alone.
+ */
+
+static const MapEntry thMap[] = {
+  {"elev", 136, MAP_I32, 1},	/* receiver pressure depth (mm) */
+  {"selev", 136, MAP_I32, 1},	/* source pressure depth (mm) */
+  {"swdepth", 144, MAP_I32, 1},	/* water depth at source (mm) */
+  {"rwdepth", 144, MAP_I32, 1},	/* water depth at receiver (mm) */
+  {"offset", 38, MAP_I16, 1},	/* s - r offset */
+  {"gaincon", 120, MAP_I16, 1},	/* gain constant */
+  {"year", 198, MAP_I16, 1},	/* year of recording */
+  {"julday", 196, MAP_I16, 1},	/* day of recording */
+  {"hour", 186, MAP_I16, 1},	/* hour of recording */
+  {"minute", 188, MAP_I16, 1},	/* minute of recording */
+  {"second", 190, MAP_I16, 1},	/* second of recording */
+  {"xsc", 80, MAP_I32, 1},	/* Longitude */
+  {"xrc", 80, MAP_I32, 1},
+  {"ysc", 84, MAP_I32, 1},	/* Latitude */
+  {"yrc", 84, MAP_I32, 1},
+  {"stfreq", 126, MAP_I16, 10},	/* Start Frequency of Chirp */
+  {"enfreq", 128, MAP_I16, 10},	/* End Frequency of Chirp */
+  {"swplen", 130, MAP_I16, 1},	/* Sweep length in milliseconds */
+  {"trcode", -1, MAP_CONST, 1},	/* Seismic data */
+  {"tbasis", -1, MAP_CONST, 4},	/* UTC time */
+  {"map_scale", -1, MAP_CONST, -1000},
+  {"map_unit", -1, MAP_CONST, 2},	/* Lon, Lat */
+  {"survey_scale", -1, MAP_CONST, -1000},	/* depth values in millimeters */
+  {"correl", -1, MAP_CONST, 2},	/* Correlated */
+  {"swptyp", -1, MAP_CONST, 1},	/* Linear Sweep */
+};
+
+HeaderMap hdrMap;		/* compiled for the run */
+unsigned int sonarXY;		/* XY_XSC ...: the position fields it left */
+
+char **inputs;			/* batch mode input files */
+size_t ninputs;
+size_t ainputs;
 
 int
 main (int argc, char *argv[])
 {				/* START MAIN */
-  ShotHeader *THead;
-
-  THead = &floatSegy.thead;
+  static const struct option longopts[] = {
+    {"follow", optional_argument, NULL, 'F'},
+    {"static", optional_argument, NULL, 'T'},
+    {"sound-velocity", required_argument, NULL, 'V'},
+    {"format", required_argument, NULL, 'K'},
+    {"little-endian", no_argument, NULL, 'L'},
+    {"window", required_argument, NULL, 'W'},
+    {"samples", required_argument, NULL, 'N'},
+    {"decimate", required_argument, NULL, 'D'},
+    {"no-antialias", no_argument, NULL, 'A'},
+    {"start", required_argument, NULL, 'B'},
+    {"end", required_argument, NULL, 'E'},
+    {"first", required_argument, NULL, 'G'},
+    {"last", required_argument, NULL, 'H'},
+    {"split", optional_argument, NULL, 'P'},
+    {"header-map", required_argument, NULL, 'M'},
+    {"uring", optional_argument, NULL, 'U'},
+    {"stats", optional_argument, NULL, 'Z'},
+    {"stats-interval", required_argument, NULL, 'I'},
+    {NULL, 0, NULL, 0}
+  };
+  Conversion *cv;
+  struct sigaction sa;
+  struct stat st;
+  int k;
 
   progname = argv[0];
 
+  conv_init ();			/* pick the sample conversion kernels */
+
   if ((argc - optind) < 1)
     usage ();
 
@@ -102,7 +607,8 @@ main (int argc, char *argv[])
    * file to the current directory - bwd
    */
 
-  while ((c = getopt (argc, argv, "earxo:")) != -1)
+  while ((c = getopt_long (argc, argv, "earxsSpmidw:j:q:b:l:o:", longopts,
+			   NULL)) != -1)
     {
       switch (c)
 	{
@@ -118,403 +624,2023 @@ main (int argc, char *argv[])
 	case 'x':
 	  xt_Real++;
 	  break;
+	case 's':
+	  do_Sidescan++;
+	  break;
+	case 'S':
+	  do_Sidescan++;
+	  ss_Raw++;
+	  break;
+	case 'p':
+	  do_Precise++;
+	  break;
+	case 'm':
+	  in_mode = JSF_MMAP;
+	  break;
+	case 'i':
+	  do_Index++;
+	  break;
+	case 'd':
+	  do_Direct++;
+	  break;
+	case 'w':
+	  outBlock = (size_t) atol (optarg) * 1024;
+	  break;
+	case 'j':
+	  nWorkers = atoi (optarg);
+	  break;
+	case 'q':
+	  if (sscanf (optarg, "%d,%d", &convDepth, &writeDepth) < 1)
+	    usage ();
+	  break;
+	case 'b':
+	  nBatch = atoi (optarg);
+	  do_Batch++;
+	  break;
+	case 'l':
+	  manifestFile = (char *) optarg;
+	  do_Batch++;
+	  break;
 	case 'o':
 	  outputFile = (char *) optarg;
 	  break;
+	case 'F':
+	  do_Follow++;
+	  if (optarg != NULL)
+	    followIdle = atoi (optarg);
+	  break;
+	case 'T':
+	  do_Static = optarg == NULL ? STATIC_DEPTH | STATIC_HEAVE : 0;
+	  for (k = 0; optarg != NULL && optarg[k] != '\0'; k++)
+	    if (optarg[k] == 'd')
+	      do_Static |= STATIC_DEPTH;
+	    else if (optarg[k] == 'h')
+	      do_Static |= STATIC_HEAVE;
+	    else
+	      usage ();
+	  if (!do_Static)
+	    usage ();
+	  break;
+	case 'V':
+	  soundVel = atof (optarg);
+	  if (!(soundVel > 0.0))
+	    usage ();
+	  break;
+	case 'K':
+	  segyFormat = atoi (optarg);
+	  if (segyFormat != 1 && segyFormat != 2 && segyFormat != 3
+	      && segyFormat != 5 && segyFormat != 8)
+	    usage ();
+	  break;
+	case 'L':
+	  segyLittle++;
+	  break;
+	case 'W':
+	  if (sscanf (optarg, "%lf,%lf", &gateT0, &gateT1) != 2
+	      || !(gateT0 >= 0.0 && gateT1 > gateT0))
+	    usage ();
+	  gateTime = do_Gate = 1;
+	  break;
+	case 'N':
+	  if (sscanf (optarg, "%d,%d", &gateFirst, &gateLast) < 1
+	      || gateFirst < 0 || (gateLast != -1 && gateLast < gateFirst))
+	    usage ();
+	  gateTime = 0;
+	  do_Gate = 1;
+	  break;
+	case 'D':
+	  gateDecim = atoi (optarg);
+	  if (gateDecim < 1 || gateDecim > CONV_DECIM_MAX)
+	    usage ();
+	  do_Gate = 1;
+	  break;
+	case 'A':
+	  gateFilter = 0;
+	  break;
+	case 'B':
+	case 'E':
+	  if (rangeBy == JSFSEEK_PING
+	      || jsfseek_time (optarg, c == 'B' ? &rangeStart : &rangeEnd))
+	    usage ();
+	  rangeBy = JSFSEEK_TIME;
+	  do_Range = 1;
+	  break;
+	case 'G':
+	case 'H':
+	  if (rangeBy == JSFSEEK_TIME || !isdigit ((unsigned char) *optarg))
+	    usage ();
+	  *(c == 'G' ? &rangeStart : &rangeEnd) = strtoll (optarg, NULL, 10);
+	  rangeBy = JSFSEEK_PING;
+	  do_Range = 1;
+	  break;
+	case 'P':
+	  do_Split++;
+	  if (optarg != NULL && (nSplit = atoi (optarg)) < 1)
+	    usage ();
+	  break;
+	case 'M':
+	  headerMapFile = (char *) optarg;
+	  break;
+	case 'U':
+	  in_mode = JSF_URING;
+	  k = 0;
+	  if (optarg != NULL
+	      && (sscanf (optarg, "%d,%d", &uringDepth, &k) < 1
+		  || uringDepth < 1 || k < 0))
+	    usage ();
+	  uringBlock = (size_t) k * 1024;
+	  break;
+	case 'Z':
+	  do_Stats++;
+	  if (optarg != NULL && (statsFp = fopen (optarg, "a")) == NULL)
+	    {
+	      fprintf (stderr, "%s: cannot open %s\n", progname, optarg);
+	      perror ("fopen");
+	      err_exit ();
+	    }
+	  break;
+	case 'I':
+	  do_Stats++;
+	  statsEvery = atoi (optarg);
+	  if (statsEvery < 1)
+	    usage ();
+	  break;
 	case '?':
 	  err_exit ();
 	  break;
 	}
     }
 
+  if (do_Stats && statsFp == NULL)
+    statsFp = stderr;
+  segySwap = segyLittle ? BIG : LITTLE;
+
   /*
-   * open the input jsf file
+   * The trace header mapping, compiled once for the output byte order
    */
 
-  if ((in_fd = open (argv[optind], O_RDONLY)) == -1)
+  if (map_init (&hdrMap, thFields, thMap, sizeof (thMap) / sizeof (thMap[0]))
+      == -1 || (headerMapFile != NULL && map_load (&hdrMap, headerMapFile) == -1))
     {
-      fprintf (stderr, "%s: cannot open %s\n", argv[optind], progname);
-      perror ("open");
+      fprintf (stderr, "%s: bad trace header mapping\n", progname);
+      err_exit ();
+    }
+  map_compile (&hdrMap, segyLittle);
+  sonar_xy_fields ();
+  if (gateFilter)
+    gateNtaps = conv_decim_taps (gateDecim, gateTaps);
+
+  /*
+   * More than one input, a directory of them or a manifest: batch mode
+   */
+
+  if (argc - optind > 1
+      || (optind < argc && stat (argv[optind], &st) == 0
+	  && S_ISDIR (st.st_mode)))
+    do_Batch++;
+
+  if (do_Batch && do_Follow)
+    {
+      fprintf (stderr, "%s: --follow takes a single input file\n", progname);
+      err_exit ();
+    }
+  if (do_Split && (do_Batch || do_Follow || do_Sidescan))
+    {
+      fprintf (stderr,
+	       "%s: --split takes a single input file, subbottom only, without --follow\n",
+	       progname);
+      err_exit ();
+    }
+
+  if (do_Batch)
+    {
+      for (k = optind; k < argc; k++)
+	add_input (argv[k]);
+      if (manifestFile != NULL)
+	add_manifest (manifestFile);
+      exit (do_batch () == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+  if (optind >= argc || outputFile == NULL)
+    usage ();
+
+  /*
+   * -o -: SEG Y to standard output, in a pipeline.  The messages that
+   * normally go there go to standard error instead.
+   */
+
+  if (strcmp (outputFile, "-") == 0)
+    {
+      fflush (stdout);
+      if ((segyFd = dup (STDOUT_FILENO)) == -1
+	  || dup2 (STDERR_FILENO, STDOUT_FILENO) == -1)
+	{
+	  perror ("dup");
+	  err_exit ();
+	}
+      if ((do_Envelope != 0) + (do_Analytic != 0) + (do_Real != 0)
+	  + (xt_Real != 0) > 1 || do_Sidescan)
+	{
+	  fprintf (stderr,
+		   "%s: only one of -e, -a, -r, -x (and no sidescan) can go to standard output\n",
+		   progname);
+	  err_exit ();
+	}
+    }
+
+  if (do_Split)
+    {
+      if (segyFd != -1)
+	{
+	  fprintf (stderr, "%s: --split cannot write to standard output\n",
+		   progname);
+	  err_exit ();
+	}
+      exit (do_split (argv[optind]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+  /*
+   * --follow: the file grows under us, so it is read (not mapped),
+   * without an index and with buffered output that can be flushed as we
+   * go.  SIGINT and SIGTERM end the run cleanly.
+   */
+
+  if (do_Follow)
+    {
+      in_mode = JSF_READ;
+      do_Index = 0;
+      do_Direct = 0;
+      memset (&sa, 0, sizeof (sa));
+      sa.sa_handler = stop_follow;
+      sigemptyset (&sa.sa_mask);
+      sigaction (SIGINT, &sa, NULL);
+      sigaction (SIGTERM, &sa, NULL);
+    }
+
+  if ((cv = (Conversion *) calloc (1, sizeof (Conversion))) == NULL)
+    {
+      perror ("calloc");
       err_exit ();
     }
+  cv->inputFileName = argv[optind];
+  cv->nextFileName = outputFile;
+  if (convert_file (cv) == -1)
+    err_exit ();
+  exit (EXIT_SUCCESS);
+}				/* End main() */
+
+/*
+ * Open path for reading in in_mode.  With --uring the reads go through
+ * io_uring where the kernel allows it, and through read() otherwise,
+ * which is said once.
+ */
+
+int
+open_input (JSFReader * r, const char *path)
+{
+  static int warned = 0;
+
+  if (in_mode != JSF_URING)
+    return jsf_open (r, path, in_mode);
+  if (jsf_open (r, path, JSF_READ) == -1)
+    return -1;
+  if (jsf_uring (r, uringDepth, uringBlock) == -1
+      && !__atomic_exchange_n (&warned, 1, __ATOMIC_RELAXED))
+    fprintf (stderr, "%s: io_uring not available (%s), reading with read()\n",
+	     progname, strerror (errno));
+  return 0;
+}
+
+/*
+ * Convert one input file: cv->inputFileName to cv->nextFileName.sgy,
+ * then cv->nextFileName00.sgy ... at each record length change.  With
+ * more than one product each gets its own files, cv->nextFileName_env.sgy
+ * and so on.
+ * Returns 0, or -1 after reporting what went wrong.  Everything the
+ * conversion opened is closed again either way.
+ */
+
+int
+convert_file (Conversion * cv)
+{
+  Product *pr;
+  struct stat st;
+  int ret, k;
+
+  cv->JSFSEGYHead = noSEGYHead;
+  cv->reader.fd = -1;
+  stats_init (&cv->stats, statsEvery);
 
   /*
-   * Get some memory for JSF header
+   * open the input jsf file
    */
 
-  JSFmsg = (unsigned char *) calloc (JSFmsgSize, sizeof (unsigned char));
+  if (open_input (&cv->reader, cv->inputFileName) == -1)
+    {
+      fprintf (stderr, "%s: cannot open %s\n", cv->inputFileName, progname);
+      perror ("open");
+      return -1;
+    }
+  if (fstat (cv->reader.fd, &st) == 0)
+    cv->inbytes = st.st_size;
+  cv->auxAhead = cv->reader.mode == JSF_STREAM ? -1 : 0;
+  cv->navSeen = 0;
+  if (do_Follow
+      && jsf_follow (&cv->reader, cv->inputFileName, followIdle, &stopFollow,
+		     follow_flush, cv) == -1)
+    {
+      perror ("follow");
+      jsf_close (&cv->reader);
+      return -1;
+    }
 
   /*
-   * Copy input file name to a temp buffer
+   * Message index: build it with -i, otherwise use a current one if the
+   * sidecar exists.
    */
 
-  strcpy (inputFileName, argv[optind]);
+  if ((cv->idxFileName = jsfidx_name (cv->inputFileName)) == NULL)
+    {
+      perror ("malloc");
+      jsf_close (&cv->reader);
+      return -1;
+    }
+  if (cv->reader.mode == JSF_STREAM || do_Follow)
+    {
+      if (do_Index)
+	{
+	  fprintf (stderr, "%s: cannot index %s, it is a stream\n", progname,
+		   cv->inputFileName);
+	  jsf_close (&cv->reader);
+	  free (cv->idxFileName);
+	  return -1;
+	}
+    }
+  else if (do_Index && cv->chunk == NULL)
+    {
+      if (jsfidx_build (cv->inputFileName, &cv->jsfindex) == -1
+	  || jsfidx_write (cv->idxFileName, &cv->jsfindex) == -1)
+	{
+	  fprintf (stderr, "%s: cannot index %s\n", progname,
+		   cv->inputFileName);
+	  perror ("index");
+	  jsf_close (&cv->reader);
+	  free (cv->idxFileName);
+	  return -1;
+	}
+      fprintf (stdout, "Wrote %lu message index %s\n",
+	       (unsigned long) cv->jsfindex.count, cv->idxFileName);
+      cv->use_index++;
+    }
+  else if (jsfidx_load (cv->idxFileName, cv->reader.fd, &cv->jsfindex) == 0)
+    {
+      fprintf (stdout, "Using message index %s\n", cv->idxFileName);
+      cv->use_index++;
+    }
+
+  if (product_names (cv) == -1 || aux_init (&cv->aux, AUX_SAMPLES) == -1)
+    {
+      perror ("malloc");
+      for (k = 0; k < NPROD; k++)
+	if (cv->prod[k].nextFileName != cv->nextFileName)
+	  free (cv->prod[k].nextFileName);
+      jsf_close (&cv->reader);
+      jsfidx_free (&cv->jsfindex);
+      free (cv->idxFileName);
+      return -1;
+    }
 
-// copy output file name to prep for record length change
+  /*
+   * Start the converter pool and writer (inline when there are no
+   * workers), then convert
+   */
 
-  strcpy (nextFileName, outputFile);
-  strcat (outputFile, ".sgy");
-  strcpy (outFileName, outputFile);
+  if (pipe_start (&cv->pipe, sizeof (Ping), nWorkers, convDepth, writeDepth,
+		  convert_ping, write_ping, cv) == -1)
+    {
+      fprintf (stderr, "%s: cannot start %d conversion threads\n",
+	       progname, nWorkers);
+      perror ("pipe_start");
+      ret = -1;
+    }
+  else
+    ret = convert_loop (cv);
 
   /*
-   * MAIN WORKING LOOP
+   * Close the last output files once their traces are out
    */
 
-  while (1)
+  for (k = 0; k < NPROD; k++)
+    {
+      pr = &cv->prod[k];
+      if (cv->pipe.slots != NULL)
+	close_output (cv, pr);
+      else if (pr->outlu != NULL)
+	segy_close (pr->outlu);
+      pr->outlu = NULL;
+      if (pr->nextFileName != cv->nextFileName)
+	free (pr->nextFileName);
+    }
+  pipe_free (&cv->pipe, free_ping);
+  if (cv->failed)
+    ret = -1;
+  if (do_Stats)
     {
-      ProcessedPing = 0;	/* Setup lseek flag */
+      cv->status = ret;
+      stats_report (cv, 1);
+    }
 
-      inbytes = read (in_fd, JSFmsg, JSFmsgSize);
+  jsf_close (&cv->reader);
+  jsfidx_free (&cv->jsfindex);
+  aux_free (&cv->aux);
+  free (cv->aheadBuf);
+  cv->aheadBuf = NULL;
+  cv->aheadLen = 0;
+  free (cv->idxFileName);
+  return ret;
+}
+
+/*
+ * Output names of the products asked for: the name given when there is
+ * just one subbottom product, the name and the product's suffix
+ * otherwise (always for sidescan).  Returns -1 if
+ * out of memory.
+ */
 
-      if (inbytes == ZERO)
+int
+product_names (Conversion * cv)
+{
+  Product *pr;
+  int k, nwant;
+
+  nwant = (do_Envelope != 0) + (do_Analytic != 0) + (do_Real != 0)
+    + (xt_Real != 0);
+  cv->prod[PROD_ENV].want = do_Envelope;
+  cv->prod[PROD_ANA].want = do_Analytic;
+  cv->prod[PROD_REAL].want = do_Real;
+  cv->prod[PROD_XREAL].want = xt_Real;
+  cv->prod[PROD_SSLF].want = cv->prod[PROD_SSHF].want = do_Sidescan;
+  cv->prod[PROD_SSLF].raw = cv->prod[PROD_SSHF].raw = ss_Raw;
+
+  for (k = 0; k < NPROD; k++)
+    {
+      pr = &cv->prod[k];
+      pr->ext = pr->raw ? ".raw" : segy;
+      if (!pr->want)
+	continue;
+      if (nwant == 1 && k < NSUBBOTTOM)
+	pr->nextFileName = cv->nextFileName;
+      else
 	{
-	  fprintf (stdout,
-		   "%s End of File reached %d seismic records processed\n",
-		   inputFileName, SeismicRecords);
-	  fprintf (stdout, "Start Time:\t%d:%d:%d:%d:%d\n", Year, Day, Hour,
-		   Minute, Second);
-	  fprintf (stdout, "End Time:\t%d:%d:%d:%d:%d\n",
-		   get_short (JSFSEGYHead, 198), get_short (JSFSEGYHead, 196),
-		   get_short (JSFSEGYHead, 186), get_short (JSFSEGYHead, 188),
-		   get_short (JSFSEGYHead, 190));
-	  exit (EXIT_SUCCESS);
+	  pr->nextFileName = (char *) malloc (strlen (cv->nextFileName)
+					      + strlen (product[k].suffix) +
+					      1);
+	  if (pr->nextFileName == NULL)
+	    return -1;
+	  strcpy (pr->nextFileName, cv->nextFileName);
+	  strcat (pr->nextFileName, product[k].suffix);
 	}
+      if (segyFd != -1)
+	snprintf (pr->outFileName, sizeof (pr->outFileName), "(stdout)");
+      else
+	snprintf (pr->outFileName, sizeof (pr->outFileName), "%s%s",
+		  pr->nextFileName, pr->ext);
+    }
+  return 0;
+}
+
+/*
+ * MAIN WORKING LOOP of a conversion
+ */
+
+int
+convert_loop (Conversion * cv)
+{
+  Ping *ping;
+  Product *pr;
+  const unsigned char *aux;
+  int sp_retn, wanted, k;
+
+  if (cv->chunk != NULL)
+    {
+      if (split_start (cv) == -1)
+	return -1;
+    }
+  else if (do_Range && range_seek (cv) == -1)
+    return -1;
+
+  while (1)
+    {
+      /*
+       * Next message header.  Whatever was not read of the previous
+       * message is skipped by the reader.
+       */
 
-      if (inbytes != (int) JSFmsgSize)
+      sp_retn = next_message (cv);
+
+      if (sp_retn == ZERO)
+	return end_of_input (cv);
+
+      if (sp_retn != 1)
 	{
 	  fprintf (stderr, "%s: error reading JSF message header\n",
 		   progname);
 	  perror ("read");
-	  err_exit ();
+	  return -1;
 	}
 
-      if (get_short (JSFmsg, 0) != 0x1601)
+      cv->JSFmsg = cv->msg.hdr;
+
+      if (get_short (cv->JSFmsg, 0) != 0x1601)
 	{
 	  fprintf (stdout, "Invalid file format \n");
 	  fprintf (stdout,
 		   "%s Record Length change? %d seismic records processed\n",
-		   inputFileName, SeismicRecords);
-	  fprintf (stdout, "Start Time:\t%d:%d:%d:%d:%d\n", Year, Day, Hour,
-		   Minute, Second);
-	  fprintf (stdout, "End Time:\t%d:%d:%d:%d:%d\n",
-		   get_short (JSFSEGYHead, 198), get_short (JSFSEGYHead, 196),
-		   get_short (JSFSEGYHead, 186), get_short (JSFSEGYHead, 188),
-		   get_short (JSFSEGYHead, 190));
-	  err_exit ();
+		   cv->inputFileName, cv->SeismicRecords);
+	  fprintf (stdout, "Start Time:\t%d:%d:%d:%d:%d\n", cv->Year, cv->Day,
+		   cv->Hour, cv->Minute, cv->Second);
+	  fprintf (stdout, "End Time:\t%d:%d:%d:%d:%d\n", cv->endTime[0],
+		   cv->endTime[1], cv->endTime[2], cv->endTime[3],
+		   cv->endTime[4]);
+	  return -1;
 	}
 
       /*
-       * Is it subbottom?
+       * --split: only sensor messages ahead of the chunk, and nothing
+       * after it
        */
 
-      if (get_short (JSFmsg, 4) == Sonar_Data_Msg
-	  && (int) JSFmsg[7] == SubBottom)
+      if (cv->chunk != NULL && (k = split_where (cv)) != 0)
 	{
-	  if (!iFirst)
-	    {
-	      start_sb_size = get_int (JSFmsg, 12);
-	      iFirst++;
-	    }
-	  current_sb_size = get_int (JSFmsg, 12);
-
-	  if (current_sb_size != start_sb_size)
-	    {
-	      start_sb_size = current_sb_size;
-	      do_start_new_file ();
-	    }
+	  if (k > 0)
+	    return end_of_input (cv);
+	  if (!aux_sensor (cv->msg.type))
+	    continue;
+	}
+      else if (cv->msg.offset < cv->rangeFrom && !aux_sensor (cv->msg.type))
+	continue;
 
+      /*
+       * Is it subbottom?
+       */
 
+      if (cv->msg.type == Sonar_Data_Msg && cv->msg.subsystem == SubBottom)
+	{
 	  /*
 	   * Get the Edgetech "SEGY trace header"
 	   */
 
-	  SegBytes = read (in_fd, JSFSEGYHead, trhedlen);
-	  if (SegBytes != (int) trhedlen)
+	  cv->JSFSEGYHead = read_payload (cv, trhedlen);
+	  if (cv->JSFSEGYHead == NULL && cv->reader.stopped)
+	    {
+	      cv->JSFSEGYHead = noSEGYHead;	/* --follow ended mid ping */
+	      return end_of_input (cv);
+	    }
+	  if (cv->JSFSEGYHead == NULL)
 	    {
 	      fprintf (stderr,
 		       "%s: error reading JSF trace header and data\n",
 		       progname);
 	      perror ("read");
-	      err_exit ();
+	      return -1;
+	    }
+
+	  /*
+	   * --start, --first ... : pings outside the range are passed
+	   * over, and the first after it ends the conversion
+	   */
+
+	  if (do_Range && (k = ping_range (cv->JSFSEGYHead)) != 0)
+	    {
+	      if (k < 0)
+		continue;
+	      return end_of_input (cv);
 	    }
 
           /*
 	   * Get the number of samples trace header
 	   */
 
-           numberOfSamples = get_short (JSFSEGYHead, 114);
+           cv->numberOfSamples = get_short (cv->JSFSEGYHead, 114);
 
-          if (numberOfSamples  > 65535) {
+          if (cv->numberOfSamples  > 65535) {
 		fprintf(stdout, "Number of samples exceeds SEGY standard\n");
-	        close(outlu);
-		err_exit();
+		return -1;
           }	
 
 	  /*
 	   * Let's get the file start time first
 	   */
 
-	  if (!got_start_time)
+	  if (!cv->got_start_time)
 	    {
-	      Year = get_short (JSFSEGYHead, 198);
-	      Day = get_short (JSFSEGYHead, 196);
-	      Hour = get_short (JSFSEGYHead, 186);
-	      Minute = get_short (JSFSEGYHead, 188);
-	      Second = get_short (JSFSEGYHead, 190);
-	      got_start_time++;
+	      cv->Year = get_short (cv->JSFSEGYHead, 198);
+	      cv->Day = get_short (cv->JSFSEGYHead, 196);
+	      cv->Hour = get_short (cv->JSFSEGYHead, 186);
+	      cv->Minute = get_short (cv->JSFSEGYHead, 188);
+	      cv->Second = get_short (cv->JSFSEGYHead, 190);
+	      cv->got_start_time++;
 	    }
 
+	  end_time (cv, cv->JSFSEGYHead);
+
 	  /*
 	   * Get input data format
 	   */
 
-	  Data_Fmt = get_short (JSFSEGYHead, 34);
+	  cv->Data_Fmt = get_short (cv->JSFSEGYHead, 34);
 
 	  /*
-	   * Lets first check if this is the data we want
+	   * Lets first check if this is the data we want, and for which
+	   * products.  Each product checks its own pings for record length
+	   * changes and sets up its output file on the first ping.
 	   */
 
-	  if ((do_Envelope && Data_Fmt == Env_Data) ||
-	      (do_Analytic && Data_Fmt == Ana_Data) ||
-	      (do_Real && Data_Fmt == Real_Data) ||
-	      (xt_Real && Data_Fmt == Ana_Data))
+	  wanted = 0;
+	  for (k = 0; k < NSUBBOTTOM; k++)
 	    {
-
+	      pr = &cv->prod[k];
+	      if (!pr->want || product[k].fmt != cv->Data_Fmt)
+		continue;
+	      wanted++;
 
 	      /*
-	       * Check if first time through if yes setup the EBCDIC and
-	       * BCD Header and send to disk file.
+	       * --split: the files are already there, with their headers
 	       */
 
-	      if (!doing_SB)
+	      if (cv->chunk != NULL)
 		{
-		  if (!outlu)
-		    {
-		      if ((outlu =
-			   open (outFileName, O_WRONLY | O_CREAT | O_EXCL,
-				 PMODE)) == -1)
-			{
-			  fprintf (stderr, "%s: cannot open %s\n",
-				   outFileName, progname);
-			  perror ("open");
-			  err_exit ();
-			}
-		    }		// End !outlu
-	      sampInterval =
-		(unsigned short) get_int (JSFSEGYHead, 116) / 1000;
-	      sweepLength = (unsigned short) get_short (JSFSEGYHead, 130);
+		  if (split_output (cv, k) == -1)
+		    return -1;
+		  continue;
+		}
 
-		  do_ebcdic ();
-		  do_bcd ();
-		  do_calloc ();
+	      if (!pr->iFirst)
+		{
+		  pr->start_sb_size = get_int (cv->JSFmsg, 12);
+		  pr->iFirst++;
+		}
+	      pr->current_sb_size = get_int (cv->JSFmsg, 12);
 
-		  /*
-		   * Write EBCDIC header to output file
-		   */
+	      if (pr->current_sb_size != pr->start_sb_size)
+		{
+		  pr->start_sb_size = pr->current_sb_size;
+		  if (do_start_new_file (cv, pr) == -1)
+		    return -1;
+		}
 
-		  if ((bytes_written =
-		       write (outlu, ebcdic, EBCHDLEN)) != EBCHDLEN)
-		    {
-		      fprintf (stderr, "error writing EBCDIC header\n");
-		      perror ("write");
-		      err_exit ();
-		    }
+	      if (!pr->doing_SB && do_start_file (cv, pr) == -1)
+		return -1;
+	    }
 
-		  /*
-		   * Write BCD header to output file
-		   */
+	  if (wanted)
+	    {
+	      /*
+	       * Hand the trace to the converters: trace header, Weighting
+	       * factor, Edgetech subbottom data and, for each product, the
+	       * Segy trace header entries we bump here.
+	       */
 
-		  if (write (outlu, bcdhead, BCDHDLEN) != BCDHDLEN)
+	      ping = next_slot (cv);
+	      cv->filling = 1;
+	      ping->kind = PING_TRACE;
+	      ping->fmt = cv->Data_Fmt;
+	      ping->weight = -get_short (cv->JSFSEGYHead, 168);
+	      ping->nsamp = cv->numberOfSamples;
+	      ping->data_size = cv->msg.size - TRHDLEN;
+	      ping->chan = 0;
+	      ping->dead = 0;
+	      if (read_ping (cv, ping) == -1)
+		{
+		  if (cv->reader.stopped)
+		    {
+		      cv->filling = 0;	/* --follow ended mid ping */
+		      return end_of_input (cv);
+		    }
+		  fprintf (stdout,
+			   "%s: Error reading JSF seismic data\n", progname);
+		  perror ("read");
+		  return -1;
+		}
+	      aux_fix (cv, ping);
+	      for (k = 0; k < NPROD; k++)
+		{
+		  ping->prod[k].out = NULL;
+		  pr = &cv->prod[k];
+		  if (k < NSUBBOTTOM && pr->want
+		      && product[k].fmt == cv->Data_Fmt)
 		    {
-		      fprintf (stderr, "error writing BCD header \n");
-		      perror ("write");
-		      err_exit ();
+		      ++pr->pingNum;
+		      trace_out (cv, ping, k);
 		    }
-		  doing_SB++;	/* Set flag that we only want to go through here once */
-		}		/* END ! doing_SB */
+		}
+	      pipe_submit (&cv->pipe);
+	      cv->filling = 0;
+	      if (__atomic_load_n (&cv->failed, __ATOMIC_ACQUIRE))
+		return -1;
+	      follow_check (cv);
+
+	      ++cv->SeismicRecords;	/* Bump seismic record count */
+	    }			/* END IS SUBBOTTOM */
+	}			/* End Analytic or Envelope data check */
+
+      /*
+       * Navigation and attitude sensors, into the cache the pings after
+       * them are interpolated from
+       */
+
+      else if (aux_sensor (cv->msg.type) && cv->msg.size <= JSF_AUXMAX)
+	{
+	  if (cv->msg.offset < cv->auxAhead)
+	    continue;		/* already read ahead */
+	  if ((aux = read_payload (cv, cv->msg.size)) == NULL)
+	    {
+	      if (cv->reader.stopped)
+		return end_of_input (cv);
+	      fprintf (stderr, "%s: error reading JSF sensor message\n",
+		       progname);
+	      perror ("read");
+	      return -1;
+	    }
+	  aux_add (&cv->aux, cv->msg.type, aux, cv->msg.size);
+	  if (cv->auxAhead != -1)
+	    cv->auxAhead = cv->msg.offset + JSF_MSGHDRLEN + cv->msg.size;
+	}
+
+      /*
+       * Sidescan, into its own products in the same pass
+       */
+
+      else if (do_Sidescan
+	       && IS_SIDESCAN (cv->msg.type, cv->msg.subsystem))
+	{
+	  sp_retn = do_sidescan (cv);
+	  if (sp_retn == -1)
+	    return -1;
+	  if (sp_retn == 1)
+	    return end_of_input (cv);
+	}
+
+      /*
+       * Anything not read above (other messages, subbottom data we do
+       * not want) is skipped by the next jsf_next()
+       */
+    }				/* End while(1) Go back for more */
+}
+
+/*
+ * End of the input (or of --follow): close the output files once their
+ * traces are out and report
+ */
+
+int
+end_of_input (Conversion * cv)
+{
+  Product *pr;
+  uint64_t t;
+  int k;
+
+  for (k = NSUBBOTTOM; k < NPROD; k++)
+    {
+      pr = &cv->prod[k];
+      if (pr->ss_expect && ss_dead (cv, k, Stbd_SS, pr->ss_head) == -1)
+	return -1;
+    }
+  for (k = 0; k < NPROD; k++)
+    close_output (cv, &cv->prod[k]);
+  if (do_Stats)
+    {
+      t = stats_clock ();
+      pipe_finish (&cv->pipe);
+      stats_time (&cv->stats, STAT_WAIT, t, 0);
+    }
+  else
+    pipe_finish (&cv->pipe);
+  if (cv->chunk != NULL)
+    return 0;			/* --split: reported for the whole file */
+  fprintf (stdout,
+	   "%s End of File reached %d seismic records processed\n",
+	   cv->inputFileName, cv->SeismicRecords);
+  if (do_Sidescan)
+    fprintf (stdout, "%d sidescan traces\n", cv->SidescanRecords);
+  if (cv->aux.nsample[AUX_NAV] + cv->aux.nsample[AUX_ATT]
+      + cv->aux.nsample[AUX_PRESS] + cv->aux.nsample[AUX_DVL])
+    fprintf (stdout,
+	     "Sensors: %lu position, %lu attitude, %lu depth, %lu altitude samples\n",
+	     cv->aux.nsample[AUX_NAV], cv->aux.nsample[AUX_ATT],
+	     cv->aux.nsample[AUX_PRESS], cv->aux.nsample[AUX_DVL]);
+  fprintf (stdout, "Start Time:\t%d:%d:%d:%d:%d\n", cv->Year, cv->Day,
+	   cv->Hour, cv->Minute, cv->Second);
+  fprintf (stdout, "End Time:\t%d:%d:%d:%d:%d\n", cv->endTime[0],
+	   cv->endTime[1], cv->endTime[2], cv->endTime[3], cv->endTime[4]);
+  if (do_Follow)
+    fprintf (stdout,
+	     "Follow: %d flushes, ping read to trace in file %.1f ms mean, %.1f ms max\n",
+	     cv->nflush, cv->nflush ? cv->lat_sum / cv->nflush : 0.0,
+	     cv->lat_max);
+  return 0;
+}
+
+/*
+ * The time of the ping with sonar header head, kept for the End Time
+ * report: the header itself is gone with the next message read
+ */
+
+void
+end_time (Conversion * cv, const unsigned char *head)
+{
+  cv->endTime[0] = get_short (head, 198);
+  cv->endTime[1] = get_short (head, 196);
+  cv->endTime[2] = get_short (head, 186);
+  cv->endTime[3] = get_short (head, 188);
+  cv->endTime[4] = get_short (head, 190);
+}
+
+/*
+ * Trace sequence numbers and --follow bookkeeping of product k for the
+ * trace in p, whose ping number pr->pingNum is already set
+ */
+
+void
+trace_out (Conversion * cv, Ping * p, int k)
+{
+  Product *pr = &cv->prod[k];
+  PingOut *po = &p->prod[k];
+
+  po->out = pr->outlu;
+  po->raw = pr->raw;
+  po->dt = pr->bhead.mdt;
+  po->ping = pr->pingNum;
+  po->tseq_line = pr->tseq_line++;
+  po->tseq_reel = pr->tseq_reel++;
+  pr->ntraces++;
+  if (do_Follow && !pr->unflushed++)
+    clock_gettime (CLOCK_MONOTONIC, &pr->pending);
+}
+
+/*
+ * --follow while the input comes faster than it is read: flush anyway
+ * once a trace has waited FOLLOW_FLUSH ms
+ */
+
+void
+follow_check (Conversion * cv)
+{
+  struct timespec now;
+  Product *pr;
+  int k;
+
+  if (!do_Follow)
+    return;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  for (k = 0; k < NPROD; k++)
+    {
+      pr = &cv->prod[k];
+      if (pr->unflushed
+	  && (now.tv_sec - pr->pending.tv_sec) * 1000
+	  + (now.tv_nsec - pr->pending.tv_nsec) / 1000000 >= FOLLOW_FLUSH)
+	flush_output (cv, pr);
+    }
+}
+
+/*
+ * A sidescan message: one trace of its subsystem's ensemble, port then
+ * starboard.  Pings are paired on the JSF ping number; a channel missing
+ * from an ensemble is written as a dead trace so that port and starboard
+ * always alternate.  Returns 0, 1 if --follow ended mid message, or -1.
+ */
+
+int
+do_sidescan (Conversion * cv)
+{
+  Product *pr;
+  Ping *ping;
+  const unsigned char *head;
+  unsigned int pingno;
+  int k, chan, size;
+
+  k = cv->msg.subsystem == Low_Sidescan ? PROD_SSLF : PROD_SSHF;
+  pr = &cv->prod[k];
+  chan = cv->msg.channel;
+  if (!pr->want || (chan != Port_SS && chan != Stbd_SS)
+      || cv->msg.size < TRHDLEN)
+    return 0;
+
+  if ((head = read_payload (cv, trhedlen)) == NULL)
+    {
+      if (cv->reader.stopped)
+	return 1;
+      fprintf (stderr, "%s: error reading JSF sidescan header\n", progname);
+      perror ("read");
+      return -1;
+    }
+  if (do_Range && ss_out_of_range (head))
+    return 0;
+  pingno = get_int (head, 8);
+  size = get_int (cv->JSFmsg, 12);
+
+  /*
+   * Not the starboard of the port before it: that ensemble ends with a
+   * dead starboard
+   */
+
+  if (pr->ss_expect && (chan == Port_SS || pingno != pr->ss_ping
+			|| size != pr->start_sb_size)
+      && ss_dead (cv, k, Stbd_SS, pr->ss_head) == -1)
+    return -1;
+
+  if (!pr->iFirst)
+    {
+      pr->start_sb_size = size;
+      pr->iFirst++;
+    }
+  pr->current_sb_size = size;
+  cv->JSFSEGYHead = head;
+  cv->numberOfSamples = get_short (head, 114);
+  if (!cv->got_start_time)
+    {
+      cv->Year = get_short (head, 198);
+      cv->Day = get_short (head, 196);
+      cv->Hour = get_short (head, 186);
+      cv->Minute = get_short (head, 188);
+      cv->Second = get_short (head, 190);
+      cv->got_start_time++;
+    }
+  end_time (cv, head);
+  if (pr->current_sb_size != pr->start_sb_size)
+    {
+      pr->start_sb_size = pr->current_sb_size;
+      if (do_start_new_file (cv, pr) == -1)
+	return -1;
+    }
+  if (!pr->doing_SB && do_start_file (cv, pr) == -1)
+    return -1;
+
+  /*
+   * A starboard without its port: the ensemble starts with a dead port
+   */
+
+  if (chan == Stbd_SS && !pr->ss_expect
+      && ss_dead (cv, k, Port_SS, head) == -1)
+    return -1;
+
+  ping = next_slot (cv);
+  cv->filling = 1;
+  ping->kind = PING_TRACE;
+  ping->fmt = get_short (head, 34);
+  ping->weight = -get_short (head, 168);
+  ping->nsamp = cv->numberOfSamples;
+  ping->data_size = cv->msg.size - TRHDLEN;
+  ping->chan = chan;
+  ping->dead = 0;
+  if (read_ping (cv, ping) == -1)
+    {
+      cv->filling = 0;
+      if (cv->reader.stopped)
+	return 1;
+      fprintf (stdout, "%s: Error reading JSF sidescan data\n", progname);
+      perror ("read");
+      return -1;
+    }
+  aux_fix (cv, ping);
+  for (k = 0; k < NPROD; k++)
+    ping->prod[k].out = NULL;
+  k = pr - cv->prod;
+  if (chan == Port_SS)
+    {
+      ++pr->pingNum;
+      pr->ss_ping = pingno;
+      memcpy (pr->ss_head, head, TRHDLEN);
+    }
+  pr->ss_expect = chan == Port_SS;
+  trace_out (cv, ping, k);
+  pipe_submit (&cv->pipe);
+  cv->filling = 0;
+  if (__atomic_load_n (&cv->failed, __ATOMIC_ACQUIRE))
+    return -1;
+  follow_check (cv);
+  ++cv->SidescanRecords;
+  return 0;
+}
+
+/*
+ * A dead trace for sidescan channel chan, missing from the ensemble of
+ * product k, with the JSF header head of the channel that was there
+ */
+
+int
+ss_dead (Conversion * cv, int k, int chan, const unsigned char *head)
+{
+  Product *pr = &cv->prod[k];
+  Ping *ping;
+  int kk;
+
+  ping = next_slot (cv);
+  ping->kind = PING_TRACE;
+  ping->fmt = get_short (head, 34);
+  ping->weight = 0;
+  ping->nsamp = get_short (head, 114);
+  ping->data_size = 0;
+  ping->chan = chan;
+  ping->dead = 1;
+  memcpy (ping->head_buf, head, TRHDLEN);
+  ping->head = ping->head_buf;
+  ping->data = NULL;
+  aux_fix (cv, ping);
+  for (kk = 0; kk < NPROD; kk++)
+    ping->prod[kk].out = NULL;
+  if (chan == Port_SS)
+    ++pr->pingNum;
+  pr->ss_expect = chan == Port_SS;
+  trace_out (cv, ping, k);
+  pipe_submit (&cv->pipe);
+  if (__atomic_load_n (&cv->failed, __ATOMIC_ACQUIRE))
+    return -1;
+  return 0;
+}
+
+/*
+ * Reader side of a trace: keep the JSF trace header and data for the
+ * converters.  With -m both are views into the mapped file; otherwise
+ * (stream input too) the header is copied and the data read straight
+ * into the slot.
+ */
+
+int
+read_ping (Conversion * cv, Ping * p)
+{
+  unsigned char *nbuf;
+  uint64_t t = 0;
+
+  if (cv->reader.mode == JSF_MMAP)
+    p->head = cv->JSFSEGYHead;
+  else
+    {
+      memcpy (p->head_buf, cv->JSFSEGYHead, TRHDLEN);
+      p->head = p->head_buf;
+      if (p->data_size > p->data_alloc)
+	{
+	  if ((nbuf = (unsigned char *) realloc (p->data_buf,
+						 p->data_size)) == NULL)
+	    return -1;
+	  p->data_buf = nbuf;
+	  p->data_alloc = p->data_size;
+	}
+    }
+  if (do_Stats)
+    t = stats_clock ();
+  p->data = jsf_read_into (&cv->reader, p->data_size, p->data_buf);
+  if (do_Stats && p->data != NULL)
+    stats_time (&cv->stats, STAT_READ, t, p->data_size);
+  return p->data == NULL ? -1 : 0;
+}
+
+/*
+ * Converter: samples to SEG Y floats and the SEG Y trace header, for
+ * each product the ping is for.  Runs on a pool thread with -j, so it
+ * only touches the slot.
+ */
+
+void
+convert_ping (void *arg, void *slot)
+{
+  Conversion *cv = (Conversion *) arg;
+  Ping *p = (Ping *) slot;
+  PingOut *po;
+  int k;
+
+  if (p->kind != PING_TRACE)
+    return;
+
+  for (k = 0; k < NPROD; k++)
+    {
+      po = &p->prod[k];
+      if (po->out != NULL
+	  && convert_product (p, k, po, do_Stats ? &cv->stats : NULL) == -1)
+	{
+	  fprintf (stdout, "Error allocating trace storage\n");
+	  __atomic_store_n (&cv->failed, 1, __ATOMIC_RELEASE);
+	  return;
+	}
+    }
+}
+
+int
+convert_product (Ping * p, int k, PingOut * po, JSFStats * st)
+{
+  const unsigned char *h = p->head;
+  const unsigned char *src;
+  ShotHeader *t = &po->segy.thead;
+  unsigned char *th = (unsigned char *) &po->segy;
+  const AuxFix *f;
+  float *dst, *win, shift;
+  double ms = 0.0;
+  size_t need;
+  uint64_t t0 = 0;
+  int swap, cswap, statics, outfmt, pass, tweight;
+  int bps, nin, first, from, nout, lo, hi, lead, staged;
+
+  if (st != NULL)
+    t0 = stats_clock ();
+
+  /*
+   * With --window, --samples or --decimate, nout samples from JSF
+   * sample first on (either may be outside the trace), else all of them
+   */
+
+  first = 0;
+  nout = do_Gate ? gate_range (h, &first) : p->nsamp;
+  from = first;
+  need = (p->data_size + 1) / 2;
+  if (need < p->nsamp)
+    need = p->nsamp;
+  if (need < (size_t) nout)
+    need = nout;
+  if (need > po->sig_alloc)
+    {
+      free (po->sig);
+      free (po->tmp);
+      po->tmp = NULL;
+      if ((po->sig = (float *) calloc (need, sizeof (float))) == NULL
+	  || ((do_Static || gateDecim > 1)
+	      && (po->tmp = (float *) calloc (need, sizeof (float))) == NULL))
+	{
+	  po->sig_alloc = 0;
+	  return -1;
+	}
+      po->sig_alloc = need;
+    }
+
+  /*
+   * With --static, or --decimate, the samples are converted to host
+   * order in tmp, then shifted, windowed and decimated (and swapped)
+   * into sig
+   */
+
+  swap = po->raw ? 0 : segySwap;
+  outfmt = po->raw ? 5 : segyFormat;
+  statics = do_Static && k < NSUBBOTTOM && !p->dead;
+  staged = statics || (gateDecim > 1 && !p->dead);
+  dst = staged ? po->tmp : po->sig;
+  cswap = staged || outfmt != 5 ? 0 : swap;
+  tweight = 0;
+
+  /*
+   * int16 output of int16 samples: copied as they are, the Weighting
+   * going in the trace weighting factor instead (2^-Weighting per unit)
+   */
+
+  pass = outfmt == 3 && !staged && !p->dead
+    && (k == PROD_ENV || k == PROD_REAL || k == PROD_XREAL);
+
+  /*
+   * The JSF samples converted: all of them, or only those the window
+   * (and its filter) takes in.  Without a shift or decimation they go
+   * straight to where they belong in sig, zeros either side where the
+   * window runs past the trace.
+   */
+
+  bps = k == PROD_ANA || k == PROD_XREAL
+    || (k >= NSUBBOTTOM && p->fmt == Ana_Data) ? 4 : 2;
+  src = p->data;
+  nin = (int) ((p->data_size + bps - 1) / bps);
+  lead = 0;
+  if (do_Gate && !statics && !p->dead)
+    {
+      lo = first - (staged ? gateNtaps / 2 : 0);
+      hi = first + (nout - 1) * gateDecim + (staged ? gateNtaps / 2 : 0) + 1;
+      lo = lo < 0 ? 0 : lo > nin ? nin : lo;
+      hi = hi > nin ? nin : hi < lo ? lo : hi;
+      src += (size_t) lo * bps;
+      nin = hi - lo;
+      if (staged)
+	from -= lo;
+      else
+	{
+	  lead = nin > 0 ? lo - first : 0;
+	  if (lead > nout)
+	    lead = nout;
+	  memset (po->sig, 0, (size_t) nout * (pass ? 2 : 4));
+	  dst += lead;
+	}
+    }
+
+  if (p->dead)
+    memset (po->sig, 0, need * sizeof (float));
+  else if (pass)
+    {
+      if (k == PROD_XREAL)
+	conv_i16_i16 (src, 2, nin, swap, (short *) po->sig + lead);
+      else
+	conv_i16_i16 (src, 1, nin, swap, (short *) po->sig + lead);
+      tweight = -p->weight;
+    }
+  else
+  switch (k)
+    {
+    case PROD_SSLF:
+    case PROD_SSHF:
+
+      /*
+       * Sidescan: magnitudes, or the envelope of analytic samples
+       */
+
+      if (p->fmt == Ana_Data)
+	conv_ana_env (src, nin, p->weight, cswap, do_Precise, dst);
+      else
+	conv_u16_f32 (src, 1, nin, p->weight, cswap, dst);
+      break;
+
+    case PROD_ANA:
+
+      /*
+       * If Analytic data Start normalizing the real and imaginary
+       * parts of the signal.
+       */
+
+      conv_ana_env (src, nin, p->weight, cswap, do_Precise, dst);
+      break;
+
+    case PROD_REAL:
+
+      /*
+       * Real data
+       */
+
+      conv_i16_f32 (src, 1, nin, p->weight, cswap, dst);
+      break;
+
+    case PROD_XREAL:
+
+      /*
+       * Extracting Real from Analytic
+       */
+
+      conv_i16_f32 (src, 2, nin, p->weight, cswap, dst);
+      break;
+
+    case PROD_ENV:
+
+      /*
+       * Envelope Data
+       */
+
+      conv_i16_f32 (src, 1, nin, p->weight, cswap, dst);
+      break;
+    }
+
+  if (statics)
+    {
+      shift = static_shift (p, &ms);
+      conv_shift_f32 (po->tmp, p->nsamp, shift,
+		      outfmt == 5 && !do_Gate ? swap : 0, po->sig);
+      nin = p->nsamp;
+    }
+
+  /*
+   * Window and decimation of the staged samples, after the shift
+   * (sig to tmp, which then trade places) or straight from tmp
+   */
+
+  if (do_Gate && staged)
+    {
+      win = statics ? po->sig : po->tmp;
+      dst = statics ? po->tmp : po->sig;
+      conv_decim_f32 (win, nin, from, gateDecim, gateTaps, gateNtaps,
+		      outfmt == 5 ? swap : 0, nout, dst);
+      po->tmp = win;
+      po->sig = dst;
+    }
+
+  /*
+   * Other sample formats are packed from the floats, in place.  Integer
+   * traces are scaled by a power of two to fill the integer at their
+   * peak, which goes in the trace weighting factor.
+   */
+
+  if (!p->dead && !pass)
+    switch (outfmt)
+      {
+      case 1:
+	conv_f32_ibm (po->sig, nout, 0, swap, po->sig);
+	break;
+      case 2:
+	tweight = conv_int_weight (conv_peak_f32 (po->sig, nout), 32);
+	conv_f32_i32 (po->sig, nout, tweight, swap, po->sig);
+	break;
+      case 3:
+	tweight = conv_int_weight (conv_peak_f32 (po->sig, nout), 16);
+	conv_f32_i16 (po->sig, nout, tweight, swap, po->sig);
+	break;
+      case 8:
+	tweight = conv_int_weight (conv_peak_f32 (po->sig, nout), 8);
+	conv_f32_i8 (po->sig, nout, tweight, swap, po->sig);
+	break;
+      }
+
+  po->nval = (size_t) nout * SAMPLE_BYTES (outfmt);
+  if (st != NULL)
+    t0 = stats_time (st, STAT_CONVERT, t0, p->data_size);
+
+  /*
+   * OK, done seismic data conversion let's get the SEGY Trace
+   * Header setup
+   */
+
+  map_apply (&hdrMap, h, th);	/* thMap, the constants and the copies */
+  t->tseq_line = seg_u32 (po->tseq_line);	/* sequence number */
+  t->tseq_reel = seg_u32 (po->tseq_reel);	/* bump again */
+  t->fldrec = seg_u32 (po->ping);	/* ping number */
+  t->fldtr = seg_u32 (p->chan + 1);	/* trace number */
+  if (p->dead)
+    t->trcode = seg_u16 (2);	/* dead */
+  t->nttr = seg_u16 (nout);	/* samples this trace */
+  if (do_Gate)
+    t->delay = seg_i16 ((short) lrint ((get_int (h, 4) + first)
+				       * (get_int (h, 116) / 1e6)));	/* ms to the first sample */
+  t->dt = po->dt;		/* sampling interval */
+  t->tweight = seg_i16 ((short) tweight);	/* 2^-tweight per unit */
+  if (statics)
+    t->dummy1[2] = seg_i16 ((short) lrint (ms));	/* total static applied, ms */
+
+  /*
+   * Navigation and attitude interpolated from the sensor messages,
+   * where there were any, over the sonar's own coarse values.  Attitude
+   * has no SEG Y field and goes in the unassigned bytes 233-240 (0
+   * without an attitude sensor), set by offset as ShotHeader does not
+   * reach them.
+   */
+
+  f = &p->fix;
+  if (f->have & (1u << AUX_NAV))
+    {
+      t->xsc = t->xrc = seg_i32 ((int) lrint (f->v[AUX_LON] * 3600000.0));	/* arc seconds */
+      t->ysc = t->yrc = seg_i32 ((int) lrint (f->v[AUX_LAT] * 3600000.0));
+    }
+  else if (p->navSeen)
+    sonar_xy (h, t);
+  if (f->have & (1u << AUX_PRESS))
+    t->elev = t->selev = t->sdepth =
+      seg_i32 ((int) lrint (f->v[AUX_DEPTH] * 1000.0));	/* mm */
+  if (f->have & (1u << AUX_DVL))
+    t->swdepth = t->rwdepth =
+      seg_i32 ((int) lrint (f->v[AUX_ALTITUDE] * 1000.0));	/* mm */
+  st_seg16 (th + TH_PITCH, (uint16_t) aux_field (f->v[AUX_PITCH], 100.0,
+						  -32768, 32767));
+  st_seg16 (th + TH_ROLL, (uint16_t) aux_field (f->v[AUX_ROLL], 100.0,
+						 -32768, 32767));
+  st_seg16 (th + TH_HEADING, (uint16_t) aux_field (f->v[AUX_HEADING], 100.0,
+						    0, 65535));
+  st_seg16 (th + TH_HEAVE, (uint16_t) aux_field (f->v[AUX_HEAVE], 1000.0,
+						  -32768, 32767));
+  if (st != NULL)
+    stats_time (st, STAT_HEADER, t0, TRHDLEN);
+  return 0;
+}
+
+/*
+ * --static: the delay, in samples, that puts time zero of the trace at
+ * the sea surface: the two way time through the vehicle depth (from the
+ * pressure sensor, else the sonar's own) less the heave (up positive).
+ * *ms is the same in milliseconds.
+ */
+
+float
+static_shift (const Ping * p, double *ms)
+{
+  const AuxFix *f = &p->fix;
+  double depth = 0.0, dt;
+
+  if (do_Static & STATIC_DEPTH)
+    depth = f->have & (1u << AUX_PRESS) ? f->v[AUX_DEPTH]
+      : get_int (p->head, 136) / 1000.0;
+  if ((do_Static & STATIC_HEAVE) && !isnan (f->v[AUX_HEAVE]))
+    depth -= f->v[AUX_HEAVE];
+  *ms = 2000.0 * depth / soundVel;
+  dt = get_int (p->head, 116) / 1e6;	/* sample interval, ms */
+  return dt > 0.0 ? (float) (*ms / dt) : 0.0f;
+}
+
+/*
+ * --window, --samples: the first JSF sample kept of the trace with
+ * header h, which may be before the trace or past its end, and the
+ * number of samples kept from it on, every gateDecim'th one.  A time
+ * window is two-way time from the ping, less the trace's start depth
+ * (window offset, in samples).  Fixed for the record length of a file.
+ */
+
+int
+gate_range (const unsigned char *h, int *first)
+{
+  int dt = get_int (h, 116);	/* sample interval, ns */
+  long last;
+
+  if (gateTime && dt > 0)
+    {
+      *first = (int) lrint (gateT0 * 1e6 / dt) - get_int (h, 4);
+      last = *first + (long) floor ((gateT1 - gateT0) * 1e6 / dt);
+    }
+  else
+    {
+      *first = gateTime ? 0 : gateFirst;
+      last = gateLast >= 0 && !gateTime ? gateLast
+	: (long) (unsigned short) get_short (h, 114) - 1;
+    }
+  if (last < *first)
+    return 0;
+  last = (last - *first) / gateDecim + 1;
+  return last > 65535 ? 65535 : (int) last;
+}
+
+/*
+ * Samples per trace in the output file being started
+ */
+
+int
+gate_samples (Conversion * cv)
+{
+  int first;
+
+  return do_Gate ? gate_range (cv->JSFSEGYHead, &first)
+    : cv->numberOfSamples;
+}
+
+/*
+ * The sonar's own position, in trace header t of a ping without a
+ * position fix in a file that has had one: a longitude and latitude
+ * (coordinate units 2, minutes of arc times 10000, or 0 from before the
+ * units field) in the arc seconds times 1000 of the fixes, so that the
+ * units do not change within a file where the fixes lapse.  Easting and
+ * northing (units 1, 3 and 4, mm, dm and cm) cannot be, and are left as
+ * thMap copied them with their own units and scale.  Only the fields in
+ * sonarXY, those --header-map left as they were, are set.
+ */
+
+void
+sonar_xy (const unsigned char *h, ShotHeader * t)
+{
+  int x = get_int (h, 80) * 6, y = get_int (h, 84) * 6;
+
+  switch (get_short (h, 88))
+    {
+    case 1:
+    case 3:
+    case 4:
+      if (sonarXY & XY_UNIT)
+	t->map_unit = seg_u16 (1);	/* length */
+      if (sonarXY & XY_SCALE)
+	t->map_scale = seg_i16 (get_short (h, 88) == 1 ? -1000
+				: get_short (h, 88) == 3 ? -10 : -100);	/* m */
+      return;
+    }
+  if (sonarXY & XY_XSC)
+    t->xsc = seg_i32 (x);
+  if (sonarXY & XY_XRC)
+    t->xrc = seg_i32 (x);
+  if (sonarXY & XY_YSC)
+    t->ysc = seg_i32 (y);
+  if (sonarXY & XY_YRC)
+    t->yrc = seg_i32 (y);
+}
+
+/*
+ * The sonar_xy() fields the trace header mapping has as thMap does, in
+ * sonarXY.  A field --header-map changed, or dropped, is left to it.
+ */
+
+void
+sonar_xy_fields (void)
+{
+  static const char *const names[] = {
+    "xsc", "xrc", "ysc", "yrc", "map_unit", "map_scale"
+  };
+  const MapEntry *e, *d;
+  size_t k, n;
+  int j;
+
+  sonarXY = 0;
+  for (k = 0; k < sizeof (names) / sizeof (names[0]); k++)
+    for (j = 0; j < hdrMap.nent; j++)
+      {
+	e = &hdrMap.ent[j];
+	if (strcasecmp (e->field, names[k]) != 0)
+	  continue;
+	for (n = 0; n < sizeof (thMap) / sizeof (thMap[0]); n++)
+	  {
+	    d = &thMap[n];
+	    if (strcmp (d->field, names[k]) == 0 && d->src == e->src
+		&& d->type == e->type && d->scale == e->scale)
+	      sonarXY |= 1u << k;
+	  }
+      }
+}
+
+/*
+ * The fix of the ping in p.  Sensor messages come before the pings they
+ * bracket, so those after it are read ahead first, straight from the
+ * file with the reader left where it is, while aux_wants() says a
+ * sample after the ping may still come and for at most AUX_AHEAD bytes
+ * past it.  A stream is not read ahead: its pings hold the samples
+ * before them.
+ */
+
+void
+aux_fix (Conversion * cv, Ping * p)
+{
+  const unsigned char *hdr, *buf;
+  double t = aux_ping_time (p->head);
+  unsigned int type;
+  uint32_t size;
+
+  while (cv->auxAhead != -1 && cv->auxAhead < cv->msg.offset + AUX_AHEAD
+	 && aux_wants (&cv->aux, t))
+    {
+      if ((hdr = ahead_read (cv, cv->auxAhead, JSF_MSGHDRLEN)) == NULL
+	  || get_short (hdr, 0) != Start_Of_Message)
+	break;			/* the end of the file (so far), or not a
+				   message: the reader will see */
+      type = ld_le16 (hdr + 4);
+      size = ld_le32 (hdr + 12);
+      if (aux_sensor (type) && size <= JSF_AUXMAX)
+	{
+	  if ((buf = ahead_read (cv, cv->auxAhead + JSF_MSGHDRLEN, size))
+	      == NULL)
+	    break;
+	  aux_add (&cv->aux, type, buf, size);
+	}
+      cv->auxAhead += JSF_MSGHDRLEN + (off_t) size;
+    }
+  aux_at (&cv->aux, t, &p->fix);
+  if (p->fix.have & (1u << AUX_NAV))
+    cv->navSeen = 1;
+  p->navSeen = cv->navSeen;
+}
+
+/*
+ * n bytes of the input at offset at for the read ahead: from the
+ * mapping, else a block read from there on.  NULL past the end of the
+ * file (or on an error, left to the reader to report).
+ */
+
+const unsigned char *
+ahead_read (Conversion * cv, off_t at, size_t n)
+{
+  ssize_t got;
+
+  if (cv->reader.map != NULL)
+    return (size_t) at + n <= cv->reader.map_len ? cv->reader.map + at
+      : NULL;
+  if (at >= cv->aheadAt && at + (off_t) n <= cv->aheadAt
+      + (off_t) cv->aheadLen)
+    return cv->aheadBuf + (at - cv->aheadAt);
+  if (cv->aheadBuf == NULL
+      && (cv->aheadBuf = (unsigned char *) malloc (AHEAD_BLOCK)) == NULL)
+    return NULL;
+  cv->aheadAt = at;
+  cv->aheadLen = 0;
+  if ((got = pread (cv->reader.fd, cv->aheadBuf, AHEAD_BLOCK, at)) > 0)
+    cv->aheadLen = (size_t) got;
+  return n <= cv->aheadLen ? cv->aheadBuf : NULL;
+}
+
+/*
+ * A sensor value in units of 1/scale for a 16 bit header field holding
+ * lo ... hi, 0 if the sensor did not give it
+ */
+
+int
+aux_field (double v, double scale, int lo, int hi)
+{
+  if (isnan (v))
+    return 0;
+  v = rint (v * scale);
+  return v > hi ? hi : v < lo ? lo : (int) v;
+}
+
+/*
+ * Writer: runs in ping order on the writer thread with -j.  With
+ * --stats each slot is timed as a whole.
+ */
+
+void
+write_ping (void *arg, void *slot)
+{
+  Conversion *cv = (Conversion *) arg;
+  Ping *p = (Ping *) slot;
+  uint64_t t, bytes = 0;
+  int k;
+
+  if (!do_Stats)
+    {
+      write_slot (cv, p);
+      return;
+    }
+  t = stats_clock ();
+  write_slot (cv, p);
+  if (p->kind == PING_HEADERS)
+    bytes = EBCHDLEN + BCDHDLEN;
+  else if (p->kind == PING_TRACE)
+    for (k = 0; k < NPROD; k++)
+      if (p->prod[k].out != NULL)
+	bytes += (p->prod[k].raw ? 0 : TRHDLEN) + p->prod[k].nval;
+  stats_time (&cv->stats, STAT_WRITE, t, bytes);
+}
+
+/*
+ * Write one slot.  After a failed write the rest of the traces are
+ * dropped and the reader stops.
+ */
+
+void
+write_slot (Conversion * cv, Ping * p)
+{
+  PingOut *po;
+  struct timespec now;
+  unsigned char count[8];
+  double lat;
+  int k;
+
+  if (p->kind != PING_CLOSE && __atomic_load_n (&cv->failed, __ATOMIC_ACQUIRE))
+    return;
+
+  switch (p->kind)
+    {
+    case PING_HEADERS:
 
-	      /*
-	       * Get trace Weighting factor
-	       */
+      /*
+       * Write EBCDIC header to output file
+       */
 
-	      Weighting = get_short (JSFSEGYHead, 168);
-	      Weighting = -Weighting;
+      if (segy_write (p->out, p->ebcdic, EBCHDLEN) == -1)
+	{
+	  fprintf (stderr, "error writing EBCDIC header\n");
+	  perror ("write");
+	  break;
+	}
 
-	      /*
-	       * Lets start processing Edgetech subbottom data
-	       */
+      /*
+       * Write BCD header to output file
+       */
 
-	      inbytes = read (in_fd, JSFData, DataSize);
-	      if (inbytes != (int) DataSize)
-		{
-		  fprintf (stdout,
-			   "%s: Error reading JSF seismic data\n", progname);
-		  perror ("read");
-		  err_exit ();
-		}
+      if (segy_write (p->out, &p->bhead, BCDHDLEN) == -1)
+	{
+	  fprintf (stderr, "error writing BCD header \n");
+	  perror ("write");
+	  break;
+	}
+      return;
 
-	      /*
-	       * Bump some Segy trace header entries
-	       */
+    case PING_TRACE:
+      for (k = 0; k < NPROD; k++)
+	{
+	  po = &p->prod[k];
+	  if (po->out == NULL)
+	    continue;
 
-	      pingNum++;
+	  /*
+	   * Now send out the Trace header, unless the output is raw
+	   */
 
-	      /*
-	       * If Analytic data Start normalizing the real and imaginary
-	       * parts of the signal.
-	       */
+	  if (!po->raw && segy_write (po->out, &po->segy.thead, TRHDLEN) == -1)
+	    {
+	      fprintf (stdout, "error writing trace header \n");
+	      perror ("write");
+	      break;
+	    }
 
-	      if (do_Analytic && Data_Fmt == Ana_Data)
-		{
-		  for (i = 0, j = 0; i < (int) DataSize; i += 4, j++)
-		    {
-		      floatSig[j] = (float)
-			(sqrt ((double)
-			       ldexp ((double) get_short (JSFData, i),
-				      Weighting) *
-			       (double) ldexp ((double)
-					       get_short (JSFData, i),
-					       Weighting)
-			       + (double) ldexp ((double)
-						 get_short (JSFData,
-							    i + 2),
-						 Weighting) *
-			       (double) ldexp ((double)
-					       get_short (JSFData, i + 2),
-					       Weighting)));
-		      if (LITTLE)
-			floatSig[j] = floatFlip (&floatSig[j]);
-		    }
-		  nval = (size_t) numberOfSamples * (int) sizeof (float);
-		}		// End do_Analytic
+	  /*
+	   * Now send Seismic data to disk file
+	   */
 
-	      /*
-	       * Check if Real data
-	       */
+	  if (segy_write (po->out, po->sig, po->nval) == -1)
+	    {
+	      fprintf (stdout, "Error writing SEGY trace\n");
+	      perror ("write");
+	      break;
+	    }
+	}
+      if (k == NPROD)
+	return;
+      break;
 
-	      if (do_Real && Data_Fmt == Real_Data)
-		{
-		  for (i = j = 0; j < (int) DataSize; i++, j += 2)
-		    {
-		      floatSig[i] =
-			ldexpf ((float) get_short (JSFData, j), Weighting);
-		      if (LITTLE)
-			floatSig[i] = floatFlip (&floatSig[i]);
-		    }
-		  nval = (size_t) numberOfSamples * (int) sizeof (float);
-		}		// End do_Real
+    case PING_FLUSH:
 
-	      /*
-	       * Check if extracting Real from Analytic
-	       */
+      /*
+       * --follow: trace count into the binary header, then whatever is
+       * in the block out to the file, and the latency of the oldest
+       * trace in it
+       */
 
-	      if (xt_Real && Data_Fmt == Ana_Data)
-		{
-		  for (i = 0, j = 0; i < (int) DataSize; i += 4, j++)
-		    {
-		      floatSig[j] =
-			ldexpf ((float) get_short (JSFData, i), Weighting);
-		      if (LITTLE)
-			floatSig[j] = floatFlip (&floatSig[j]);
-		    }
-		  nval = (size_t) numberOfSamples * (int) sizeof (float);
-		}		// End xt_Real
+      st_seg64 (count, (uint64_t) p->ntraces);
+      if ((!p->out->stream && p->ntraces
+	   && segy_patch (p->out, EBCHDLEN + BCD_NTRACES, count, 8) == -1)
+	  || segy_flush (p->out) == -1)
+	{
+	  fprintf (stdout, "Error writing SEGY trace\n");
+	  perror ("write");
+	  break;
+	}
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      lat = (now.tv_sec - p->since.tv_sec) * 1e3
+	+ (now.tv_nsec - p->since.tv_nsec) / 1e6;
+      cv->nflush++;
+      cv->lat_sum += lat;
+      if (lat > cv->lat_max)
+	cv->lat_max = lat;
+      return;
 
-	      /*
-	       * Check if Envelope Data
-	       */
+    case PING_CLOSE:
 
-	      if (do_Envelope && Data_Fmt == Env_Data)
-		{
-		  for (i = j = 0; j < (int) DataSize; i++, j += 2)
-		    {
-		      floatSig[i] =
-			ldexpf ((float) get_short (JSFData, j), Weighting);
-		      if (LITTLE)
-			floatSig[i] = floatFlip (&floatSig[i]);
-		    }
-		  nval = (size_t) numberOfSamples * (int) sizeof (float);
-		}		// End do_Envelope
+      /*
+       * Last block out.  Errors already reported need no second message.
+       */
 
-	      /*
-	       * OK, done seismic data conversion let's get the SEGY Trace
-	       * Header setup
-	       */
+      if (segy_close (p->out) == 0
+	  || __atomic_load_n (&cv->failed, __ATOMIC_ACQUIRE))
+	return;
+      fprintf (stdout, "Error writing SEGY trace\n");
+      perror ("close");
+      break;
+    }
+  __atomic_store_n (&cv->failed, 1, __ATOMIC_RELEASE);
+}
 
-	      floatSegy.thead.tseq_line = swap_uint32 (tseq_line++);                    /* sequence number */
-	      floatSegy.thead.tseq_reel = swap_uint32 (tseq_reel++);                    /* bump again */
-	      floatSegy.thead.fldrec = swap_uint32 (pingNum);                           /* ping number */
-	      floatSegy.thead.fldtr = swap_uint32 (1);                                  /* trace number */
-	      floatSegy.thead.trcode = swap_uint16 (1);                                 /* Seismic data */
-              floatSegy.thead.elev = swap_int32 (get_int (JSFSEGYHead, 136));           /* receiver pressure depth (mm)*/
-              floatSegy.thead.selev = swap_int32 (get_int (JSFSEGYHead, 136));          /* source pressure depth (mm) */
-              floatSegy.thead.swdepth = swap_int32 (get_int (JSFSEGYHead, 144));        /* water depth at source (mm)*/
-              floatSegy.thead.rwdepth = swap_int32 (get_int (JSFSEGYHead, 144));        /* water depth at receiver (mm) */
-	      floatSegy.thead.offset = swap_int32 (get_short (JSFSEGYHead, 38));	/* s - r offset */
-	      floatSegy.thead.nttr = swap_uint16 (numberOfSamples);                     /* samples this trace */
-	      floatSegy.thead.dt = bhead.mdt;                                           /* sampling interval */
-	      floatSegy.thead.gaincon = swap_uint16 (get_short (JSFSEGYHead, 120));	/* gain constant */
-	      floatSegy.thead.year = swap_uint16 (get_short (JSFSEGYHead, 198));	/* year of recording */
-	      floatSegy.thead.julday = swap_uint16 (get_short (JSFSEGYHead, 196));	/* day of recording */
-	      floatSegy.thead.hour = swap_uint16 (get_short (JSFSEGYHead, 186));	/* hour of recording */
-	      floatSegy.thead.minute = swap_uint16 (get_short (JSFSEGYHead, 188));	/* minute of recording */
-	      floatSegy.thead.second = swap_uint16 (get_short (JSFSEGYHead, 190));	/* second of recording */
-	      floatSegy.thead.tbasis = swap_uint16 (4);                                 /* UTC time */
-	      floatSegy.thead.map_scale = swap_int16 (-1000);
-	      floatSegy.thead.xsc = floatSegy.thead.xrc = swap_int32 (get_int (JSFSEGYHead, 80));	/* Longitude */
-	      floatSegy.thead.ysc = floatSegy.thead.yrc = swap_int32 (get_int (JSFSEGYHead, 84));	/* Latitude */
-	      floatSegy.thead.map_unit = swap_uint16 (2);                               /* Lon, Lat */
-	      floatSegy.thead.survey_scale = swap_int16 (-1000);                        /* depth values in * millimeters */
-	      floatSegy.thead.correl = swap_uint16 (2);                                 /* Correlated */
-	      floatSegy.thead.stfreq = swap_uint16 (get_short (JSFSEGYHead, 126) * 10);	/* Start Frequency of * Chirp */
-	      floatSegy.thead.enfreq = swap_uint16 (get_short (JSFSEGYHead, 128) * 10);	/* End Frequency of * Chirp */
-	      floatSegy.thead.swplen = swap_uint16 (get_short (JSFSEGYHead, 130));	/* Sweep length in * milliseconds */
-	      floatSegy.thead.swptyp = swap_uint16 (1);	/* Linear Sweep */
+/*
+ * Buffers a slot picked up on its way through the pipeline
+ */
 
-	      /*
-	       * Now send out the Trace header
-	       */
+void
+free_ping (void *arg, void *slot)
+{
+  Ping *p = (Ping *) slot;
+  int k;
 
-	      if (write (outlu, THead, trhedlen) != (int) trhedlen)
-		{
-		  fprintf (stdout, "error writing trace header \n");
-		  perror ("write");
-		  err_exit ();
-		}
+  (void) arg;
+  free (p->data_buf);
+  for (k = 0; k < NPROD; k++)
+    {
+      free (p->prod[k].sig);
+      free (p->prod[k].tmp);
+    }
+}
 
-	      /*
-	       * Now send Seismic data to disk file
-	       */
+/*
+ * Step to the next message.  With an index, only the subbottom (and
+ * with -s or -S sidescan) and sensor messages are visited and the
+ * reader seeks straight to each one.  With --stats the rest of the
+ * previous message is skipped here, so the skipping is timed on its
+ * own, and every message (also those the index passes over) is
+ * tallied by type.
+ */
 
-	      if (write (outlu, floatSig, nval) != (int) nval)
-		{
-		  fprintf (stdout, "Error writing SEGY trace\n");
-		  perror ("write");
-		  err_exit ();
-		}
-	      ++SeismicRecords;	/* Bump seismic record count */
-	      ProcessedPing++;	/* Set flag for lseek below */
-	    }			/* END IS SUBBOTTOM */
+int
+next_message (Conversion * cv)
+{
+  JSFIndexEntry *e;
+  JSFStats *st = do_Stats ? &cv->stats : NULL;
+  uint64_t t = 0, rest, passed = 0;
+  int ret;
 
-	  if (!ProcessedPing)
+  if (st != NULL)
+    {
+      t = stats_clock ();
+      if (stats_due (st, t))
+	stats_report (cv, 0);
+      if ((rest = cv->reader.size - cv->reader.used) > 0)
+	{
+	  stats_skip (st, cv->msg.type, rest);
+	  if (jsf_skip (&cv->reader) == -1)
+	    return -1;
+	  t = stats_time (st, STAT_SKIP, t, rest);
+	}
+    }
+  if (cv->use_index)
+    {
+      for (; cv->idx_next < cv->jsfindex.count; cv->idx_next++)
+	{
+	  e = &cv->jsfindex.ent[cv->idx_next];
+	  if (e->type == Sonar_Data_Msg && e->subsystem == SubBottom)
+	    break;
+	  if (do_Sidescan && IS_SIDESCAN (e->type, e->subsystem))
+	    break;
+	  if (aux_sensor (e->type))
+	    break;
+	  if (st != NULL)
 	    {
-	      offset = (off_t) (get_int (JSFmsg, 12) - SegBytes);
-	      where = lseek (in_fd, offset, SEEK_CUR);
-	      ProcessedPing++;	/* Set flag for lseek below */
+	      stats_message (st, e->type, JSF_MSGHDRLEN + (uint64_t) e->size);
+	      stats_skip (st, e->type, e->size);
+	      passed += JSF_MSGHDRLEN + (uint64_t) e->size;
 	    }
-	}			/* End Analytic or Envelope data check */
+	}
+      if (cv->idx_next == cv->jsfindex.count)
+	return ZERO;
+      if (jsf_seek (&cv->reader, cv->jsfindex.ent[cv->idx_next++].offset) ==
+	  -1)
+	return -1;
+      if (st != NULL)
+	t = stats_time (st, STAT_SKIP, t, passed);
+    }
+  ret = jsf_next (&cv->reader, &cv->msg);
+  if (st != NULL && ret == 1)
+    {
+      stats_time (st, STAT_READ, t, JSF_MSGHDRLEN);
+      stats_message (st, cv->msg.type, JSF_MSGHDRLEN + (uint64_t) cv->msg.size);
+    }
+  return ret;
+}
 
-      /*
-       * Not subbottom so skip record Already have header just skip data
-       */
+/*
+ * --start, --first: put the reader at the first ping of the range,
+ * found by bisection over the file, and the index walk (if any) there;
+ * or rather SPLIT_WARMUP bytes before it, as --split does for a chunk,
+ * for the sensor messages the fixes of the first pings come from.  A
+ * stream is read from the start, the pings before the range passed
+ * over one by one.
+ */
 
-      if (!ProcessedPing)
-	{
-	  offset = (off_t) get_int (JSFmsg, 12);
-	  where = lseek (in_fd, offset, SEEK_CUR);
-	}
-    }				/* End while(1) Go back for more */
-}				/* End main() */
+int
+range_seek (Conversion * cv)
+{
+  off_t at, warm = 0;
+  uint64_t t = 0;
+
+  if (rangeStart == INT64_MIN || cv->reader.mode == JSF_STREAM)
+    return 0;
+  if (do_Stats)
+    t = stats_clock ();
+  if ((at = jsfseek_find (cv->reader.fd, rangeBy, rangeStart)) != -1
+      && at > SPLIT_WARMUP
+      && ((warm = jsfseek_sync (cv->reader.fd, at - SPLIT_WARMUP)) == -1
+	  || warm > at))
+    warm = at;
+  if (at == -1 || jsf_seek (&cv->reader, warm) == -1)
+    {
+      fprintf (stderr, "%s: cannot find the start of the range in %s\n",
+	       progname, cv->inputFileName);
+      perror ("read");
+      return -1;
+    }
+  cv->rangeFrom = at;
+  cv->auxAhead = warm;
+  index_from (cv, warm);
+  if (do_Stats)
+    stats_time (&cv->stats, STAT_SKIP, t, (uint64_t) warm);
+  if (at > 0)
+    fprintf (stdout, "Starting at byte %lld of %s\n", (long long) at,
+	     cv->inputFileName);
+  return 0;
+}
+
+/*
+ * With an index, start its walk at the first message at or after at
+ */
+
+void
+index_from (Conversion * cv, off_t at)
+{
+  size_t lo, hi, mid;
+
+  if (!cv->use_index)
+    return;
+  lo = 0;
+  hi = cv->jsfindex.count;
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (cv->jsfindex.ent[mid].offset < at)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  cv->idx_next = lo;
+}
+
+/*
+ * Where the ping with JSF header head is: -1 before the range, 0 in it,
+ * 1 after it
+ */
+
+int
+ping_range (const unsigned char *head)
+{
+  int64_t key = jsfseek_key (head, rangeBy);
+
+  return key < rangeStart ? -1 : key > rangeEnd ? 1 : 0;
+}
+
+/*
+ * Is the sidescan ping with JSF header head outside the range?  Sidescan
+ * pings are numbered apart from the subbottom's, so only --start/--end
+ * apply to them, and one past the end is passed over rather than ending
+ * the conversion: the first subbottom ping past it does that.
+ */
+
+int
+ss_out_of_range (const unsigned char *head)
+{
+  return rangeBy == JSFSEEK_TIME && ping_range (head) != 0;
+}
+
+/*
+ * The next n bytes of the current message, timed with --stats
+ */
+
+const unsigned char *
+read_payload (Conversion * cv, size_t n)
+{
+  const unsigned char *p;
+  uint64_t t;
+
+  if (!do_Stats)
+    return jsf_read (&cv->reader, n);
+  t = stats_clock ();
+  if ((p = jsf_read (&cv->reader, n)) != NULL)
+    stats_time (&cv->stats, STAT_READ, t, n);
+  return p;
+}
+
+/*
+ * A free pipeline slot for the reader.  With --stats the time spent
+ * waiting for one, while the converters or the writer catch up, is
+ * timed.
+ */
+
+Ping *
+next_slot (Conversion * cv)
+{
+  Ping *p;
+  uint64_t t;
+
+  if (!do_Stats)
+    return (Ping *) pipe_next (&cv->pipe);
+  t = stats_clock ();
+  p = (Ping *) pipe_next (&cv->pipe);
+  stats_time (&cv->stats, STAT_WAIT, t, 0);
+  return p;
+}
+
+/*
+ * --stats: one JSON line on the conversion, periodic (final 0) or at
+ * its end
+ */
+
+void
+stats_report (Conversion * cv, int final)
+{
+  static const char *name[NPROD] = {
+    "env", "ana", "real", "xreal", "sslf", "sshf"
+  };
+  char *head = NULL;
+  size_t len = 0;
+  FILE *f;
+  int k, n;
+
+  if ((f = open_memstream (&head, &len)) == NULL)
+    return;
+  fprintf (f, "\"input\":");
+  stats_string (f, cv->inputFileName);
+  fprintf (f, ",\"final\":%s", final ? "true" : "false");
+  if (final)
+    fprintf (f, ",\"status\":\"%s\"", cv->status ? "failed" : "ok");
+  fprintf (f, ",\"input_bytes\":%lld,\"position\":%lld,\"mode\":\"%s\","
+	   "\"workers\":%d,\"seismic_records\":%d,\"sidescan_records\":%d",
+	   (long long) cv->inbytes, (long long) cv->reader.pos,
+	   cv->reader.mode == JSF_MMAP ? "mmap"
+	   : cv->reader.mode == JSF_STREAM ? "stream"
+	   : cv->reader.mode == JSF_URING ? "uring" : "read",
+	   nWorkers, cv->SeismicRecords, cv->SidescanRecords);
+  fprintf (f, ",\"products\":{");
+  for (k = n = 0; k < NPROD; k++)
+    if (cv->prod[k].want)
+      fprintf (f, "%s\"%s\":{\"traces\":%u,\"record_length_changes\":%lu}",
+	       n++ ? "," : "", name[k],
+	       (unsigned int) cv->prod[k].tseq_reel, cv->prod[k].nchange);
+  fprintf (f, "}");
+  if (fclose (f) == 0)
+    stats_write (statsFp, &cv->stats, head, nWorkers);
+  free (head);
+}
+
+/*
+ * With an index, reserve disk space for the traces this product's output
+ * file will hold (up to its next record length change).  The file size
+ * is left alone, so a short estimate or a failure costs nothing.
+ */
+
+void
+do_prealloc (Conversion * cv, Product * pr)
+{
+  size_t bytes;
+
+  if (!cv->use_index || cv->idx_next == 0 || do_Gate
+      || pr - cv->prod >= NSUBBOTTOM)
+    return;
+  bytes = jsfidx_run_bytes (&cv->jsfindex, cv->idx_next - 1,
+			    1u << product[pr - cv->prod].fmt,
+			    SAMPLE_BYTES (segyFormat));
+  if (bytes > 0)
+    (void) segy_prealloc (pr->outlu, (off_t) (EBCHDLEN + BCDHDLEN + bytes));
+}
 
 void
 err_exit (void)
@@ -535,54 +2661,103 @@ usage (void)
   fprintf (stdout,
 	   "\nUsage:	jsf2segy - options first then full path to input file name\n");
   fprintf (stdout, "\nIE: jsf2segy -a -o outfile infile.jsf\n");
+  fprintf (stdout, "    zcat infile.jsf.gz | jsf2segy -a -o - - | next_stage\n");
+  fprintf (stdout, "    jsf2segy -a -b 4 -o outdir infile1.jsf infile2.jsf jsfdir\n");
   fprintf (stdout, "\nOptions: \t-e Get Envelope subbottom data\n");
   fprintf (stdout, "\t\t-a Get Analytic subbottom data and make Envelope\n");
   fprintf (stdout, "\t\t-r Get Real subbottom data\n");
   fprintf (stdout,
 	   "\t\t-x Extract real value from Analytic subbottom data\n");
   fprintf (stdout,
-	   "\t\t-o Path and name of output file (use no file extension ie .sgy) \n\n");
+	   "\t\t-s Also extract sidescan, port and starboard interleaved,\n"
+	   "\t\t   to outfile_sslf.sgy and outfile_sshf.sgy\n");
+  fprintf (stdout,
+	   "\t\t-S As -s, but raw float samples without headers (.raw)\n");
+  fprintf (stdout,
+	   "\t\t-p Compute the -a envelope in double precision\n");
+  fprintf (stdout,
+	   "\t\t-m Memory map the input file instead of reading it\n");
+  fprintf (stdout,
+	   "\t\t-i Write a message index (infile.jsfidx) and use it;\n"
+	   "\t\t   later runs use the index when it is up to date\n");
+  fprintf (stdout,
+	   "\t\t-w Output block size in KB (default 1024)\n");
+  fprintf (stdout,
+	   "\t\t-d Write the output with O_DIRECT (unbuffered) I/O\n");
+  fprintf (stdout,
+	   "\t\t-j Number of conversion threads (default 0, convert inline)\n");
+  fprintf (stdout,
+	   "\t\t-q Pings queued for conversion[,for writing] with -j (16,32)\n");
+  fprintf (stdout,
+	   "\t\t-b Batch mode: convert the input files on this many threads\n"
+	   "\t\t   (default one per CPU); several input files or a directory\n"
+	   "\t\t   of .jsf files also select batch mode\n");
+  fprintf (stdout,
+	   "\t\t-l Batch mode: also convert the files (or directories) listed\n"
+	   "\t\t   one per line in this manifest\n");
+  fprintf (stdout,
+	   "\t\t--follow[=SECS] Keep converting as the input file grows, until\n"
+	   "\t\t   interrupted or SECS seconds without growth\n");
+  fprintf (stdout,
+	   "\t\t--static[=dh] Shift subbottom traces to a sea surface datum by\n"
+	   "\t\t   the vehicle depth (d) and heave (h), default both\n");
+  fprintf (stdout,
+	   "\t\t--sound-velocity=M/S for --static (default 1500)\n");
+  fprintf (stdout,
+	   "\t\t--format=N SEG Y sample format: 5 IEEE float (default),\n"
+	   "\t\t   1 IBM float, 2 int32, 3 int16, 8 int8\n");
+  fprintf (stdout,
+	   "\t\t--little-endian Write SEG Y rev 2 little-endian, headers and\n"
+	   "\t\t   samples in the byte order of x86 and ARM hosts\n");
+  fprintf (stdout,
+	   "\t\t--window=T0,T1 Keep only samples from T0 to T1 ms two-way time\n");
+  fprintf (stdout,
+	   "\t\t--samples=FIRST[,LAST] Keep only samples FIRST to LAST (from 0)\n");
+  fprintf (stdout,
+	   "\t\t--decimate=N Keep every Nth sample, low-pass filtered first\n"
+	   "\t\t   unless --no-antialias (N up to 64)\n");
+  fprintf (stdout,
+	   "\t\t--start=TIME --end=TIME Convert only the pings from TIME to\n"
+	   "\t\t   TIME, as YYYY-MM-DDTHH:MM:SS[.sss] UTC or seconds since 1970\n");
+  fprintf (stdout,
+	   "\t\t--first=PING --last=PING Convert only pings PING to PING\n");
+  fprintf (stdout,
+	   "\t\t--split[=N] Convert one file in N pieces at once (default one\n"
+	   "\t\t   per CPU), subbottom only\n");
+  fprintf (stdout,
+	   "\t\t--header-map=FILE Changes to the JSF to SEG Y trace header\n"
+	   "\t\t   mapping, one field a line: field offset [type [scale]],\n"
+	   "\t\t   field const value, or field none\n");
+  fprintf (stdout,
+	   "\t\t--uring[=DEPTH[,KB]] Read the input through io_uring, DEPTH\n"
+	   "\t\t   reads of KB each in flight (default 8 of 1024)\n");
+  fprintf (stdout,
+	   "\t\t--stats[=FILE] Time each stage and count messages by type,\n"
+	   "\t\t   reported as JSON on standard error (or FILE) at the end\n");
+  fprintf (stdout,
+	   "\t\t--stats-interval=SECS Also report every SECS seconds\n");
+  fprintf (stdout,
+	   "\t\t-o Path and name of output file (use no file extension ie .sgy) \n");
+  fprintf (stdout,
+	   "\t\t   - writes the SEG Y to standard output; an input file of -\n"
+	   "\t\t   reads standard input\n");
+  fprintf (stdout,
+	   "\t\t   In batch mode, the directory for the output files, each\n"
+	   "\t\t   named after its input file (default current directory)\n\n");
   exit (EXIT_FAILURE);
 }
 
-float
-floatSwap (char *value)
-{
-  char buffer[4];
-
-  buffer[0] = value[3];
-  buffer[1] = value[2];
-  buffer[2] = value[1];
-  buffer[3] = value[0];
-  return *((float *) &buffer);
-}
-
-float
-floatFlip (float *value)
-{
-  int i;
-  unsigned char *ptr1, *ptr3;
-  float *ptr2;
-  float returnValue;
-
-  ptr1 = (unsigned char *) value;
-  ptr3 = (unsigned char *) calloc (1, sizeof (float));
-  ptr1 += 3;
-  for (i = 0; i < 4; i++)
-    *ptr3++ = *ptr1--;
-  ptr3 -= 4;
-  ptr2 = (float *) ptr3;
-  returnValue = *ptr2;
-  free (ptr3);
-  return (returnValue);
-}
-
 void
-do_ebcdic (void)
+do_ebcdic (Conversion * cv, Product * pr)
 {
-  extern int asciiIndex, i;
-  extern char ebcbuf[];
-  extern char samps_per_shot[], segy[], tempBuffer[], temp[];
+  static const char *sample_code[9] = {
+    "", "IBM Floating Point", "32 bit Integer", "16 bit Integer", "",
+    "IEEE Floating Point", "", "", "8 bit Integer"
+  };
+  int asciiIndex, i;
+  char *ebcbuf = pr->ebcbuf;
+  char samps_per_shot[10];
+  char tempBuffer[21];
 
   /*
    * Get copy the EBCDIC template to an ASCII buffer that
@@ -612,8 +2787,10 @@ do_ebcdic (void)
    */
 
   strncpy (&ebcbuf[42], "WHSC", (size_t) 4);
-  i = (int) strlen (outFileName);
-  strncpy (&ebcbuf[89], outFileName, (size_t) i);
+  i = (int) strlen (pr->outFileName);
+  if (i > EBCDIC_NAME)
+    i = EBCDIC_NAME;
+  strncpy (&ebcbuf[89], pr->outFileName, (size_t) i);
 
   /*
    * C4 Instrument Manufacturer
@@ -625,7 +2802,7 @@ do_ebcdic (void)
    * C6 Bytes per sample
    */
 
-  strncpy (&ebcbuf[475], "4", (size_t) 1);
+  ebcbuf[475] = '0' + SAMPLE_BYTES (segyFormat);
 
   /*
    * C21
@@ -644,7 +2821,7 @@ do_ebcdic (void)
    * C6 Number of samples per shot
    */
 
-  i = sprintf (samps_per_shot, "%d", numberOfSamples);
+  i = sprintf (samps_per_shot, "%d", gate_samples (cv));
   strncpy (&ebcbuf[442], samps_per_shot, (size_t) i);
 
   /*
@@ -652,8 +2829,8 @@ do_ebcdic (void)
    * Edgetech nanoseconds into microseconds
    */
 
-  i = (int) (get_int (JSFSEGYHead, 116) / 1000);
-  sp_retn = sprintf (tempBuffer, "%d", i);
+  i = (int) (get_int (cv->JSFSEGYHead, 116) / 1000);
+  sprintf (tempBuffer, "%d", i);
   if (strlen (tempBuffer) < (size_t) 7)
     strncpy (&ebcbuf[420], tempBuffer, (size_t) strlen (tempBuffer));
   else
@@ -663,7 +2840,7 @@ do_ebcdic (void)
    * C13 Chirp sweep length
    */
 
-  i = sprintf (tempBuffer, "%d", get_short (JSFSEGYHead, 130));
+  i = sprintf (tempBuffer, "%d", get_short (cv->JSFSEGYHead, 130));
   if (strlen (tempBuffer) < (size_t) 5)
     strncpy (&ebcbuf[1004], tempBuffer, (size_t) strlen (tempBuffer));
   else
@@ -673,28 +2850,28 @@ do_ebcdic (void)
    * C13 Start Frequency
    */
 
-  i = sprintf (tempBuffer, "%d", get_short (JSFSEGYHead, 126) * 10);
+  i = sprintf (tempBuffer, "%d", get_short (cv->JSFSEGYHead, 126) * 10);
   strncpy (&ebcbuf[976], tempBuffer, (size_t) 4);
 
   /*
    * C13 End Frequency
    */
 
-  i = sprintf (tempBuffer, "%d", get_short (JSFSEGYHead, 128) * 10);
+  i = sprintf (tempBuffer, "%d", get_short (cv->JSFSEGYHead, 128) * 10);
   strncpy (&ebcbuf[988], tempBuffer, (size_t) 4);
 
   /*
    * C3 NMEA Year of recording
    */
 
-  i = sprintf (tempBuffer, "%d", get_short (JSFSEGYHead, 198));
+  i = sprintf (tempBuffer, "%d", get_short (cv->JSFSEGYHead, 198));
   strncpy (&ebcbuf[209], tempBuffer, (size_t) 4);
 
   /*
    * C3 NMEA Day start of reel
    */
 
-  i = sprintf (tempBuffer, "%d", get_short (JSFSEGYHead, 196));
+  i = sprintf (tempBuffer, "%d", get_short (cv->JSFSEGYHead, 196));
   strncpy (&ebcbuf[200], tempBuffer, (size_t) 2);
 
   /*
@@ -713,19 +2890,26 @@ do_ebcdic (void)
    * C8 Sample Code:
    */
 
-  strncpy (&ebcbuf[577], "IEEE Floating Point", (size_t) 19);
+  memcpy (&ebcbuf[577], sample_code[segyFormat],
+	  strlen (sample_code[segyFormat]));
 
   /*
-   * C39 SEG Y REV_1
+   * C39 SEG Y REV_1, or SEG-Y_REV2.0 for little-endian
    */
 
-  strncpy (&ebcbuf[3044], "SEG Y REV_1", (size_t) 11);
+  if (segyLittle)
+    strncpy (&ebcbuf[3044], "SEG-Y_REV2.0", (size_t) 12);
+  else
+    strncpy (&ebcbuf[3044], "SEG Y REV_1", (size_t) 11);
 
   /*
    * C38 Big Endian Byte Order
    */
 
-  strncpy (&ebcbuf[2964], "Big Endian Byte Order", (size_t) 21);
+  if (segyLittle)
+    strncpy (&ebcbuf[2964], "Little Endian Byte Order", (size_t) 24);
+  else
+    strncpy (&ebcbuf[2964], "Big Endian Byte Order", (size_t) 21);
 
   /*
    * End Textual Header
@@ -741,347 +2925,1029 @@ do_ebcdic (void)
    * convert ascii to ebcdic
    */
 
-  ascebc (ebcbuf, ebcdic, EBCHDLEN);
+  ascebc (ebcbuf, pr->ebcdic, EBCHDLEN);
 }				// End do_ebcdic()
 
-void
-do_bcd (void)
-{
+void
+do_bcd (Conversion * cv, Product * pr)
+{
+  unsigned char *rev;
+
+  /*
+   * Now get the BCD Header sorted out
+   */
+
+  pr->bhead.line = seg_u32 (1);	/* line number 1 */
+  pr->bhead.reel = seg_u32 (1);	/* reel number */
+  pr->bhead.ntr = seg_u16 (pr - cv->prod < NSUBBOTTOM ? 1 : 2);	/* traces per ensemble */
+  pr->bhead.mdt = seg_u16 (cv->sampInterval * gateDecim);	/* sample interval in * microsec */
+  pr->bhead.swlen = seg_u16 (cv->sweepLength);	/* Sweep length of Chirp * pulse */
+  pr->bhead.nt = seg_u16 (gate_samples (cv));	/* number of samples per * * channel */
+  pr->bhead.dform = seg_u16 (segyFormat);	/* sample format code */
+  pr->bhead.omdt = seg_u16 (cv->sampInterval);
+  pr->bhead.stfr = seg_u16 (get_short (cv->JSFSEGYHead, 126) * 10);	/* Start Frequency */
+  pr->bhead.enfr = seg_u16 (get_short (cv->JSFSEGYHead, 128) * 10);	/* End frequency */
+  pr->bhead.naux = seg_u16 (0);	/* Number of Aux traces */
+  pr->bhead.sortcd = seg_u16 (1);	/* Sort Code, As * recorded */
+  pr->bhead.unit = seg_u16 (1);	/* Measurement system, 1 * = meters */
+  pr->bhead.T_flag = seg_u16 (1);	/* Fixed length trace * flag */
+  pr->bhead.N_extend = seg_u16 (0);	/* No extend textual * headers */
+
+  /*
+   * Revision major and minor bytes: Segy Rev 1, or for little-endian
+   * Rev 2, whose readers tell the byte order from the 0x01020304
+   * written in it
+   */
+
+  rev = (unsigned char *) &pr->bhead.Rev;
+  rev[0] = segyLittle ? 2 : 1;
+  rev[1] = 0;
+  if (segyLittle)
+    st_seg32 ((unsigned char *) &pr->bhead + BCD_ORDER, 0x01020304);
+}
+
+/*
+ * Queue the close of a product's output file, so that it is flushed and
+ * closed once its traces are out
+ */
+
+void
+close_output (Conversion * cv, Product * pr)
+{
+  Ping *ping;
+
+  if (pr->outlu == NULL)
+    return;
+  flush_output (cv, pr);
+  ping = next_slot (cv);
+  ping->kind = PING_CLOSE;
+  ping->out = pr->outlu;
+  pipe_submit (&cv->pipe);
+  pr->outlu = NULL;
+}
+
+/*
+ * --follow: queue a flush of a product's output file, if it has traces
+ * not yet flushed
+ */
+
+void
+flush_output (Conversion * cv, Product * pr)
+{
+  Ping *ping;
+
+  if (pr->outlu == NULL || !pr->unflushed)
+    return;
+  ping = next_slot (cv);
+  ping->kind = PING_FLUSH;
+  ping->out = pr->outlu;
+  ping->ntraces = pr->raw ? 0 : pr->ntraces;
+  ping->since = pr->pending;
+  pipe_submit (&cv->pipe);
+  pr->unflushed = 0;
+}
+
+/*
+ * --follow: the reader has caught up with the file and is about to
+ * wait for it to grow, so bring every output file up to date.  Not
+ * while a trace is half read into its slot: the slot is not ours to
+ * hand out again, and the flush comes with the next wait.
+ */
+
+void
+follow_flush (void *arg)
+{
+  Conversion *cv = (Conversion *) arg;
+  int k;
+
+  if (do_Stats && stats_due (&cv->stats, stats_clock ()))
+    stats_report (cv, 0);
+  if (cv->filling)
+    return;
+  for (k = 0; k < NPROD; k++)
+    flush_output (cv, &cv->prod[k]);
+}
+
+void
+stop_follow (int sig)
+{
+  (void) sig;
+  stopFollow = 1;
+}
+
+/*
+ * First ping of a product's output file: open it if that has not been
+ * done, then set up the EBCDIC and BCD headers and send them on.
+ */
+
+int
+do_start_file (Conversion * cv, Product * pr)
+{
+  Ping *ping;
+  int fd;
+
+  if (!pr->outlu && segyFd != -1)
+    {
+      /*
+       * Standard output: each SEG Y file gets its own descriptor, so
+       * closing one leaves the stream open for the next
+       */
+
+      if ((fd = dup (segyFd)) == -1
+	  || (pr->outlu = segy_fdopen (fd, outBlock)) == NULL)
+	{
+	  perror ("dup");
+	  if (fd != -1)
+	    close (fd);
+	  return -1;
+	}
+    }
+  if (!pr->outlu)
+    {
+      if ((pr->outlu = segy_open (pr->outFileName, outBlock,
+				  do_Direct)) == NULL)
+	{
+	  fprintf (stderr, "%s: cannot open %s\n", pr->outFileName,
+		   progname);
+	  perror ("open");
+	  return -1;
+	}
+      do_prealloc (cv, pr);
+    }				// End !outlu
+  pr->ntraces = 0;
+  cv->sampInterval = (unsigned short) get_int (cv->JSFSEGYHead, 116) / 1000;
+  cv->sweepLength = (unsigned short) get_short (cv->JSFSEGYHead, 130);
+
+  do_ebcdic (cv, pr);
+  do_bcd (cv, pr);
+  pr->doing_SB++;		/* Set flag that we only want to go through here once */
+  if (pr->raw)
+    return 0;
+
   /*
-   * Now get the BCD Header sorted out
+   * Queue the EBCDIC and BCD headers for the output file
    */
 
-  bhead.line = swap_uint32 (1);	/* line number 1 */
-  bhead.reel = swap_uint32 (1);	/* reel number */
-  bhead.ntr = swap_uint16 (1);	/* number of traces */
-  bhead.mdt = swap_uint16 (sampInterval);	/* sample interval in * microsec */
-  bhead.swlen = swap_uint16 (sweepLength);	/* Sweep length of Chirp * pulse */
-  bhead.nt = swap_uint16 (numberOfSamples);	/* number of samples per * * channel */
-  bhead.dform = swap_uint16 (5);	/* IEEE 4 byte floating * point */
-  bhead.omdt = swap_uint16 (sampInterval);
-  bhead.stfr = swap_uint16 (get_short (JSFSEGYHead, 126) * 10);	/* Start Frequency */
-  bhead.enfr = swap_uint16 (get_short (JSFSEGYHead, 128) * 10);	/* End frequency */
-  bhead.naux = swap_uint16 (0);	/* Number of Aux traces */
-  bhead.sortcd = swap_uint16 (1);	/* Sort Code, As * recorded */
-  bhead.unit = swap_uint16 (1);	/* Measurement system, 1 * = meters */
-  bhead.Rev = swap_uint16 (0x100);	/* Segy Rev 1 */
-  bhead.T_flag = swap_uint16 (1);	/* Fixed length trace * flag */
-  bhead.N_extend = swap_uint16 (0);	/* No extend textual * headers */
+  ping = next_slot (cv);
+  ping->kind = PING_HEADERS;
+  ping->out = pr->outlu;
+  memcpy (ping->ebcdic, pr->ebcdic, EBCHDLEN);
+  ping->bhead = pr->bhead;
+  pipe_submit (&cv->pipe);
+  return 0;
 }
 
-void
-do_calloc (void)
+int
+do_start_new_file (Conversion * cv, Product * pr)
 {
+  int byte_count = 0;
+  int i;
+  pr->iFirst = 0;		// reset flag
+  pr->doing_SB = 0;		// reset flag
+
+  fprintf (stdout,
+	   "Record length change detected. Closing output segy file %s \n",
+	   pr->outFileName);
+  pr->nchange++;
+  close_output (cv, pr);
 
-  free (JSFData);
   /*
-   * Lets allocate some memory for JSF input trace data First
-   * lets check if we are to work on Envelope or Analytic data.
-   * Also check if we have already alloated storage for the
-   * seismic data. We only need to do the allocation once.
+   * On standard output the next SEG Y file follows in the same stream,
+   * opened by do_start_file()
    */
 
+  if (segyFd != -1)
+    return 0;
 
-  if (do_Envelope && Data_Fmt == Env_Data)
-    {
-      DataSize = (size_t) (get_int (JSFmsg, 12) - 240);
-      JSFData = (unsigned char *) calloc ((size_t) DataSize,
-					  sizeof (unsigned char));
-    }
-  if (do_Analytic && Data_Fmt == Ana_Data)
+  byte_count = strlen (pr->nextFileName);
+  if (byte_count + 2 + strlen (pr->ext) >= sizeof (pr->outFileName))
     {
-      DataSize = (size_t) (get_int (JSFmsg, 12) - 240);
-      JSFData = (unsigned char *) calloc ((size_t) DataSize,
-					  sizeof (unsigned char));
+      fprintf (stderr, "%s: output file name too long\n", progname);
+      return -1;
     }
-  if (do_Real && Data_Fmt == Real_Data)
-    {
-      DataSize = (size_t) (get_int (JSFmsg, 12) - 240);
-      JSFData = (unsigned char *) calloc ((size_t) DataSize,
-					  sizeof (unsigned char));
-    }
-  if (xt_Real && Data_Fmt == Ana_Data)
+
+  for (i = 0; i < 100; i++)
     {
-      DataSize = (size_t) (get_int (JSFmsg, 12) - 240);
-      JSFData = (unsigned char *) calloc ((size_t) DataSize,
-					  sizeof (unsigned char));
+      memset (pr->outFileName, 0, sizeof (pr->outFileName));
+      memcpy (pr->outFileName, pr->nextFileName, byte_count);
+      pr->outFileName[byte_count] = '0' + i / 10;
+      pr->outFileName[byte_count + 1] = '0' + i % 10;
+      strcat (pr->outFileName, pr->ext);
+//    fprintf (stdout, "byte_count = %d\n", byte_count);
+      pr->outlu = segy_open (pr->outFileName, outBlock, do_Direct);
+      if (pr->outlu != NULL)
+	{
+	  do_prealloc (cv, pr);
+	  break;
+	}
     }
-  if (JSFData == NULL)
+  if (pr->outlu == NULL)
     {
-      fprintf (stdout, "Error allocating JSFData storage\n");
-      (void) fflush (stdout);
-      perror ("reason");
-      err_exit ();
+      fprintf (stderr, "%s: cannot open %s\n", pr->outFileName, progname);
+      perror ("open");
+      return -1;
     }
-  done_Calloc++;
+  return 0;
 }
 
+/*
+ * Batch mode input list: a .jsf file, or every .jsf file in a directory
+ */
+
 void
-do_start_new_file (void)
+add_input (const char *path)
 {
-  int byte_count = 0;
-  iFirst = 0;			// reset flag
-  doing_SB = 0;			// reset flag
-
-  fprintf (stdout,
-	   "Record length change detected. Closing output segy file %s \n",
-	   outFileName);
-  close (outlu);
-  outlu = 0;
-
-  memset (outFileName, 0, sizeof (outFileName));
-  memcpy (outFileName, nextFileName, strlen (nextFileName));
+  struct dirent **ent;
+  struct stat st;
+  char *name;
+  size_t len;
+  int k, n;
 
-  // fprintf (stdout, "outFileName = %s\n", outFileName);
-
-  byte_count = strlen (outFileName);
+  if (stat (path, &st) == 0 && S_ISDIR (st.st_mode))
+    {
+      if ((n = scandir (path, &ent, NULL, alphasort)) == -1)
+	{
+	  fprintf (stderr, "%s: cannot read directory %s\n", progname, path);
+	  perror ("scandir");
+	  err_exit ();
+	}
+      for (k = 0; k < n; k++)
+	{
+	  len = strlen (ent[k]->d_name);
+	  if (len > 4 && strcasecmp (ent[k]->d_name + len - 4, ".jsf") == 0)
+	    {
+	      if ((name = (char *) malloc (strlen (path) + len + 2)) == NULL)
+		{
+		  perror ("malloc");
+		  err_exit ();
+		}
+	      sprintf (name, "%s/%s", path, ent[k]->d_name);
+	      add_input (name);
+	      free (name);
+	    }
+	  free (ent[k]);
+	}
+      free (ent);
+      return;
+    }
 
-  while (outlu == 0)
+  if (ninputs == ainputs)
     {
-      for (i = 0; i < 100; i++)
+      ainputs = ainputs ? 2 * ainputs : 64;
+      if ((inputs = (char **) realloc (inputs, ainputs * sizeof (char *)))
+	  == NULL)
 	{
-	  outFileName[byte_count] = '0' + i / 10;
-	  outFileName[byte_count + 1] = '0' + i % 10;
-	  strcat (outFileName, segy);
-//        fprintf (stdout, "byte_count = %d\n", byte_count);
-	  outlu = open (outFileName, O_WRONLY | O_CREAT | O_EXCL, PMODE);
-	  if (outlu > 0)
-	    break;
-	  memset (outFileName, 0, sizeof (outFileName));
-	  memcpy (outFileName, nextFileName, strlen (nextFileName));
-	  byte_count = strlen (outFileName);
-// fprintf(stdout, "outlu = %d \n", outlu);
+	  perror ("realloc");
+	  err_exit ();
 	}
     }
+  if ((inputs[ninputs++] = strdup (path)) == NULL)
+    {
+      perror ("strdup");
+      err_exit ();
+    }
 }
 
-
-/*    get_double()
- *
- *    Subroutine to enable Intel based processors
- *    (little-endian) to read IEEE double precision
- *    floating point numbers (8 bytes) in files
- *    transferred from a mc680xx machine.
- *
+/*
+ * Batch mode manifest: one file or directory per line.  Blank lines and
+ * lines starting with # are skipped.
  */
 
-double
-get_double (unsigned char *inbuf, int location)
+void
+add_manifest (const char *path)
 {
-  int i;
-  unsigned char *ptr1, *ptr3;
-  double *ptr2;
-  double value;
+  FILE *fp;
+  char line[PATH_MAX + 2];
+  size_t len;
 
-  ptr1 = inbuf;
-  ptr3 = (unsigned char *) calloc (1, sizeof (double));
-
-  if (BIG)
+  if ((fp = fopen (path, "r")) == NULL)
     {
-      ptr1 += location;
-      for (i = 0; i < 8; i++)
-	*ptr3++ = *ptr1++;
+      fprintf (stderr, "%s: cannot open manifest %s\n", progname, path);
+      perror ("fopen");
+      err_exit ();
     }
-  else
+  while (fgets (line, sizeof (line), fp) != NULL)
     {
-      ptr1 += location;
-      for (i = 0; i < 8; i++)
-	*ptr3++ = *ptr1++;
+      len = strlen (line);
+      while (len > 0 && isspace ((unsigned char) line[len - 1]))
+	line[--len] = '\0';
+      if (len == 0 || line[0] == '#')
+	continue;
+      add_input (line);
     }
+  fclose (fp);
+}
 
-  ptr3 -= 8;
+/*
+ * Batch mode output name for an input: its base name less .jsf, in the
+ * -o directory if there is one
+ */
 
-  ptr2 = (double *) ptr3;
+char *
+batch_name (const char *input)
+{
+  const char *base;
+  char *name;
+  size_t len;
+
+  base = strrchr (input, '/') ? strrchr (input, '/') + 1 : input;
+  len = strlen (base);
+  if (len > 4 && strcasecmp (base + len - 4, ".jsf") == 0)
+    len -= 4;
+  name = (char *) malloc ((outputFile ? strlen (outputFile) + 1 : 0) + len + 1);
+  if (name == NULL)
+    return NULL;
+  if (outputFile)
+    sprintf (name, "%s/%.*s", outputFile, (int) len, base);
+  else
+    sprintf (name, "%.*s", (int) len, base);
+  return name;
+}
 
-  value = *ptr2;
+/*
+ * One batch job: convert inputs[job]
+ */
 
-  free (ptr3);
+void
+batch_one (void *arg, size_t job)
+{
+  Conversion *cv = (Conversion *) arg + job;
 
-  return (value);
+  cv->status = convert_file (cv);
+  if (cv->status == -1)
+    fprintf (stdout, "%s: conversion of %s failed\n", progname,
+	     cv->inputFileName);
 }
 
-/*    get_float()
- *
- *    Subroutine to enable Intel based processors
- *    (little-endian) to read IEEE single precision
- *    floating point numbers (4 bytes) in files
- *    transferred from a mc680xx machine.
+/*
+ * Convert every input, largest first, on nBatch threads, then print
+ * one summary for the run.  Returns -1 if any conversion failed.
  */
 
-float
-get_float (unsigned char *inbuf, int location)
+int
+do_batch (void)
 {
-  int i;
-  unsigned char *ptr1, *ptr3;
-  float *ptr2;
-  float value;
-
-  ptr1 = inbuf;
-  ptr3 = (unsigned char *) calloc (1, sizeof (float));
+  Conversion *cv;
+  struct timespec t0, t1;
+  struct stat st;
+  off_t *cost, inbytes = 0;
+  size_t k, nfailed = 0;
+  long records = 0;
+  double secs;
+
+  if (ninputs == 0)
+    {
+      fprintf (stderr, "%s: no .jsf files to convert\n", progname);
+      return -1;
+    }
+  if (nBatch < 1)
+    nBatch = (int) sysconf (_SC_NPROCESSORS_ONLN);
 
-  if (BIG)
+  cv = (Conversion *) calloc (ninputs, sizeof (Conversion));
+  cost = (off_t *) calloc (ninputs, sizeof (off_t));
+  if (cv == NULL || cost == NULL)
     {
-      ptr1 += (location + 3);
-      for (i = 0; i < 4; i++)
-	*ptr3++ = *ptr1--;
+      perror ("calloc");
+      return -1;
     }
-  else
+  for (k = 0; k < ninputs; k++)
     {
-      ptr1 += location;
-      for (i = 0; i < 4; i++)
-	*ptr3++ = *ptr1++;
+      cv[k].inputFileName = inputs[k];
+      if ((cv[k].nextFileName = batch_name (inputs[k])) == NULL)
+	{
+	  perror ("malloc");
+	  return -1;
+	}
+      if (stat (inputs[k], &st) == 0)
+	cost[k] = st.st_size;
     }
 
-  ptr3 -= 4;
-
-  ptr2 = (float *) ptr3;
-
-  value = *ptr2;
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  if (batch_run (ninputs, cost, nBatch, batch_one, cv) == -1)
+    {
+      fprintf (stderr, "%s: cannot start batch threads\n", progname);
+      perror ("batch_run");
+      return -1;
+    }
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
 
-  free (ptr3);
+  /*
+   * Combined summary, in input order
+   */
 
-  return (value);
+  fprintf (stdout, "\nBatch summary:\n");
+  for (k = 0; k < ninputs; k++)
+    {
+      fprintf (stdout, "  %s -> %s%s  %d seismic records%s\n",
+	       cv[k].inputFileName, cv[k].nextFileName, segy,
+	       cv[k].SeismicRecords, cv[k].status ? "  FAILED" : "");
+      records += cv[k].SeismicRecords;
+      inbytes += cv[k].inbytes;
+      if (cv[k].status)
+	nfailed++;
+    }
+  fprintf (stdout,
+	   "%lu files, %lu converted, %lu failed, %ld seismic records\n",
+	   (unsigned long) ninputs, (unsigned long) (ninputs - nfailed),
+	   (unsigned long) nfailed, records);
+  fprintf (stdout, "%.1f MB of input in %.2f s (%.1f MB/s) on %d threads\n",
+	   inbytes / 1e6, secs, secs > 0 ? inbytes / 1e6 / secs : 0.0,
+	   nBatch);
+
+  for (k = 0; k < ninputs; k++)
+    free (cv[k].nextFileName);
+  free (cv);
+  free (cost);
+  return nfailed ? -1 : 0;
 }
 
-/*    get_int()
- *
- *    Subroutine to enable Intel based processors
-
- *    (little-endian) to read IEEE integer
- *    numbers (4 bytes) in files
- *    transferred from a mc680xx machine and vice versa.
+/*
+ * --split, first pass over chunk job: its pings for each product, in
+ * runs of one message size, and where it ended.  Only the message
+ * headers and sonar headers are read.
  */
 
-int
-get_int (unsigned char *buf, int location)
+void
+split_count (void *arg, size_t job)
 {
-  int i;
-  unsigned char *ptr1, *ptr3;
-  int *ptr2;
-  int value;
+  Split *sp = (Split *) arg;
+  SplitChunk *ch = &sp->chunk[job];
+  const unsigned char *h;
+  JSFReader r;
+  JSFMessage m;
+  off_t bytes;
+  int first, ret, fmt, k;
+
+  for (k = 0; k < NSUBBOTTOM; k++)
+    ch->nrun[k] = 0;
+  ch->stop = 0;
+  ch->end = ch->hi;
+  ch->status = 0;
+  if (ch->lo >= ch->hi)
+    return;
+  if (open_input (&r, sp->path) == -1)
+    {
+      perror ("open");
+      ch->status = -1;
+      return;
+    }
+  ret = jsf_seek (&r, ch->lo);
+  while (ret != -1 && (ret = jsf_iter (&r, &m, split_peek, NULL)) == 1)
+    {
+      if (m.offset >= ch->hi)
+	{
+	  ch->end = m.offset;
+	  break;
+	}
+      if (get_short (m.hdr, 0) != Start_Of_Message)
+	{
+	  fprintf (stdout, "Invalid file format at byte %lld of %s\n",
+		   (long long) m.offset, sp->path);
+	  ret = -1;
+	  break;
+	}
+      if ((h = m.payload) == NULL)
+	continue;
+      if (m.viewed < TRHDLEN)
+	{
+	  ret = -1;
+	  break;
+	}
+      if (do_Range && (k = ping_range (h)) != 0)
+	{
+	  if (k < 0)
+	    continue;
+	  ch->stop = 1;
+	  ch->end = m.offset;
+	  break;
+	}
 
-  ptr1 = buf;
-  ptr3 = (unsigned char *) calloc (1, sizeof (int));
+      /*
+       * The trace it makes for each product, as convert_product() will
+       * write it
+       */
 
-  if (BIG)
-    {
-      ptr1 += (location + 3);
-      for (i = 0; i < 4; i++)
-	*ptr3++ = *ptr1--;
+      fmt = get_short (h, 34);
+      first = 0;
+      bytes = TRHDLEN + (off_t) (do_Gate ? gate_range (h, &first)
+				 : (unsigned short) get_short (h, 114))
+	* SAMPLE_BYTES (segyFormat);
+      for (k = 0; k < NSUBBOTTOM; k++)
+	if (sp->want[k] && product[k].fmt == fmt
+	    && split_add (ch, k, get_int (m.hdr, 12), bytes, m.offset) == -1)
+	  {
+	    ret = -1;
+	    break;
+	  }
     }
-  else
+  if (ret == -1)
     {
-      ptr1 += location;
-      for (i = 0; i < 4; i++)
-	*ptr3++ = *ptr1++;
+      fprintf (stderr, "%s: error reading %s\n", progname, sp->path);
+      perror ("read");
+      ch->status = -1;
     }
+  jsf_close (&r);
+}
 
-  ptr3 -= 4;
+/*
+ * The first pass views the sonar header of subbottom messages only
+ */
 
-  ptr2 = (int *) ptr3;
+size_t
+split_peek (const JSFMessage * m, void *arg)
+{
+  (void) arg;
+  return m->type == Sonar_Data_Msg && m->subsystem == SubBottom
+    && get_short (m->hdr, 0) == Start_Of_Message ? TRHDLEN : 0;
+}
 
-  value = *ptr2;
+/*
+ * One ping of product k, size bytes of JSF message making bytes of SEG Y,
+ * onto the runs of chunk ch.  Returns -1 if out of memory.
+ */
 
-  free (ptr3);
+int
+split_add (SplitChunk * ch, int k, int size, off_t bytes, off_t first)
+{
+  SplitRun *r;
 
-  return (value);
+  if (ch->nrun[k] > 0 && ch->run[k][ch->nrun[k] - 1].size == size)
+    r = &ch->run[k][ch->nrun[k] - 1];
+  else
+    {
+      if (ch->nrun[k] == ch->arun[k])
+	{
+	  ch->arun[k] = ch->arun[k] ? 2 * ch->arun[k] : 4;
+	  r = (SplitRun *) realloc (ch->run[k], ch->arun[k] * sizeof (SplitRun));
+	  if (r == NULL)
+	    return -1;
+	  ch->run[k] = r;
+	}
+      r = &ch->run[k][ch->nrun[k]++];
+      r->size = size;
+      r->count = 0;
+      r->bytes = 0;
+      r->first = first;
+    }
+  r->count++;
+  r->bytes += bytes;
+  return 0;
 }
 
-/*    get_short()
- *
- *    Subroutine to enable Intel based processors to
- *    read short integer numbers (2 bytes)
- *    in files transferred from a mc680xx machine.
- *
+/*
+ * The output files from the runs of every chunk in order: a new file at
+ * each record length change, as a single pass makes them.  Each is
+ * created with its headers, from its first ping as do_start_file() does,
+ * and the space for its traces reserved.  Then each chunk is told where
+ * its traces go.  Returns -1 after reporting what went wrong.
  */
 
-short
-get_short (unsigned char *inbuf, int location)
+int
+split_files (Split * sp, int fd)
 {
-  int i;
-  unsigned char *ptr1, *ptr3;
-  short value;
-  short *ptr2;
+  unsigned char head[TRHDLEN];
+  Conversion *cv;
+  Product *pr;
+  SplitChunk *ch;
+  SplitRun *r;
+  SplitFile *f;
+  unsigned long total;
+  size_t c, i, j;
+  int k, ret = 0;
+
+  for (k = 0; k < NSUBBOTTOM; k++)
+    {
+      total = 0;
+      for (c = 0; c < sp->nchunk; c++)
+	{
+	  ch = &sp->chunk[c];
+	  for (i = 0; i < ch->nrun[k]; i++)
+	    {
+	      r = &ch->run[k][i];
+	      j = sp->nfile[k];
+	      if (j == 0 || sp->file[k][j - 1].size != r->size)
+		{
+		  if (j == sp->afile[k])
+		    {
+		      sp->afile[k] = j ? 2 * j : 4;
+		      f = (SplitFile *) realloc (sp->file[k], sp->afile[k]
+						 * sizeof (SplitFile));
+		      if (f == NULL)
+			{
+			  perror ("realloc");
+			  return -1;
+			}
+		      sp->file[k] = f;
+		    }
+		  f = &sp->file[k][sp->nfile[k]++];
+		  memset (f, 0, sizeof (SplitFile));
+		  f->size = r->size;
+		  f->first = r->first;
+		}
+	      f = &sp->file[k][sp->nfile[k] - 1];
+	      if (i == 0)
+		{
+		  ch->file[k] = sp->nfile[k] - 1;
+		  ch->at[k] = EBCHDLEN + BCDHDLEN + f->bytes;
+		  ch->left[k] = f->count;
+		  ch->seq[k] = total;
+		}
+	      f->count += r->count;
+	      f->bytes += r->bytes;
+	      total += r->count;
+	    }
+	}
+      for (c = 0; c < sp->nchunk; c++)
+	if (sp->chunk[c].nrun[k] > 0)
+	  sp->chunk[c].left[k] =
+	    sp->file[k][sp->chunk[c].file[k]].count - sp->chunk[c].left[k];
+    }
 
-  ptr1 = inbuf;
-  ptr3 = (unsigned char *) calloc (1, sizeof (short));
+  /*
+   * Make the files in the order a single pass would, so they get the
+   * same names, through a pipeline of our own
+   */
 
-  if (BIG)
+  if ((cv = (Conversion *) calloc (1, sizeof (Conversion))) == NULL)
     {
-      ptr1 += (location + 1);
-      for (i = 0; i < 2; i++)
-	*ptr3++ = *ptr1--;
+      perror ("calloc");
+      return -1;
     }
-  else
+  cv->inputFileName = sp->path;
+  cv->nextFileName = outputFile;
+  if (product_names (cv) == -1)
     {
-      ptr1 += location;
-      for (i = 0; i < 2; i++)
-	*ptr3++ = *ptr1++;
+      perror ("malloc");
+      ret = -1;
     }
+  else if (pipe_start (&cv->pipe, sizeof (Ping), 0, 1, 1, convert_ping,
+		       write_ping, cv) == -1)
+    {
+      perror ("pipe_start");
+      ret = -1;
+    }
+  for (k = 0; k < NSUBBOTTOM && ret == 0; k++)
+    {
+      pr = &cv->prod[k];
+      for (j = 0; j < sp->nfile[k]; j++)
+	{
+	  f = &sp->file[k][j];
+	  if (pread (fd, head, TRHDLEN, f->first + JSF_MSGHDRLEN) != TRHDLEN)
+	    {
+	      fprintf (stderr, "%s: error reading %s\n", progname, sp->path);
+	      perror ("read");
+	      ret = -1;
+	      break;
+	    }
+	  cv->JSFSEGYHead = head;
+	  cv->numberOfSamples = get_short (head, 114);
+	  if ((j > 0 && do_start_new_file (cv, pr) == -1)
+	      || do_start_file (cv, pr) == -1)
+	    {
+	      ret = -1;
+	      break;
+	    }
+	  (void) segy_prealloc (pr->outlu, EBCHDLEN + BCDHDLEN + f->bytes);
+	  strcpy (f->name, pr->outFileName);
+	  f->bhead = pr->bhead;
+	}
+      close_output (cv, pr);
+    }
+  if (cv->pipe.slots != NULL)
+    {
+      pipe_finish (&cv->pipe);
+      pipe_free (&cv->pipe, free_ping);
+    }
+  if (cv->failed)
+    ret = -1;
+  for (k = 0; k < NPROD; k++)
+    if (cv->prod[k].nextFileName != cv->nextFileName)
+      free (cv->prod[k].nextFileName);
+  free (cv);
+  return ret;
+}
 
-  ptr3 -= 2;
-
-  ptr2 = (short *) ptr3;
-
-  value = *ptr2;
+/*
+ * --split, second pass: start reading a chunk's sensor messages ahead
+ * of it, with the ping and trace numbers it starts from
+ */
 
-  free (ptr3);
+int
+split_start (Conversion * cv)
+{
+  Product *pr;
+  int k;
 
-  return (value);
+  for (k = 0; k < NSUBBOTTOM; k++)
+    {
+      pr = &cv->prod[k];
+      pr->pingNum = cv->chunk->seq[k];
+      pr->tseq_line = pr->tseq_reel = (int) cv->chunk->seq[k];
+    }
+  if (jsf_seek (&cv->reader, cv->chunk->warm) == -1)
+    {
+      fprintf (stderr, "%s: cannot seek in %s\n", progname,
+	       cv->inputFileName);
+      perror ("read");
+      return -1;
+    }
+  cv->auxAhead = cv->chunk->warm;
+  index_from (cv, cv->chunk->warm);
+  return 0;
 }
 
-//! Byte swap unsigned short
-uint16_t
-swap_uint16 (uint16_t val)
+/*
+ * Where the current message is: -1 ahead of the chunk, 0 in it, 1 after
+ */
+
+int
+split_where (Conversion * cv)
 {
-  return (val << 8) | (val >> 8);
+  if (cv->msg.offset < cv->chunk->lo)
+    return -1;
+  return cv->msg.offset >= cv->chunk->hi;
 }
 
-//! Byte swap short
-int16_t
-swap_int16 (int16_t val)
+/*
+ * Output file of product k for the next trace of the chunk: the one its
+ * first trace goes in, then each one after as the last has its traces
+ */
+
+int
+split_output (Conversion * cv, int k)
 {
-  return (val << 8) | ((val >> 8) & 0xFF);
+  SplitChunk *ch = cv->chunk;
+  Product *pr = &cv->prod[k];
+  SplitFile *f;
+
+  if (pr->outlu != NULL && ch->left[k] == 0)
+    {
+      close_output (cv, pr);
+      if (++ch->file[k] < cv->split->nfile[k])
+	ch->left[k] = cv->split->file[k][ch->file[k]].count;
+      ch->at[k] = EBCHDLEN + BCDHDLEN;
+    }
+  if (pr->outlu == NULL)
+    {
+      if (ch->file[k] >= cv->split->nfile[k] || ch->left[k] == 0)
+	{
+	  fprintf (stderr, "%s: more pings in bytes %lld-%lld than counted\n",
+		   progname, (long long) ch->lo, (long long) ch->hi);
+	  return -1;
+	}
+      f = &cv->split->file[k][ch->file[k]];
+      if ((pr->outlu = segy_open_at (f->name, ch->at[k], outBlock)) == NULL)
+	{
+	  fprintf (stderr, "%s: cannot open %s\n", progname, f->name);
+	  perror ("open");
+	  return -1;
+	}
+      snprintf (pr->outFileName, sizeof (pr->outFileName), "%s", f->name);
+      pr->bhead = f->bhead;
+    }
+  ch->left[k]--;
+  return 0;
 }
 
-//! Byte swap unsigned int
-uint32_t
-swap_uint32 (uint32_t val)
+/*
+ * One --split job: convert chunk job, and check it made the traces
+ * counted for it
+ */
+
+void
+split_one (void *arg, size_t job)
 {
-  val = ((val << 8) & 0xFF00FF00) | ((val >> 8) & 0xFF00FF);
-  return (val << 16) | (val >> 16);
+  Conversion *cv = (Conversion *) arg + job;
+  SplitChunk *ch = cv->chunk;
+  unsigned long n;
+  size_t i;
+  int k;
+
+  if (ch->lo >= ch->hi)
+    return;			/* nothing left in it */
+  cv->status = convert_file (cv);
+  for (k = 0; k < NSUBBOTTOM && cv->status == 0; k++)
+    {
+      for (n = 0, i = 0; i < ch->nrun[k]; i++)
+	n += ch->run[k][i].count;
+      if (cv->prod[k].pingNum != ch->seq[k] + n)
+	{
+	  fprintf (stderr, "%s: %lu pings in bytes %lld-%lld, %lu counted\n",
+		   progname, (unsigned long) (cv->prod[k].pingNum - ch->seq[k]),
+		   (long long) ch->lo, (long long) ch->hi, n);
+	  cv->status = -1;
+	}
+    }
+  if (cv->status == -1)
+    fprintf (stdout, "%s: conversion of bytes %lld-%lld of %s failed\n",
+	     progname, (long long) ch->lo, (long long) ch->hi,
+	     cv->inputFileName);
 }
 
-//! Byte swap int
-int32_t
-swap_int32 (int32_t val)
+/*
+ * --split: convert path in nSplit chunks (one per CPU by default, none
+ * under SPLIT_MIN bytes) at once.  The chunks start on message headers
+ * found as --start finds them, at even byte offsets of the part of the
+ * file to convert.  Returns -1 if anything failed.
+ */
+
+int
+do_split (const char *path)
 {
-  val = ((val << 8) & 0xFF00FF00) | ((val >> 8) & 0xFF00FF);
-  return (val << 16) | ((val >> 16) & 0xFFFF);
-}
+  Split sp;
+  SplitChunk *ch;
+  Conversion *cv = NULL;
+  struct timespec t0, t1;
+  struct stat st;
+  JSFIndex idx;
+  char *name;
+  off_t start, end, *cost = NULL;
+  size_t c, i, n;
+  long records = 0;
+  double secs;
+  int fd, k, ret = -1;
+
+  memset (&sp, 0, sizeof (sp));
+  sp.path = path;
+  sp.want[PROD_ENV] = do_Envelope;
+  sp.want[PROD_ANA] = do_Analytic;
+  sp.want[PROD_REAL] = do_Real;
+  sp.want[PROD_XREAL] = xt_Real;
+  do_Direct = 0;		/* the chunks write pieces of files */
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+
+  if ((fd = open (path, O_RDONLY)) == -1)
+    {
+      fprintf (stderr, "%s: cannot open %s\n", progname, path);
+      perror ("open");
+      return -1;
+    }
+  if (fstat (fd, &st) == -1 || !S_ISREG (st.st_mode))
+    {
+      fprintf (stderr, "%s: --split needs a file, %s is not one\n",
+	       progname, path);
+      close (fd);
+      return -1;
+    }
+  end = st.st_size;
+  start = 0;
+  if (do_Range && rangeStart != INT64_MIN
+      && (start = jsfseek_find (fd, rangeBy, rangeStart)) == -1)
+    {
+      fprintf (stderr, "%s: cannot find the start of the range in %s\n",
+	       progname, path);
+      perror ("read");
+      close (fd);
+      return -1;
+    }
+  if (start > 0)
+    fprintf (stdout, "Starting at byte %lld of %s\n", (long long) start,
+	     path);
 
-//! Byte swap 64 bit signed int
-int64_t
-swap_int64 (int64_t val)
-{
-  val =
-    ((val << 8) & 0xFF00FF00FF00FF00ULL) | ((val >> 8) &
-					    0x00FF00FF00FF00FFULL);
-  val =
-    ((val << 16) & 0xFFFF0000FFFF0000ULL) | ((val >> 16) &
-					     0x0000FFFF0000FFFFULL);
-  return (val << 32) | ((val >> 32) & 0xFFFFFFFFULL);
-}
+  /*
+   * The chunks, on message boundaries
+   */
+
+  n = nSplit > 0 ? (size_t) nSplit : (size_t) sysconf (_SC_NPROCESSORS_ONLN);
+  if ((off_t) n > (end - start) / SPLIT_MIN)
+    n = (end - start) / SPLIT_MIN;
+  if (n < 1)
+    n = 1;
+  sp.nchunk = n;
+  sp.chunk = (SplitChunk *) calloc (n, sizeof (SplitChunk));
+  cost = (off_t *) calloc (n, sizeof (off_t));
+  cv = (Conversion *) calloc (n, sizeof (Conversion));
+  if (sp.chunk == NULL || cost == NULL || cv == NULL)
+    {
+      perror ("calloc");
+      goto out;
+    }
+  for (c = 0; c < n; c++)
+    {
+      ch = &sp.chunk[c];
+      ch->lo = c == 0 ? start : sp.chunk[c - 1].hi;
+      ch->hi = c == n - 1 ? end
+	: jsfseek_sync (fd, start + (end - start) / (off_t) n * (off_t) (c + 1));
+      if (ch->hi == -1)
+	{
+	  perror ("read");
+	  goto out;
+	}
+      if (ch->hi < ch->lo)
+	ch->hi = ch->lo;
+      cost[c] = ch->hi - ch->lo;
+    }
 
-//! Byte swap 64 bit unsigned int
-uint64_t
-swap_uint64 (uint64_t val)
-{
-  val =
-    ((val << 8) & 0xFF00FF00FF00FF00ULL) | ((val >> 8) &
-					    0x00FF00FF00FF00FFULL);
-  val =
-    ((val << 16) & 0xFFFF0000FFFF0000ULL) | ((val >> 16) &
-					     0x0000FFFF0000FFFFULL);
-  return (val << 32) | (val >> 32);
+  /*
+   * First pass.  A chunk whose walk did not end where the next one
+   * starts, as a marker in sample data may have had it start in the
+   * wrong place, has the next one counted again from there; after a
+   * ping past the range, nothing is.
+   */
+
+  if (batch_run (n, cost, (int) n, split_count, &sp) == -1)
+    {
+      perror ("batch_run");
+      goto out;
+    }
+  for (c = 0; c < n; c++)
+    {
+      ch = &sp.chunk[c];
+      if (ch->status == -1)
+	goto out;
+      for (i = c + 1; i < n && (ch->stop || sp.chunk[i].lo != ch->end); i++)
+	{
+	  sp.chunk[i].lo = ch->end;
+	  if (ch->stop || sp.chunk[i].hi < ch->end)
+	    sp.chunk[i].hi = ch->end;
+	  split_count (&sp, i);
+	  if (!ch->stop)
+	    break;
+	}
+    }
+
+  if (split_files (&sp, fd) == -1)
+    goto out;
+
+  /*
+   * A message index is built once for all the chunks
+   */
+
+  if (do_Index)
+    {
+      memset (&idx, 0, sizeof (idx));
+      if ((name = jsfidx_name (path)) == NULL
+	  || jsfidx_build (path, &idx) == -1 || jsfidx_write (name, &idx) == -1)
+	{
+	  fprintf (stderr, "%s: cannot index %s\n", progname, path);
+	  perror ("index");
+	  jsfidx_free (&idx);
+	  free (name);
+	  goto out;
+	}
+      fprintf (stdout, "Wrote %lu message index %s\n",
+	       (unsigned long) idx.count, name);
+      jsfidx_free (&idx);
+      free (name);
+    }
+
+  /*
+   * Second pass, each chunk reading the sensor messages of up to
+   * SPLIT_WARMUP bytes before it first, so that the fixes of its first
+   * pings come from the same samples as in a single pass
+   */
+
+  for (c = 0; c < n; c++)
+    {
+      ch = &sp.chunk[c];
+      ch->warm = 0;
+      if (ch->lo > SPLIT_WARMUP)
+	ch->warm = jsfseek_sync (fd, ch->lo - SPLIT_WARMUP);
+      if (ch->warm == -1 || ch->warm > ch->lo)
+	ch->warm = ch->lo;
+      cv[c].inputFileName = path;
+      cv[c].nextFileName = outputFile;
+      cv[c].split = &sp;
+      cv[c].chunk = ch;
+      cost[c] = ch->hi - ch->lo;
+    }
+  if (batch_run (n, cost, (int) n, split_one, cv) == -1)
+    {
+      perror ("batch_run");
+      goto out;
+    }
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+  ret = 0;
+  for (c = 0; c < n; c++)
+    {
+      records += cv[c].SeismicRecords;
+      if (cv[c].status)
+	ret = -1;
+    }
+  fprintf (stdout,
+	   "%s End of File reached %ld seismic records processed\n", path,
+	   records);
+  for (k = 0; k < NSUBBOTTOM; k++)
+    for (c = 0; c < sp.nfile[k]; c++)
+      fprintf (stdout, "  %s  %lu traces\n", sp.file[k][c].name,
+	       sp.file[k][c].count);
+  fprintf (stdout,
+	   "%.1f MB of input in %.2f s (%.1f MB/s) in %lu chunks\n",
+	   (end - start) / 1e6, secs,
+	   secs > 0 ? (end - start) / 1e6 / secs : 0.0, (unsigned long) n);
+
+out:
+  close (fd);
+  for (c = 0; sp.chunk != NULL && c < n; c++)
+    for (k = 0; k < NSUBBOTTOM; k++)
+      free (sp.chunk[c].run[k]);
+  for (k = 0; k < NSUBBOTTOM; k++)
+    free (sp.file[k]);
+  free (sp.chunk);
+  free (cost);
+  free (cv);
+  return ret;
 }
@@ -0,0 +1,372 @@
+/*
+ * jsfaux.c
+ *
+ * Auxiliary sensor cache.  See jsfaux.h.
+ *
+ * Message layouts (after the 16 byte JSF header, little-endian), all
+ * starting with the time in seconds since 1970 (0-3) and milliseconds
+ * in the current second (4-7):
+ *
+ *   2002 NMEA		12-	NMEA sentence (GGA, RMC or GLL used)
+ *   2020 pitch/roll	24-25 pitch, 26-27 roll (180/32768 degrees),
+ *			32-33 heave (mm), 34-35 heading (0.01 degrees),
+ *			36-39 validity (bit 6 pitch, 7 roll, 8 heave,
+ *			9 heading)
+ *   2060 pressure	24-27 validity (bit 5 depth), 36-39 depth (mm)
+ *   2080 DVL		12-15 flags (bit 5 ranges), 16-31 range to the
+ *			bottom of each of four beams (cm, 0 none)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "byteio.h"
+#include "jsfaux.h"
+
+#define NMEA_MSG	2002	/* time stamped NMEA string */
+#define PITCH_ROLL_MSG	2020	/* pitch/roll from the MRU */
+#define PRESS_MSG	2060	/* pressure sensor reading */
+#define DOPPLER_MSG	2080	/* Doppler velocity log */
+
+#define NMEA_MAX	96	/* longest NMEA sentence looked at */
+#define NMEA_FIELDS	16
+
+static const struct
+{
+  int col0;
+  int ncol;
+} series[AUX_NSERIES] =
+{
+  {AUX_LON, 2},			/* AUX_NAV */
+  {AUX_PITCH, 4},		/* AUX_ATT */
+  {AUX_DEPTH, 1},		/* AUX_PRESS */
+  {AUX_ALTITUDE, 1},		/* AUX_DVL */
+};
+
+#define SLOT(ac, n) ((n) % (ac)->cap)
+
+int
+aux_init (AuxCache * ac, size_t cap)
+{
+  AuxSeries *s;
+  int k, j;
+
+  memset (ac, 0, sizeof (*ac));
+  ac->cap = cap;
+  for (k = 0; k < AUX_NSERIES; k++)
+    {
+      s = &ac->s[k];
+      s->col0 = series[k].col0;
+      s->ncol = series[k].ncol;
+      if ((s->t = (double *) malloc ((size_t) (1 + s->ncol) * cap
+				     * sizeof (double))) == NULL)
+	{
+	  aux_free (ac);
+	  return -1;
+	}
+      for (j = 0; j < s->ncol; j++)
+	s->v[j] = s->t + (size_t) (1 + j) * cap;
+    }
+  return 0;
+}
+
+void
+aux_free (AuxCache * ac)
+{
+  int k;
+
+  for (k = 0; k < AUX_NSERIES; k++)
+    free (ac->s[k].t);
+  memset (ac, 0, sizeof (*ac));
+}
+
+int
+aux_sensor (unsigned int type)
+{
+  return type == NMEA_MSG || type == PITCH_ROLL_MSG || type == PRESS_MSG
+    || type == DOPPLER_MSG;
+}
+
+/*
+ * Time of a sonar ping: seconds (header bytes 0-3) and the milliseconds
+ * of the second from the milliseconds today (200-203)
+ */
+
+double
+aux_ping_time (const unsigned char *head)
+{
+  return (double) ld_le32 (head) + (ld_le32 (head + 200) % 1000) / 1000.0;
+}
+
+/*
+ * Append a sample, dropping the oldest when the ring is full.  Samples
+ * that go back in time are dropped so the series stays sorted.
+ */
+
+static int
+append (AuxCache * ac, int k, double t, const double *v)
+{
+  AuxSeries *s = &ac->s[k];
+  size_t i;
+  int j;
+
+  if (s->last > s->first && t < s->t[SLOT (ac, s->last - 1)])
+    return 0;
+  if (s->last - s->first == ac->cap)
+    {
+      s->first++;
+      if (s->cur < s->first)
+	s->cur = s->first;
+    }
+  i = SLOT (ac, s->last);
+  s->t[i] = t;
+  for (j = 0; j < s->ncol; j++)
+    s->v[j][i] = v[j];
+  s->last++;
+  ac->nsample[k]++;
+  return 1;
+}
+
+/*
+ * ddmm.mmm and a hemisphere letter to signed degrees
+ */
+
+static double
+nmea_angle (const char *val, const char *hemi)
+{
+  double a;
+  char *end;
+
+  a = strtod (val, &end);
+  if (end == val || (*hemi != 'N' && *hemi != 'S' && *hemi != 'E'
+		     && *hemi != 'W'))
+    return NAN;
+  a = floor (a / 100.0) + fmod (a, 100.0) / 60.0;
+  return *hemi == 'S' || *hemi == 'W' ? -a : a;
+}
+
+/*
+ * Position from a GGA, RMC or GLL sentence, checksum verified when
+ * there is one.  Returns 0, or -1 if the sentence has no valid fix.
+ */
+
+static int
+nmea_position (const unsigned char *p, size_t n, double *v)
+{
+  char buf[NMEA_MAX + 1], *f[NMEA_FIELDS], *q, *c;
+  unsigned int sum = 0;
+  int nf = 0;
+  size_t len;
+
+  for (len = 0; len < n && len < NMEA_MAX && p[len] != '\0'
+       && p[len] != '\r' && p[len] != '\n'; len++)
+    buf[len] = (char) p[len];
+  buf[len] = '\0';
+  if (len < 7 || buf[0] != '$')
+    return -1;
+
+  if ((q = strchr (buf, '*')) != NULL)
+    {
+      *q = '\0';
+      for (c = buf + 1; *c != '\0'; c++)
+	sum ^= (unsigned char) *c;
+      if (strtoul (q + 1, NULL, 16) != sum)
+	return -1;
+    }
+
+  for (q = buf, f[nf++] = q; (q = strchr (q, ',')) != NULL
+       && nf < NMEA_FIELDS;)
+    {
+      *q++ = '\0';
+      f[nf++] = q;
+    }
+
+  if (strcmp (f[0] + 3, "GGA") == 0 && nf > 6 && *f[6] != '0')
+    {
+      v[1] = nmea_angle (f[2], f[3]);
+      v[0] = nmea_angle (f[4], f[5]);
+    }
+  else if (strcmp (f[0] + 3, "RMC") == 0 && nf > 6 && *f[2] == 'A')
+    {
+      v[1] = nmea_angle (f[3], f[4]);
+      v[0] = nmea_angle (f[5], f[6]);
+    }
+  else if (strcmp (f[0] + 3, "GLL") == 0 && nf > 6 && *f[6] == 'A')
+    {
+      v[1] = nmea_angle (f[1], f[2]);
+      v[0] = nmea_angle (f[3], f[4]);
+    }
+  else
+    return -1;
+  return isnan (v[0]) || isnan (v[1]) ? -1 : 0;
+}
+
+/*
+ * Decode one sensor message payload p of n bytes.  Returns 1 if it gave
+ * a sample, 0 if not.
+ */
+
+int
+aux_add (AuxCache * ac, unsigned int type, const unsigned char *p, size_t n)
+{
+  double t, v[4];
+  uint32_t flags, range;
+  int k, beams;
+
+  if (n < 12)
+    {
+      ac->nbad++;
+      return 0;
+    }
+  t = (double) ld_le32 (p) + (ld_le32 (p + 4) % 1000) / 1000.0;
+  ac->tlast = t;
+
+  switch (type)
+    {
+    case NMEA_MSG:
+      if (nmea_position (p + 12, n - 12, v) == -1)
+	break;
+      return append (ac, AUX_NAV, t, v);
+
+    case PITCH_ROLL_MSG:
+      if (n < 40)
+	break;
+      flags = ld_le32 (p + 36);
+      if (flags == 0)
+	flags = ~0u;		/* no validity flags: all valid */
+      v[0] = flags & (1 << 6) ? (int16_t) ld_le16 (p + 24) * (180.0 / 32768.0)
+	: NAN;
+      v[1] = flags & (1 << 7) ? (int16_t) ld_le16 (p + 26) * (180.0 / 32768.0)
+	: NAN;
+      v[2] = flags & (1 << 9) ? ld_le16 (p + 34) / 100.0 : NAN;
+      v[3] = flags & (1 << 8) ? (int16_t) ld_le16 (p + 32) / 1000.0 : NAN;
+      if (isnan (v[0]) && isnan (v[1]) && isnan (v[2]) && isnan (v[3]))
+	break;
+      return append (ac, AUX_ATT, t, v);
+
+    case PRESS_MSG:
+      if (n < 40 || !(ld_le32 (p + 24) & (1 << 5)))
+	break;
+      v[0] = (int32_t) ld_le32 (p + 36) / 1000.0;
+      return append (ac, AUX_PRESS, t, v);
+
+    case DOPPLER_MSG:
+      if (n < 32 || !(ld_le32 (p + 12) & (1 << 5)))
+	break;
+      for (k = beams = 0, v[0] = 0.0; k < 4; k++)
+	if ((range = ld_le32 (p + 16 + 4 * k)) != 0)
+	  {
+	    v[0] += range / 100.0;
+	    beams++;
+	  }
+      if (!beams)
+	break;
+      v[0] /= beams;
+      return append (ac, AUX_DVL, t, v);
+    }
+  ac->nbad++;
+  return 0;
+}
+
+/*
+ * Could a sensor message still to be read bring a sample after time t?
+ * Yes while a series has none after t, until a message more than
+ * AUX_HOLD seconds after t has been read.  A series that has no
+ * samples at all counts, as its first may be on the way.
+ */
+
+int
+aux_wants (const AuxCache * ac, double t)
+{
+  const AuxSeries *s;
+  int k;
+
+  if (ac->cap == 0 || ac->tlast > t + AUX_HOLD)
+    return 0;
+  for (k = 0; k < AUX_NSERIES; k++)
+    {
+      s = &ac->s[k];
+      if (s->last == s->first || s->t[SLOT (ac, s->last - 1)] <= t)
+	return 1;
+    }
+  return 0;
+}
+
+/*
+ * Values of series s at time t into f.  Returns 1 if it had any.
+ */
+
+static int
+series_at (AuxCache * ac, AuxSeries * s, double t, AuxFix * f)
+{
+  double t0, t1, w, a, b, d;
+  size_t i0, i1;
+  int j;
+
+  if (s->last == s->first)
+    return 0;
+
+  /*
+   * Cursor onto the last sample at or before t.  Pings come in time
+   * order, so this is a step or two forward; a ping a little older than
+   * the last one (a dead sidescan channel) steps back.
+   */
+
+  while (s->cur + 1 < s->last && s->t[SLOT (ac, s->cur + 1)] <= t)
+    s->cur++;
+  while (s->cur > s->first && s->t[SLOT (ac, s->cur)] > t)
+    s->cur--;
+
+  i0 = SLOT (ac, s->cur);
+  t0 = s->t[i0];
+  if (t0 <= t && s->cur + 1 < s->last)
+    {
+      i1 = SLOT (ac, s->cur + 1);
+      t1 = s->t[i1];
+      w = t1 > t0 ? (t - t0) / (t1 - t0) : 0.0;
+      for (j = 0; j < s->ncol; j++)
+	{
+	  a = s->v[j][i0];
+	  b = s->v[j][i1];
+	  if (s->col0 + j == AUX_HEADING)
+	    {
+	      d = fmod (b - a + 540.0, 360.0) - 180.0;
+	      f->v[s->col0 + j] = fmod (a + w * d + 360.0, 360.0);
+	    }
+	  else
+	    f->v[s->col0 + j] = a + w * (b - a);
+	}
+      return 1;
+    }
+
+  /*
+   * Nothing on the other side of t yet: hold the nearest sample
+   */
+
+  if (fabs (t - t0) > AUX_HOLD)
+    return 0;
+  for (j = 0; j < s->ncol; j++)
+    f->v[s->col0 + j] = s->v[j][i0];
+  return 1;
+}
+
+/*
+ * The fix at time t.  Returns f->have, a bit for each series that gave
+ * values; the values of the others are NaN.
+ */
+
+unsigned int
+aux_at (AuxCache * ac, double t, AuxFix * f)
+{
+  int k;
+
+  f->have = 0;
+  for (k = 0; k < AUX_NVAL; k++)
+    f->v[k] = NAN;
+  if (ac->cap == 0)
+    return 0;
+  for (k = 0; k < AUX_NSERIES; k++)
+    if (series_at (ac, &ac->s[k], t, f))
+      f->have |= 1u << k;
+  return f->have;
+}
@@ -0,0 +1,86 @@
+/*
+ * jsfaux.h
+ *
+ * Auxiliary sensor cache: navigation and attitude for each ping from the
+ * sensor messages around it.
+ *
+ * As the JSF file streams past, NMEA (2002), pitch/roll (2020), pressure
+ * (2060) and DVL (2080) messages are decoded into one time-sorted series
+ * per sensor, each a set of columns (the sample times and one array per
+ * value) kept in a ring of a fixed number of samples, so memory stays
+ * bounded on files of any length.
+ *
+ * Pings come in time order, so each series keeps a cursor on its last
+ * sample at or before the previous ping and aux_at() walks it forward
+ * (a step or two per ping, not a search).  A value is interpolated
+ * linearly between the samples either side of the ping time.  Sensor
+ * messages come ahead of the pings they bracket, so the caller reads
+ * them ahead of each ping while aux_wants() says a sample after it may
+ * still come; where none does (within AUX_HOLD seconds, or before the
+ * caller's look-ahead runs out) the nearest sample is held, for up to
+ * AUX_HOLD seconds.  Headings are interpolated the short way round.
+ * Values a sensor marks invalid, or that are not there, are NaN.
+ */
+
+#ifndef _JSFAUX_H_
+#define _JSFAUX_H_
+
+#include <stddef.h>
+
+/* Values of a fix, and the series they come from */
+
+#define AUX_LON		0	/* degrees, east positive (NMEA) */
+#define AUX_LAT		1	/* degrees, north positive (NMEA) */
+#define AUX_PITCH	2	/* degrees (pitch/roll) */
+#define AUX_ROLL	3	/* degrees (pitch/roll) */
+#define AUX_HEADING	4	/* degrees, 0 ... 360 (pitch/roll) */
+#define AUX_HEAVE	5	/* metres (pitch/roll) */
+#define AUX_DEPTH	6	/* metres (pressure) */
+#define AUX_ALTITUDE	7	/* metres above the bottom (DVL) */
+#define AUX_NVAL	8
+
+#define AUX_NAV		0	/* series */
+#define AUX_ATT		1
+#define AUX_PRESS	2
+#define AUX_DVL		3
+#define AUX_NSERIES	4
+
+#define AUX_SAMPLES	4096	/* ring size of each series */
+#define AUX_HOLD	5.0	/* seconds a sample may be held past its time */
+
+typedef struct
+{
+  int col0;			/* first value of the fix it fills */
+  int ncol;
+  double *t;			/* sample times, seconds since 1970 */
+  double *v[4];			/* one column per value */
+  unsigned long first;		/* oldest sample still in the ring */
+  unsigned long last;		/* one past the newest */
+  unsigned long cur;		/* last sample at or before the last ping */
+} AuxSeries;
+
+typedef struct
+{
+  AuxSeries s[AUX_NSERIES];
+  size_t cap;
+  unsigned long nsample[AUX_NSERIES];	/* samples decoded */
+  unsigned long nbad;		/* messages that could not be used */
+  double tlast;			/* time of the last message added */
+} AuxCache;
+
+typedef struct
+{
+  double v[AUX_NVAL];
+  unsigned int have;		/* bit per series that gave values */
+} AuxFix;
+
+int aux_init (AuxCache * ac, size_t cap);
+void aux_free (AuxCache * ac);
+int aux_sensor (unsigned int type);
+int aux_add (AuxCache * ac, unsigned int type, const unsigned char *p,
+	     size_t n);
+int aux_wants (const AuxCache * ac, double t);
+unsigned int aux_at (AuxCache * ac, double t, AuxFix * f);
+double aux_ping_time (const unsigned char *head);
+
+#endif /* _JSFAUX_H_ */
@@ -0,0 +1,214 @@
+/*
+ * jsfbatch.c
+ *
+ * Work-stealing batch pool.  See jsfbatch.h.
+ *
+ * Each thread owns a queue of job numbers sorted by decreasing cost and
+ * guarded by its own mutex.  The owner and thieves both take from the
+ * head, the largest job left in that queue: with whole files as jobs
+ * there is too little traffic for contention to matter, and it keeps the
+ * schedule largest first across all queues.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "jsfbatch.h"
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  size_t *job;			/* job numbers, largest cost first */
+  size_t head;			/* next job to take */
+  size_t count;
+} BatchQueue;
+
+typedef struct
+{
+  BatchQueue *queue;
+  int nqueues;
+  const off_t *cost;
+  batch_fn run;
+  void *arg;
+} BatchPool;
+
+typedef struct
+{
+  BatchPool *pool;
+  int self;			/* index of the thread's own queue */
+} BatchThread;
+
+static const off_t *sort_cost;
+
+static int
+by_cost (const void *a, const void *b)
+{
+  off_t ca = sort_cost[*(const size_t *) a];
+  off_t cb = sort_cost[*(const size_t *) b];
+
+  if (ca != cb)
+    return ca < cb ? 1 : -1;
+  return *(const size_t *) a < *(const size_t *) b ? -1 : 1;
+}
+
+/*
+ * Take the head of queue q.  Returns 0 and the job, or -1 if it is empty.
+ */
+
+static int
+take (BatchQueue * q, size_t * job)
+{
+  int ret = -1;
+
+  pthread_mutex_lock (&q->lock);
+  if (q->head < q->count)
+    {
+      *job = q->job[q->head++];
+      ret = 0;
+    }
+  pthread_mutex_unlock (&q->lock);
+  return ret;
+}
+
+/*
+ * Steal the largest job waiting in any other queue.  If the victim's
+ * head is taken between looking and taking, look again.
+ */
+
+static int
+steal (BatchPool * bp, int self, size_t * job)
+{
+  BatchQueue *q;
+  off_t best;
+  int k, victim;
+
+  for (;;)
+    {
+      victim = -1;
+      best = -1;
+      for (k = 0; k < bp->nqueues; k++)
+	{
+	  q = &bp->queue[k];
+	  if (k == self)
+	    continue;
+	  pthread_mutex_lock (&q->lock);
+	  if (q->head < q->count && bp->cost[q->job[q->head]] > best)
+	    {
+	      best = bp->cost[q->job[q->head]];
+	      victim = k;
+	    }
+	  pthread_mutex_unlock (&q->lock);
+	}
+      if (victim == -1)
+	return -1;
+      if (take (&bp->queue[victim], job) == 0)
+	return 0;
+    }
+}
+
+static void *
+batch_main (void *arg)
+{
+  BatchThread *bt = (BatchThread *) arg;
+  BatchPool *bp = bt->pool;
+  size_t job;
+
+  while (take (&bp->queue[bt->self], &job) == 0
+	 || steal (bp, bt->self, &job) == 0)
+    bp->run (bp->arg, job);
+  return NULL;
+}
+
+/*
+ * Returns 0 once every job has run, or -1 if no memory or thread could
+ * be had.  If only some threads start, those run all the jobs.
+ */
+
+int
+batch_run (size_t njobs, const off_t * cost, int threads, batch_fn run,
+	   void *arg)
+{
+  BatchPool bp;
+  BatchThread *bt;
+  pthread_t *tid;
+  size_t *order, k;
+  int t, started, ret = 0;
+
+  if (njobs == 0)
+    return 0;
+  if (threads < 1)
+    threads = 1;
+  if ((size_t) threads > njobs)
+    threads = (int) njobs;
+
+  order = (size_t *) calloc (njobs, sizeof (size_t));
+  bp.queue = (BatchQueue *) calloc ((size_t) threads, sizeof (BatchQueue));
+  bt = (BatchThread *) calloc ((size_t) threads, sizeof (BatchThread));
+  tid = (pthread_t *) calloc ((size_t) threads, sizeof (pthread_t));
+  if (order == NULL || bp.queue == NULL || bt == NULL || tid == NULL)
+    {
+      ret = -1;
+      goto out;
+    }
+  for (k = 0; k < njobs; k++)
+    order[k] = k;
+  sort_cost = cost;
+  qsort (order, njobs, sizeof (size_t), by_cost);
+
+  bp.nqueues = threads;
+  bp.cost = cost;
+  bp.run = run;
+  bp.arg = arg;
+
+  /*
+   * Deal the sorted jobs round robin: queue t gets jobs t, t+threads ...
+   * which are already in decreasing order of cost.
+   */
+
+  for (t = 0; t < threads; t++)
+    {
+      pthread_mutex_init (&bp.queue[t].lock, NULL);
+      bt[t].pool = &bp;
+      bt[t].self = t;
+    }
+  for (t = 0; t < threads; t++)
+    {
+      bp.queue[t].job = (size_t *) calloc (njobs / threads + 1,
+					   sizeof (size_t));
+      if (bp.queue[t].job == NULL)
+	{
+	  ret = -1;
+	  goto out;
+	}
+    }
+  for (k = 0; k < njobs; k++)
+    {
+      t = (int) (k % threads);
+      bp.queue[t].job[bp.queue[t].count++] = order[k];
+    }
+
+  /*
+   * The calling thread works queue 0 itself.
+   */
+
+  for (t = 1, started = 1; t < threads; t++)
+    if (pthread_create (&tid[t], NULL, batch_main, &bt[t]) == 0)
+      started++;
+    else
+      break;
+  batch_main (&bt[0]);
+  for (t = 1; t < started; t++)
+    pthread_join (tid[t], NULL);
+
+out:
+  if (bp.queue != NULL)
+    for (t = 0; t < threads; t++)
+      {
+	free (bp.queue[t].job);
+	pthread_mutex_destroy (&bp.queue[t].lock);
+      }
+  free (bp.queue);
+  free (bt);
+  free (tid);
+  free (order);
+  return ret;
+}
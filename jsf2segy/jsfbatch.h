@@ -0,0 +1,26 @@
+/*
+ * jsfbatch.h
+ *
+ * Work-stealing pool for converting many files at once.
+ *
+ * batch_run() calls run(arg, k) once for every job k in 0..njobs-1 on
+ * up to threads threads.  Jobs are sorted by cost (the input file size),
+ * largest first, and dealt round robin onto one queue per thread, so
+ * each thread starts on the largest jobs it was given.  A thread whose
+ * queue runs dry steals from the other queues, taking the largest job
+ * still waiting anywhere.  Scheduling long conversions first keeps one
+ * big file from starting last and finishing long after the rest.
+ */
+
+#ifndef _JSFBATCH_H_
+#define _JSFBATCH_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef void (*batch_fn) (void *arg, size_t job);
+
+int batch_run (size_t njobs, const off_t * cost, int threads, batch_fn run,
+	       void *arg);
+
+#endif /* _JSFBATCH_H_ */
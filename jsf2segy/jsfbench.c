@@ -0,0 +1,855 @@
+/*
+ * jsfbench.c
+ *
+ * Micro-benchmark for the JSF field decoders.  Times the old calloc/free
+ * based get_short(), get_int(), get_float() and get_double() (kept here
+ * as legacy_*) against the inline decoders in byteio.h, per field and
+ * per ping (a 16k sample analytic ping decoded the way main() does it).
+ * Then times each trace conversion kernel in jsfconv.c that this CPU
+ * supports and checks that they match the scalar kernel bit for bit,
+ * and that the precise envelope matches the original ldexp/sqrt code.
+ * The SEG Y sample format kernels (IBM float, integers, the int16
+ * passthrough) are timed and checked the same way.
+ *
+ * With -f, then times each stage of a conversion on a real (or jsfgen)
+ * JSF file, for every mode the file has pings for: parsing the messages
+ * (read and mmap), converting the samples, and writing SEG Y traces
+ * through segyout.c, each on its own; with -x also the whole jsf2segy
+ * binary given, on one thread and on several.  Stage rates are in MB/s
+ * of the bytes each stage consumes and in pings/s.  make bench runs it
+ * on a file from jsfgen.
+ *
+ * Usage:	jsfbench [-n samples] [-p pings] [-f file.jsf [-x jsf2segy]
+ *		[-t tmpdir]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "byteio.h"
+#include "jsfconv.h"
+#include "libjsf.h"
+#include "segyout.h"
+
+#define FIELD_LOOPS 2000000
+
+static volatile double sink;
+
+static double
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/*
+ * The decoders as they were in jsf2segy.c (little-endian host branch).
+ * calloc and free are called through volatile pointers so the compiler
+ * cannot elide the allocation the way it can for a known calloc/free pair.
+ */
+
+static void *(*volatile legacy_calloc) (size_t, size_t) = calloc;
+static void (*volatile legacy_free) (void *) = free;
+
+static short
+legacy_get_short (unsigned char *inbuf, int location)
+{
+  short value;
+  unsigned char *ptr3;
+
+  ptr3 = (unsigned char *) legacy_calloc (1, sizeof (short));
+  memcpy (ptr3, inbuf + location, 2);
+  value = *(short *) ptr3;
+  legacy_free (ptr3);
+  return (value);
+}
+
+static int
+legacy_get_int (unsigned char *buf, int location)
+{
+  int value;
+  unsigned char *ptr3;
+
+  ptr3 = (unsigned char *) legacy_calloc (1, sizeof (int));
+  memcpy (ptr3, buf + location, 4);
+  value = *(int *) ptr3;
+  legacy_free (ptr3);
+  return (value);
+}
+
+static float
+legacy_get_float (unsigned char *inbuf, int location)
+{
+  float value;
+  unsigned char *ptr3;
+
+  ptr3 = (unsigned char *) legacy_calloc (1, sizeof (float));
+  memcpy (ptr3, inbuf + location, 4);
+  value = *(float *) ptr3;
+  legacy_free (ptr3);
+  return (value);
+}
+
+static double
+legacy_get_double (unsigned char *inbuf, int location)
+{
+  double value;
+  unsigned char *ptr3;
+
+  ptr3 = (unsigned char *) legacy_calloc (1, sizeof (double));
+  memcpy (ptr3, inbuf + location, 8);
+  value = *(double *) ptr3;
+  legacy_free (ptr3);
+  return (value);
+}
+
+static float
+legacy_floatFlip (float *value)
+{
+  int i;
+  unsigned char *ptr1, *ptr3;
+  float returnValue;
+
+  ptr1 = (unsigned char *) value;
+  ptr3 = (unsigned char *) legacy_calloc (1, sizeof (float));
+  ptr1 += 3;
+  for (i = 0; i < 4; i++)
+    *ptr3++ = *ptr1--;
+  ptr3 -= 4;
+  returnValue = *(float *) ptr3;
+  legacy_free (ptr3);
+  return (returnValue);
+}
+
+/*
+ * Per field timing.  Locations step through an odd stride so most
+ * loads are unaligned, as they are in a JSF header.
+ */
+
+#define FIELD_BENCH(name, fn, buf)				\
+  do {								\
+    double t0, acc = 0;						\
+    int k;							\
+    t0 = now_ns ();						\
+    for (k = 0; k < FIELD_LOOPS; k++)				\
+      acc += (double) fn (buf, (k * 7) & 127);			\
+    sink = acc;							\
+    fprintf (stdout, "  %-20s %8.2f ns/field\n", name,		\
+	     (now_ns () - t0) / FIELD_LOOPS);			\
+  } while (0)
+
+static void
+ping_legacy (unsigned char *data, int nsamp, short weight, float *out)
+{
+  int i, j;
+
+  for (i = 0, j = 0; i < nsamp * 4; i += 4, j++)
+    {
+      out[j] = (float)
+	sqrt ((double) ldexp ((double) legacy_get_short (data, i), weight) *
+	      (double) ldexp ((double) legacy_get_short (data, i), weight) +
+	      (double) ldexp ((double) legacy_get_short (data, i + 2),
+			      weight) *
+	      (double) ldexp ((double) legacy_get_short (data, i + 2),
+			      weight));
+      out[j] = legacy_floatFlip (&out[j]);
+    }
+}
+
+static void
+ping_inline (unsigned char *data, int nsamp, short weight, float *out)
+{
+  int i, j;
+
+  for (i = 0, j = 0; i < nsamp * 4; i += 4, j++)
+    {
+      out[j] = (float)
+	sqrt ((double) ldexp ((double) get_short (data, i), weight) *
+	      (double) ldexp ((double) get_short (data, i), weight) +
+	      (double) ldexp ((double) get_short (data, i + 2), weight) *
+	      (double) ldexp ((double) get_short (data, i + 2), weight));
+      out[j] = floatFlip (&out[j]);
+    }
+}
+
+/*
+ * Time one conversion kernel over npings traces and compare its output
+ * (for a spread of weights including the out of range ones) with ref.
+ */
+
+static int
+bench_kernel (const char *isa, unsigned char *data, int nsamp, int npings,
+	      float *ref, float *out)
+{
+  static const int weights[] = { -120, -30, -8, 0, 5, 30, 120 };
+  int k, w, stride, bad = 0;
+  double t0, t;
+
+  if (!conv_select (isa))
+    return 0;
+  for (stride = 1; stride <= 2; stride++)
+    {
+      t0 = now_ns ();
+      for (k = 0; k < npings; k++)
+	conv_i16_f32 (data, stride, nsamp, -(k % 8), 1, out);
+      t = (now_ns () - t0) / npings;
+      fprintf (stdout, "  %-8s stride %d %10.1f us/ping %8.0f MB/s in\n",
+	       isa, stride, t / 1e3, (double) nsamp * 2 * stride / t * 1e3);
+
+      for (w = 0; w < (int) (sizeof (weights) / sizeof (weights[0])); w++)
+	{
+	  conv_select ("scalar");
+	  conv_i16_f32 (data, stride, nsamp - 3, weights[w], 1, ref);
+	  conv_select (isa);
+	  conv_i16_f32 (data, stride, nsamp - 3, weights[w], 1, out);
+	  if (memcmp (ref, out, (size_t) (nsamp - 3) * sizeof (float)) != 0)
+	    bad++;
+	}
+    }
+
+  /*
+   * Unsigned (sidescan) samples
+   */
+
+  t0 = now_ns ();
+  for (k = 0; k < npings; k++)
+    conv_u16_f32 (data, 1, nsamp, -(k % 8), 1, out);
+  t = (now_ns () - t0) / npings;
+  fprintf (stdout, "  %-8s uint16   %10.1f us/ping %8.0f MB/s in\n",
+	   isa, t / 1e3, (double) nsamp * 2 / t * 1e3);
+  for (w = 0; w < (int) (sizeof (weights) / sizeof (weights[0])); w++)
+    {
+      conv_select ("scalar");
+      conv_u16_f32 (data, 1, nsamp - 3, weights[w], 1, ref);
+      conv_select (isa);
+      conv_u16_f32 (data, 1, nsamp - 3, weights[w], 1, out);
+      if (memcmp (ref, out, (size_t) (nsamp - 3) * sizeof (float)) != 0)
+	bad++;
+    }
+  if (bad)
+    fprintf (stdout, "  %-8s differs from scalar\n", isa);
+  return bad;
+}
+
+/*
+ * Same for the analytic envelope kernel, in both precisions.  The
+ * precise envelope of the last ping must also equal legacy, which was
+ * produced by ping_legacy() with the same weight.
+ */
+
+static int
+bench_envelope (const char *isa, unsigned char *data, int nsamp, int npings,
+		const float *legacy, float *ref, float *out)
+{
+  static const int weights[] = { -120, -30, -8, 0, 5, 30, 120 };
+  int k, w, precise, bad = 0;
+  double t0, t;
+
+  if (!conv_select (isa))
+    return 0;
+  for (precise = 0; precise <= 1; precise++)
+    {
+      t0 = now_ns ();
+      for (k = 0; k < npings; k++)
+	conv_ana_env (data, nsamp, -(k % 8), 1, precise, out);
+      t = (now_ns () - t0) / npings;
+      fprintf (stdout, "  %-8s %-6s %10.1f us/ping %8.0f MB/s in\n",
+	       isa, precise ? "double" : "float", t / 1e3,
+	       (double) nsamp * 4 / t * 1e3);
+      if (precise
+	  && memcmp (legacy, out, (size_t) nsamp * sizeof (float)) != 0)
+	bad++;
+
+      for (w = 0; w < (int) (sizeof (weights) / sizeof (weights[0])); w++)
+	{
+	  conv_select ("scalar");
+	  conv_ana_env (data, nsamp - 3, weights[w], 1, precise, ref);
+	  conv_select (isa);
+	  conv_ana_env (data, nsamp - 3, weights[w], 1, precise, out);
+	  if (memcmp (ref, out, (size_t) (nsamp - 3) * sizeof (float)) != 0)
+	    bad++;
+	}
+    }
+  if (bad)
+    fprintf (stdout, "  %-8s envelope differs\n", isa);
+  return bad;
+}
+
+/*
+ * Same for the static correction time shift, over a spread of whole,
+ * fractional, negative and out of range shifts
+ */
+
+static int
+bench_shift (const char *isa, const float *in, int nsamp, int npings,
+	     float *ref, float *out)
+{
+  static const float shifts[] = { -20000.0f, -37.25f, -0.5f, 0.0f, 0.125f,
+    3.0f, 411.7f, 20000.0f
+  };
+  int k, w, bad = 0;
+  double t0, t;
+
+  if (!conv_select (isa))
+    return 0;
+  t0 = now_ns ();
+  for (k = 0; k < npings; k++)
+    conv_shift_f32 (in, nsamp, 10.0f + k * 0.37f, 1, out);
+  t = (now_ns () - t0) / npings;
+  fprintf (stdout, "  %-8s %10.1f us/ping %8.0f MB/s in\n",
+	   isa, t / 1e3, (double) nsamp * 4 / t * 1e3);
+
+  for (w = 0; w < (int) (sizeof (shifts) / sizeof (shifts[0])); w++)
+    {
+      conv_select ("scalar");
+      conv_shift_f32 (in, nsamp - 3, shifts[w], 1, ref);
+      conv_select (isa);
+      conv_shift_f32 (in, nsamp - 3, shifts[w], 1, out);
+      if (memcmp (ref, out, (size_t) (nsamp - 3) * sizeof (float)) != 0)
+	bad++;
+    }
+  if (bad)
+    fprintf (stdout, "  %-8s time shift differs\n", isa);
+  return bad;
+}
+
+/*
+ * Window and decimation, timed at 4 with its anti-alias filter, checked
+ * against scalar over factors with and without the filter and windows
+ * inside, across both ends of and outside the trace
+ */
+
+static int
+bench_decim (const char *isa, const float *in, int nsamp, int npings,
+	     float *ref, float *out)
+{
+  static const int factors[] = { 1, 2, 3, 4, 7, 16 };
+  static const int firsts[] = { -5000, -37, 0, 11, 1234 };
+  float h[CONV_TAPS (CONV_DECIM_MAX)];
+  int k, w, f, ntaps, nout, bad = 0;
+  double t0, t;
+
+  if (!conv_select (isa))
+    return 0;
+  ntaps = conv_decim_taps (4, h);
+  t0 = now_ns ();
+  for (k = 0; k < npings; k++)
+    conv_decim_f32 (in, nsamp, 0, 4, h, ntaps, 1, nsamp / 4, out);
+  t = (now_ns () - t0) / npings;
+  fprintf (stdout, "  %-8s %10.1f us/ping %8.0f MB/s in\n",
+	   isa, t / 1e3, (double) nsamp * 4 / t * 1e3);
+
+  for (f = 0; f < (int) (sizeof (factors) / sizeof (factors[0])); f++)
+    for (w = 0; w < (int) (sizeof (firsts) / sizeof (firsts[0])); w++)
+      for (k = 0; k < 2; k++)
+	{
+	  if (k)
+	    ntaps = conv_decim_taps (factors[f], h);
+	  else
+	    {
+	      h[0] = 1.0f;
+	      ntaps = 1;
+	    }
+	  nout = (nsamp - 3) / factors[f] - 5;
+	  conv_select ("scalar");
+	  conv_decim_f32 (in, nsamp - 3, firsts[w], factors[f], h, ntaps, 1,
+			  nout, ref);
+	  conv_select (isa);
+	  conv_decim_f32 (in, nsamp - 3, firsts[w], factors[f], h, ntaps, 1,
+			  nout, out);
+	  if (memcmp (ref, out, (size_t) nout * sizeof (float)) != 0)
+	    bad++;
+	}
+  if (bad)
+    fprintf (stdout, "  %-8s decimation differs\n", isa);
+  return bad;
+}
+
+/*
+ * SEG Y sample format kernels: time each on a trace, then check it
+ * against scalar both ways round, on an odd length and packing in place
+ */
+
+#define NPACK 6
+
+static void
+run_pack (int f, const float *in, const unsigned char *data, int nsamp,
+	  int swap, void *out)
+{
+  switch (f)
+    {
+    case 0:
+      conv_f32_ibm (in, nsamp, 0, swap, out);
+      break;
+    case 1:
+      conv_f32_i32 (in, nsamp, 14, swap, out);
+      break;
+    case 2:
+      conv_f32_i16 (in, nsamp, conv_int_weight (conv_peak_f32 (in, nsamp),
+						16), swap, out);
+      break;
+    case 3:
+      conv_f32_i8 (in, nsamp, 2, swap, out);
+      break;
+    case 4:
+      conv_i16_i16 (data, 1, nsamp, swap, out);
+      break;
+    case 5:
+      conv_i16_i16 (data, 2, nsamp / 2, swap, out);
+      break;
+    }
+}
+
+static int
+bench_pack (const char *isa, const float *in, const unsigned char *data,
+	    int nsamp, int npings, float *ref, float *out)
+{
+  static const char *name[NPACK] = {
+    "ibm", "int32", "int16", "int8", "copy16", "copy16x2"
+  };
+  static const int bytes[NPACK] = { 4, 4, 2, 1, 2, 1 };
+  int f, k, swap, n, len, bad = 0;
+  double t0, t;
+
+  if (!conv_select (isa))
+    return 0;
+  for (f = 0; f < NPACK; f++)
+    {
+      t0 = now_ns ();
+      for (k = 0; k < npings; k++)
+	run_pack (f, in, data, nsamp, 1, out);
+      t = (now_ns () - t0) / npings;
+      fprintf (stdout, "  %-8s %-8s %8.1f us/ping %8.0f MB/s out\n",
+	       isa, name[f], t / 1e3, (double) nsamp * bytes[f] / t * 1e3);
+
+      for (swap = 0; swap < 2; swap++)
+	for (n = nsamp - 5; n <= nsamp; n += 5)
+	  {
+	    conv_select ("scalar");
+	    run_pack (f, in, data, n, swap, ref);
+	    conv_select (isa);
+	    run_pack (f, in, data, n, swap, out);
+	    len = f == 5 ? n / 2 * 2 : n * bytes[f];
+	    if (memcmp (ref, out, (size_t) len) != 0)
+	      bad++;
+	    if (f < 4)
+	      {
+		memcpy (out, in, (size_t) n * sizeof (float));
+		run_pack (f, out, data, n, swap, out);
+		if (memcmp (ref, out, (size_t) len) != 0)
+		  bad++;
+	      }
+	  }
+      if (bad)
+	{
+	  fprintf (stdout, "  %-8s %s differs\n", isa, name[f]);
+	  return bad;
+	}
+    }
+  return 0;
+}
+
+/*
+ * File stages.  A mode is a jsf2segy option and the JSF data format its
+ * pings come from.
+ */
+
+#define NMODE	4
+
+static const struct
+{
+  const char *opt;
+  int fmt;
+} mode[NMODE] =
+{
+  {"-e", 0},
+  {"-a", 1},
+  {"-r", 3},
+  {"-x", 1},
+};
+
+static void
+report (const char *stage, const char *what, double ns, double bytes,
+	long pings)
+{
+  fprintf (stdout, "  %-9s %-8s %8.0f MB/s %10.0f pings/s %8.3f s\n",
+	   stage, what, bytes / ns * 1e3, pings / ns * 1e9, ns / 1e9);
+}
+
+/*
+ * Parse: every message header, and the trace header and samples of
+ * every subbottom ping, through the libjsf iterator.  Counts the pings
+ * of each data format on the way.
+ */
+
+static size_t
+parse_peek (const JSFMessage * m, void *arg)
+{
+  (void) arg;
+  return m->type == JSF_SONAR && m->subsystem == 0
+    && m->size >= JSF_SONARHDRLEN ? JSF_ALL : 0;
+}
+
+static int
+bench_parse (const char *path, int in_mode, long *nfmt, double *bytes)
+{
+  JSFReader r;
+  JSFMessage m;
+  const unsigned char *h;
+  double t0;
+  long pings = 0;
+  int ret;
+
+  if (jsf_open (&r, path, in_mode) == -1)
+    {
+      perror (path);
+      return -1;
+    }
+  memset (nfmt, 0, 4 * sizeof (long));
+  *bytes = 0.0;
+  t0 = now_ns ();
+  while ((ret = jsf_iter (&r, &m, parse_peek, NULL)) == 1)
+    {
+      *bytes += JSF_MSGHDRLEN + (double) m.size;
+      if ((h = m.payload) == NULL)
+	continue;
+      sink += h[0];
+      if (ld_le16 (h + 34) < 4)
+	nfmt[ld_le16 (h + 34)]++;
+      pings++;
+    }
+  report ("parse", r.mode == JSF_MMAP ? "mmap"
+	  : r.mode == JSF_URING ? "uring" : "read", now_ns () - t0, *bytes,
+	  pings);
+  jsf_close (&r);
+  return ret == -1 ? -1 : 0;
+}
+
+/*
+ * Convert and write: the samples of each ping of mode k converted as
+ * jsf2segy does (only the kernel is timed), then the trace headers and
+ * samples written to a SEG Y file in tmpdir (only segyout is timed).
+ * The file is read through a mapping so reading costs next to nothing.
+ */
+
+static int
+bench_convert_write (const char *path, int k, const char *tmpdir)
+{
+  JSFReader r;
+  JSFMessage m;
+  const unsigned char *h, *d;
+  static float out[65536];
+  unsigned char th[240];
+  char name[4096];
+  SegyOut *o;
+  double t, tc = 0.0, tw = 0.0, in = 0.0, outb = 0.0;
+  long pings = 0;
+  int nsamp, w;
+
+  snprintf (name, sizeof (name), "%s/jsfbench%d.sgy", tmpdir, (int) getpid ());
+  unlink (name);
+  if (jsf_open (&r, path, JSF_MMAP) == -1
+      || (o = segy_open (name, SEGY_BLOCK, 0)) == NULL)
+    {
+      perror (name);
+      return -1;
+    }
+  memset (th, 0, sizeof (th));
+  while (jsf_next (&r, &m) == 1)
+    {
+      if (m.type != 80 || m.subsystem != 0 || m.size < 240
+	  || (h = jsf_read (&r, m.size)) == NULL
+	  || (int16_t) ld_le16 (h + 34) != mode[k].fmt)
+	continue;
+      d = h + 240;
+      nsamp = ld_le16 (h + 114);
+      w = -(int16_t) ld_le16 (h + 168);
+
+      t = now_ns ();
+      switch (k)
+	{
+	case 0:
+	case 2:
+	  conv_i16_f32 (d, 1, (int) (m.size - 240) / 2, w, 0, out);
+	  break;
+	case 1:
+	  conv_ana_env (d, (int) (m.size - 240) / 4, w, 0, 0, out);
+	  break;
+	case 3:
+	  conv_i16_f32 (d, 2, (int) (m.size - 240) / 4, w, 0, out);
+	  break;
+	}
+      tc += now_ns () - t;
+
+      t = now_ns ();
+      if (segy_write (o, th, sizeof (th)) == -1
+	  || segy_write (o, out, (size_t) nsamp * sizeof (float)) == -1)
+	{
+	  perror (name);
+	  break;
+	}
+      tw += now_ns () - t;
+      in += m.size - 240;
+      outb += 240 + nsamp * sizeof (float);
+      pings++;
+    }
+  t = now_ns ();
+  if (segy_close (o) == -1)
+    perror (name);
+  tw += now_ns () - t;
+  jsf_close (&r);
+  unlink (name);
+  report ("convert", mode[k].opt, tc, in, pings);
+  report ("write", mode[k].opt, tw, outb, pings);
+  return 0;
+}
+
+/*
+ * The whole conversion: jsf2segy run on the file with its output in
+ * tmpdir and its messages thrown away.  MB/s is of the input file.
+ */
+
+static int
+bench_jsf2segy (const char *conv, const char *path, const char *opt,
+		const char *threads, const char *tmpdir, double bytes,
+		long pings)
+{
+  char out[4096], label[32], cmd[8192];
+  double t0;
+  pid_t pid;
+  int status;
+
+  snprintf (out, sizeof (out), "%s/jsfbench%d", tmpdir, (int) getpid ());
+  t0 = now_ns ();
+  if ((pid = fork ()) == 0)
+    {
+      int fd = open ("/dev/null", O_WRONLY);
+
+      dup2 (fd, 1);
+      dup2 (fd, 2);
+      if (threads != NULL)
+	execl (conv, conv, opt, "-j", threads, "-o", out, path, (char *) NULL);
+      else
+	execl (conv, conv, opt, "-o", out, path, (char *) NULL);
+      _exit (127);
+    }
+  if (pid == -1 || waitpid (pid, &status, 0) == -1 || !WIFEXITED (status)
+      || WEXITSTATUS (status) != 0)
+    {
+      fprintf (stdout, "  %s %s failed\n", conv, opt);
+      return -1;
+    }
+  snprintf (label, sizeof (label), "%s%s%s", opt, threads ? " -j" : "",
+	    threads ? threads : "");
+  report ("jsf2segy", label, now_ns () - t0, bytes, pings);
+  snprintf (cmd, sizeof (cmd), "rm -f '%s'*.sgy", out);
+  return system (cmd) == 0 ? 0 : -1;
+}
+
+static int
+bench_file (const char *path, const char *conv, const char *tmpdir)
+{
+  long nfmt[4];
+  double bytes;
+  char threads[24];
+  int k, bad = 0;
+  long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+
+  fprintf (stdout, "\nStages on %s\n", path);
+  if (bench_parse (path, JSF_READ, nfmt, &bytes) == -1
+      || bench_parse (path, JSF_MMAP, nfmt, &bytes) == -1
+      || bench_parse (path, JSF_URING, nfmt, &bytes) == -1)
+    return 1;
+  fprintf (stdout, "  %.1f MB, pings: %ld Envelope, %ld Analytic, %ld Real\n",
+	   bytes / 1048576.0, nfmt[0], nfmt[1], nfmt[3]);
+  for (k = 0; k < NMODE; k++)
+    if (nfmt[mode[k].fmt] && bench_convert_write (path, k, tmpdir) == -1)
+      bad++;
+  if (conv == NULL)
+    return bad;
+
+  snprintf (threads, sizeof (threads), "%ld", ncpu > 1 ? ncpu : 2);
+  for (k = 0; k < NMODE; k++)
+    if (nfmt[mode[k].fmt])
+      {
+	if (bench_jsf2segy (conv, path, mode[k].opt, NULL, tmpdir, bytes,
+			    nfmt[mode[k].fmt]) == -1)
+	  bad++;
+	if (bench_jsf2segy (conv, path, mode[k].opt, threads, tmpdir, bytes,
+			    nfmt[mode[k].fmt]) == -1)
+	  bad++;
+      }
+  return bad;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int c, i, k;
+  int nsamp = 16384;
+  int npings = 200;
+  unsigned char *data;
+  float *out_a, *out_b, *out_c;
+  double t0, t_old, t_new;
+  const char *file = NULL, *conv = NULL, *tmpdir = "/tmp";
+
+  if (getenv ("TMPDIR") != NULL)
+    tmpdir = getenv ("TMPDIR");
+  while ((c = getopt (argc, argv, "n:p:f:x:t:")) != -1)
+    {
+      switch (c)
+	{
+	case 'n':
+	  nsamp = atoi (optarg);
+	  break;
+	case 'p':
+	  npings = atoi (optarg);
+	  break;
+	case 'f':
+	  file = optarg;
+	  break;
+	case 'x':
+	  conv = optarg;
+	  break;
+	case 't':
+	  tmpdir = optarg;
+	  break;
+	default:
+	  fprintf (stderr, "Usage: %s [-n samples] [-p pings] [-f file.jsf "
+		   "[-x jsf2segy] [-t tmpdir]]\n", argv[0]);
+	  exit (EXIT_FAILURE);
+	}
+    }
+  if (nsamp <= 3 || npings <= 0)
+    {
+      fprintf (stderr, "%s: need more than 3 samples and at least one ping\n", argv[0]);
+      exit (EXIT_FAILURE);
+    }
+
+  data = (unsigned char *) malloc ((size_t) nsamp * 4 + 8);
+  out_a = (float *) malloc ((size_t) nsamp * sizeof (float));
+  out_b = (float *) malloc ((size_t) nsamp * sizeof (float));
+  out_c = (float *) malloc ((size_t) nsamp * sizeof (float));
+  if (data == NULL || out_a == NULL || out_b == NULL || out_c == NULL)
+    {
+      perror ("malloc");
+      exit (EXIT_FAILURE);
+    }
+  srand (1);
+  for (i = 0; i < nsamp * 4 + 8; i++)
+    data[i] = (unsigned char) rand ();
+  /* a (-32768, -32768) pair, whose squared sum does not fit an int */
+  data[0] = data[2] = 0x00;
+  data[1] = data[3] = 0x80;
+
+  fprintf (stdout, "Field decode (%d calls each)\n", FIELD_LOOPS);
+  FIELD_BENCH ("legacy get_short", legacy_get_short, data);
+  FIELD_BENCH ("inline get_short", get_short, data);
+  FIELD_BENCH ("legacy get_int", legacy_get_int, data);
+  FIELD_BENCH ("inline get_int", get_int, data);
+  FIELD_BENCH ("legacy get_float", legacy_get_float, data);
+  FIELD_BENCH ("inline get_float", get_float, data);
+  FIELD_BENCH ("legacy get_double", legacy_get_double, data);
+  FIELD_BENCH ("inline get_double", get_double, data);
+
+  t0 = now_ns ();
+  for (k = 0; k < npings; k++)
+    ping_legacy (data, nsamp, (short) -(k % 8), out_a);
+  t_old = (now_ns () - t0) / npings;
+
+  t0 = now_ns ();
+  for (k = 0; k < npings; k++)
+    ping_inline (data, nsamp, (short) -(k % 8), out_b);
+  t_new = (now_ns () - t0) / npings;
+
+  fprintf (stdout, "\nAnalytic ping decode (%d samples, %d pings)\n",
+	   nsamp, npings);
+  fprintf (stdout, "  %-20s %10.1f us/ping\n", "legacy", t_old / 1e3);
+  fprintf (stdout, "  %-20s %10.1f us/ping\n", "inline", t_new / 1e3);
+  fprintf (stdout, "  %-20s %10.1fx\n", "speedup", t_old / t_new);
+
+  if (memcmp (out_a, out_b, (size_t) nsamp * sizeof (float)) != 0)
+    {
+      fprintf (stdout, "legacy and inline decode differ\n");
+      exit (EXIT_FAILURE);
+    }
+
+  fprintf (stdout, "\nint16 (uint16) -> float trace kernels (%d samples, %d pings)\n",
+	   nsamp, npings);
+  if (bench_kernel ("scalar", data, nsamp, npings, out_a, out_b) +
+      bench_kernel ("sse2", data, nsamp, npings, out_a, out_b) +
+      bench_kernel ("avx2", data, nsamp, npings, out_a, out_b) +
+      bench_kernel ("avx512", data, nsamp, npings, out_a, out_b))
+    exit (EXIT_FAILURE);
+
+  /* reference for the last timed ping of each envelope kernel */
+  ping_inline (data, nsamp, (short) -((npings - 1) % 8), out_c);
+  fprintf (stdout, "\nAnalytic envelope kernels (%d samples, %d pings)\n",
+	   nsamp, npings);
+  if (bench_envelope ("scalar", data, nsamp, npings, out_c, out_a, out_b) +
+      bench_envelope ("sse2", data, nsamp, npings, out_c, out_a, out_b) +
+      bench_envelope ("avx2", data, nsamp, npings, out_c, out_a, out_b) +
+      bench_envelope ("avx512", data, nsamp, npings, out_c, out_a, out_b))
+    exit (EXIT_FAILURE);
+
+  conv_select ("scalar");
+  conv_i16_f32 (data, 1, nsamp, -4, 0, out_c);
+  fprintf (stdout, "\nStatic correction time shift (%d samples, %d pings)\n",
+	   nsamp, npings);
+  if (bench_shift ("scalar", out_c, nsamp, npings, out_a, out_b) +
+      bench_shift ("sse2", out_c, nsamp, npings, out_a, out_b) +
+      bench_shift ("avx2", out_c, nsamp, npings, out_a, out_b) +
+      bench_shift ("avx512", out_c, nsamp, npings, out_a, out_b))
+    exit (EXIT_FAILURE);
+
+  fprintf (stdout, "\nWindow and decimation (%d samples, %d pings)\n",
+	   nsamp, npings);
+  if (bench_decim ("scalar", out_c, nsamp, npings, out_a, out_b) +
+      bench_decim ("sse2", out_c, nsamp, npings, out_a, out_b) +
+      bench_decim ("avx2", out_c, nsamp, npings, out_a, out_b) +
+      bench_decim ("avx512", out_c, nsamp, npings, out_a, out_b))
+    exit (EXIT_FAILURE);
+
+  /*
+   * Pack test trace: the converted samples at all scales, with zeros,
+   * denormals, infinities and values past every integer range mixed in
+   */
+
+  for (i = 0; i < nsamp; i++)
+    out_c[i] = ldexpf (out_c[i], i % 41 - 20);
+  for (i = 0; i + 7 < nsamp; i += 997)
+    {
+      out_c[i] = 0.0f;
+      out_c[i + 1] = -0.0f;
+      out_c[i + 2] = 1e-40f;
+      out_c[i + 3] = (i & 1) ? INFINITY : -INFINITY;
+      out_c[i + 4] = 3e9f;
+      out_c[i + 5] = -3e9f;
+      out_c[i + 6] = 2147483648.0f;
+    }
+  fprintf (stdout, "\nSEG Y sample formats (%d samples, %d pings)\n",
+	   nsamp, npings);
+  if (bench_pack ("scalar", out_c, data, nsamp, npings, out_a, out_b) +
+      bench_pack ("sse2", out_c, data, nsamp, npings, out_a, out_b) +
+      bench_pack ("avx2", out_c, data, nsamp, npings, out_a, out_b) +
+      bench_pack ("avx512", out_c, data, nsamp, npings, out_a, out_b))
+    exit (EXIT_FAILURE);
+
+  conv_init ();
+  if (file != NULL && bench_file (file, conv, tmpdir))
+    exit (EXIT_FAILURE);
+  free (data);
+  free (out_a);
+  free (out_b);
+  free (out_c);
+  exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,1702 @@
+/*
+ * jsfconv.c
+ *
+ * int16 (and uint16) -> IEEE float trace conversion with run time CPU
+ * dispatch.
+ *
+ * ldexpf (x, w) of an int16 is exact, and so is x * 2^w as long as the
+ * scale and the product stay normal floats.  The kernels multiply by a
+ * precomputed 2^weight for |weight| <= WEIGHT_LIMIT and fall back to
+ * ldexpf outside that range, so all variants give the same bits.
+ *
+ * The envelope kernels use pmaddwd on the interleaved (re, im) int16
+ * pairs, which squares and sums each pair into an exact 32 bit integer
+ * in one instruction.  The only sum that does not fit a signed int is
+ * (-32768)^2 * 2 = 2^31; it converts to -2^31 and is fixed up with an
+ * absolute value.  sqrt (S * 2^2w) = sqrt (S) * 2^w exactly, so the
+ * weight is applied once after the square root.
+ *
+ * The time shift kernels compute each output as the same two products
+ * and one sum in every variant, so they agree bit for bit too, and so
+ * do the decimation kernels, summing the same taps in the same order.
+ *
+ * The sample format kernels (IBM float, int32, int16, int8 and the
+ * int16 passthrough) are integer or exactly rounded operations, so
+ * they agree too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "byteio.h"
+#include "jsfconv.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#define CONV_X86 1
+#include <immintrin.h>
+#else
+#define CONV_X86 0
+#endif
+
+#define WEIGHT_LIMIT 100
+
+static void
+conv_i16_scalar (const unsigned char *in, int stride, int nsamp, int weight,
+		 int swap, float *out)
+{
+  int i;
+  float scale;
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      for (i = 0; i < nsamp; i++)
+	{
+	  out[i] = ldexpf ((float) get_short (in, 2 * i * stride), weight);
+	  if (swap)
+	    out[i] = floatFlip (&out[i]);
+	}
+      return;
+    }
+
+  scale = ldexpf (1.0f, weight);
+  for (i = 0; i < nsamp; i++)
+    {
+      out[i] = (float) get_short (in, 2 * i * stride) * scale;
+      if (swap)
+	out[i] = floatFlip (&out[i]);
+    }
+}
+
+static void
+conv_u16_scalar (const unsigned char *in, int stride, int nsamp, int weight,
+		 int swap, float *out)
+{
+  int i;
+  float scale;
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      for (i = 0; i < nsamp; i++)
+	{
+	  out[i] = ldexpf ((float) ld_le16 (in + 2 * i * stride), weight);
+	  if (swap)
+	    out[i] = floatFlip (&out[i]);
+	}
+      return;
+    }
+
+  scale = ldexpf (1.0f, weight);
+  for (i = 0; i < nsamp; i++)
+    {
+      out[i] = (float) ld_le16 (in + 2 * i * stride) * scale;
+      if (swap)
+	out[i] = floatFlip (&out[i]);
+    }
+}
+
+/*
+ * Envelope of the analytic samples the way main() used to do it, for
+ * weights outside the exact range.
+ */
+
+static float
+env_ldexp (int re, int im, int weight)
+{
+  return (float) sqrt (ldexp ((double) re, weight) *
+		       ldexp ((double) re, weight) +
+		       ldexp ((double) im, weight) *
+		       ldexp ((double) im, weight));
+}
+
+static void
+conv_env_scalar (const unsigned char *in, int nsamp, int weight, int swap,
+		 int precise, float *out)
+{
+  int i, re, im;
+  uint32_t sum;
+  float scale;
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      for (i = 0; i < nsamp; i++)
+	{
+	  out[i] = env_ldexp (get_short (in, 4 * i), get_short (in, 4 * i + 2),
+			      weight);
+	  if (swap)
+	    out[i] = floatFlip (&out[i]);
+	}
+      return;
+    }
+
+  scale = ldexpf (1.0f, weight);
+  for (i = 0; i < nsamp; i++)
+    {
+      re = get_short (in, 4 * i);
+      im = get_short (in, 4 * i + 2);
+      sum = (uint32_t) (re * re) + (uint32_t) (im * im);
+      if (precise)
+	out[i] = (float) sqrt ((double) sum) * scale;
+      else
+	out[i] = sqrtf ((float) sum) * scale;
+      if (swap)
+	out[i] = floatFlip (&out[i]);
+    }
+}
+
+/*
+ * Time shift: out[i] = in(i - shift) by linear interpolation between the
+ * two samples either side, zero where that falls outside the trace.
+ * With n = floor (shift) and a = shift - n,
+ *
+ *   out[i] = (1 - a) * in[i - n] + a * in[i - n - 1]
+ *
+ * shift_range() does outputs from .. to - 1 of it one at a time; the
+ * vector kernels do the run where both inputs are inside the trace and
+ * leave both ends to it.  gcc would fuse the multiply and add into an
+ * FMA where the target has one (AVX-512), rounding differently, so the
+ * shift kernels are built without contraction.
+ */
+
+#define NO_FMA __attribute__ ((optimize ("fp-contract=off")))
+
+NO_FMA static void
+shift_range (const float *in, int nsamp, int n, float a, int swap,
+	     float *out, int from, int to)
+{
+  int i, j;
+  float x0, x1;
+
+  for (i = from; i < to; i++)
+    {
+      j = i - n;
+      x0 = j >= 0 && j < nsamp ? in[j] : 0.0f;
+      x1 = j >= 1 && j <= nsamp ? in[j - 1] : 0.0f;
+      out[i] = (1.0f - a) * x0 + a * x1;
+      if (swap)
+	out[i] = floatFlip (&out[i]);
+    }
+}
+
+/*
+ * Outputs lo .. hi - 1 have both inputs inside the trace.  Returns 0 if
+ * the shift takes the whole trace out of it, and zeroes out.
+ */
+
+static int
+shift_bounds (int nsamp, float shift, float *out, int *n, float *a,
+	      int *lo, int *hi)
+{
+  if (!(shift > -nsamp && shift < nsamp))
+    {
+      memset (out, 0, (size_t) nsamp * sizeof (float));
+      return 0;
+    }
+  *n = (int) floorf (shift);
+  *a = shift - *n;
+  *lo = *n + 1 > 0 ? *n + 1 : 0;
+  *hi = *n < 0 ? nsamp + *n : nsamp;
+  if (*lo > *hi)
+    *lo = *hi;
+  return 1;
+}
+
+NO_FMA static void
+shift_scalar (const float *in, int nsamp, float shift, int swap, float *out)
+{
+  int n, lo, hi;
+  float a;
+
+  if (shift_bounds (nsamp, shift, out, &n, &a, &lo, &hi))
+    shift_range (in, nsamp, n, a, swap, out, 0, nsamp);
+}
+
+/*
+ * Decimation: out[i] is the FIR filter h of ntaps (odd) taps centred on
+ * input sample first + i * factor,
+ *
+ *   out[i] = h[0] * x[c - half] + ... + h[ntaps - 1] * x[c + half]
+ *
+ * with c = first + i * factor, half = ntaps / 2 and x zero outside the
+ * nin input samples.  The sum is taken in tap order in every variant;
+ * the vector kernels do one output per lane (the taps of a lane are
+ * factor samples apart from the next lane's, gathered) over the run of
+ * outputs whose taps are all inside, decim_range() the rest.
+ */
+
+NO_FMA static void
+decim_range (const float *in, int nin, int first, int factor,
+	     const float *h, int ntaps, int swap, float *out, int from,
+	     int to)
+{
+  int i, j, k;
+  float acc;
+
+  for (i = from; i < to; i++)
+    {
+      acc = 0.0f;
+      j = first + i * factor - ntaps / 2;
+      for (k = 0; k < ntaps; k++, j++)
+	acc += h[k] * (j >= 0 && j < nin ? in[j] : 0.0f);
+      out[i] = acc;
+      if (swap)
+	out[i] = floatFlip (&out[i]);
+    }
+}
+
+/*
+ * Outputs lo .. hi - 1 of nout have all their taps inside the input
+ */
+
+static void
+decim_bounds (int nin, int first, int factor, int ntaps, int nout, int *lo,
+	      int *hi)
+{
+  int a = ntaps / 2 - first;	/* first * factor >= this */
+  int b = nin - 1 - ntaps / 2 - first;	/* last * factor <= this */
+
+  *lo = a <= 0 ? 0 : (a + factor - 1) / factor;
+  *hi = b < 0 ? 0 : b / factor + 1;
+  if (*hi > nout)
+    *hi = nout;
+  if (*lo > *hi)
+    *lo = *hi;
+}
+
+NO_FMA static void
+decim_scalar (const float *in, int nin, int first, int factor,
+	      const float *h, int ntaps, int swap, int nout, float *out)
+{
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, 0, nout);
+}
+
+/*
+ * Output sample formats other than IEEE float.  Each packs host order
+ * floats into SEG Y samples, byte swapped when swap is set, and may pack
+ * in place (out == in): every variant reads a block before it writes
+ * its narrower (or equal) result to the front of it.
+ *
+ * Integers are in[i] * 2^weight rounded to nearest (even on ties, as
+ * lrintf and cvtps2dq both do in the default rounding mode), saturated
+ * to the range of the type.  The clamp is done on the float, so an out
+ * of range value never reaches the conversion; 2147483520 is the largest
+ * float below 2^31.
+ */
+
+#define I32_MAX_F	2147483520.0f
+#define I32_MIN_F	-2147483648.0f
+
+static void
+pack_i32_scalar (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  float scale = ldexpf (1.0f, weight), v;
+  int32_t x;
+  int i;
+
+  for (i = 0; i < nsamp; i++)
+    {
+      v = in[i] * scale;
+      v = v > I32_MAX_F ? I32_MAX_F : v < I32_MIN_F ? I32_MIN_F : v;
+      x = (int32_t) lrintf (v);
+      if (swap)
+	x = swap_int32 (x);
+      memcpy (o + 4 * i, &x, 4);
+    }
+}
+
+static void
+pack_i16_scalar (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  float scale = ldexpf (1.0f, weight), v;
+  int16_t x;
+  int i;
+
+  for (i = 0; i < nsamp; i++)
+    {
+      v = in[i] * scale;
+      v = v > 32767.0f ? 32767.0f : v < -32768.0f ? -32768.0f : v;
+      x = (int16_t) lrintf (v);
+      if (swap)
+	x = swap_int16 (x);
+      memcpy (o + 2 * i, &x, 2);
+    }
+}
+
+static void
+pack_i8_scalar (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  float scale = ldexpf (1.0f, weight), v;
+  int i;
+
+  (void) swap;
+  for (i = 0; i < nsamp; i++)
+    {
+      v = in[i] * scale;
+      v = v > 127.0f ? 127.0f : v < -128.0f ? -128.0f : v;
+      o[i] = (unsigned char) (int8_t) lrintf (v);
+    }
+}
+
+/*
+ * IEEE to IBM System/360 single precision, truncating, as SU and most
+ * SEG Y writers do.  An IEEE float is 1.f * 2^(e - 127) = 0.1f * 2^t
+ * with t = e - 126; IBM wants a power of 16, so the 24 bit fraction is
+ * shifted right by (-t) & 3 and the exponent becomes (t + that) / 4 + 64.
+ * Every normal float fits.  Zeros and denormals become 0, infinities
+ * and NaNs the largest IBM value of their sign.
+ */
+
+static inline uint32_t
+ibm_of (uint32_t f)
+{
+  uint32_t sign = f & 0x80000000u, frac;
+  int e = (int) ((f >> 23) & 0xff), t, s;
+
+  if (e == 0)
+    return 0;
+  if (e == 255)
+    return sign | 0x7fffffffu;
+  frac = (f & 0x007fffffu) | 0x00800000u;
+  t = e - 126;
+  s = -t & 3;
+  return sign | (uint32_t) (((t + s) >> 2) + 64) << 24 | frac >> s;
+}
+
+static void
+pack_ibm_scalar (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  uint32_t f;
+  int i;
+
+  (void) weight;
+  for (i = 0; i < nsamp; i++)
+    {
+      memcpy (&f, in + i, 4);
+      f = ibm_of (f);
+      if (swap)
+	f = swap_uint32 (f);
+      memcpy (o + 4 * i, &f, 4);
+    }
+}
+
+/*
+ * Format 3 passthrough: the JSF int16 samples copied as they are, byte
+ * swapped when swap is set, every stride'th one
+ */
+
+static void
+copy_i16_scalar (const unsigned char *in, int stride, int nsamp, int swap,
+		 void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  int16_t x;
+  int i;
+
+  for (i = 0; i < nsamp; i++)
+    {
+      x = get_short (in, 2 * i * stride);
+      if (swap)
+	x = swap_int16 (x);
+      memcpy (o + 2 * i, &x, 2);
+    }
+}
+
+static float
+peak_scalar (const float *in, int nsamp)
+{
+  float m = 0.0f, v;
+  int i;
+
+  for (i = 0; i < nsamp; i++)
+    {
+      v = fabsf (in[i]);
+      m = v > m ? v : m;
+    }
+  return m;
+}
+
+#if CONV_X86
+
+/*
+ * Vector kernels.  Each converts the largest multiple of its width and
+ * passes the tail to the scalar kernel.
+ */
+
+__attribute__ ((target ("sse2")))
+static void
+conv_i16_sse2 (const unsigned char *in, int stride, int nsamp, int weight,
+	       int swap, float *out)
+{
+  int i = 0;
+  __m128 scale;
+  __m128i lo, hi, v, mask = _mm_set1_epi32 (0x00FF00FF);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_i16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm_set1_ps (ldexpf (1.0f, weight));
+
+#define SSE2_STORE(dst, iv)						\
+  do {									\
+    __m128i f = _mm_castps_si128 (_mm_mul_ps (_mm_cvtepi32_ps (iv), scale)); \
+    if (swap)								\
+      {									\
+	f = _mm_or_si128 (_mm_slli_epi32 (f, 16), _mm_srli_epi32 (f, 16)); \
+	f = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (f, mask), 8),	\
+			  _mm_and_si128 (_mm_srli_epi32 (f, 8), mask));	\
+      }									\
+    _mm_storeu_si128 ((__m128i *) (dst), f);				\
+  } while (0)
+
+  if (stride == 1)
+    {
+      for (; i + 8 <= nsamp; i += 8)
+	{
+	  v = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+	  lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+	  hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+	  SSE2_STORE (out + i, lo);
+	  SSE2_STORE (out + i + 4, hi);
+	}
+    }
+  else if (stride == 2)
+    {
+      for (; i + 4 <= nsamp; i += 4)
+	{
+	  v = _mm_loadu_si128 ((const __m128i *) (in + 4 * i));
+	  v = _mm_srai_epi32 (_mm_slli_epi32 (v, 16), 16);
+	  SSE2_STORE (out + i, v);
+	}
+    }
+#undef SSE2_STORE
+
+  conv_i16_scalar (in + 2 * i * stride, stride, nsamp - i, weight, swap,
+		   out + i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+conv_i16_avx2 (const unsigned char *in, int stride, int nsamp, int weight,
+	       int swap, float *out)
+{
+  int i = 0;
+  __m256 scale;
+  __m256i v, f;
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_i16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 8 <= nsamp; i += 8)
+    {
+      if (stride == 1)
+	v = _mm256_cvtepi16_epi32 (_mm_loadu_si128
+				   ((const __m128i *) (in + 2 * i)));
+      else if (stride == 2)
+	v = _mm256_srai_epi32 (_mm256_slli_epi32
+			       (_mm256_loadu_si256
+				((const __m256i *) (in + 4 * i)), 16), 16);
+      else
+	break;
+      f = _mm256_castps_si256 (_mm256_mul_ps (_mm256_cvtepi32_ps (v),
+					      scale));
+      if (swap)
+	f = _mm256_shuffle_epi8 (f, bswap);
+      _mm256_storeu_si256 ((__m256i *) (out + i), f);
+    }
+
+  conv_i16_scalar (in + 2 * i * stride, stride, nsamp - i, weight, swap,
+		   out + i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+conv_i16_avx512 (const unsigned char *in, int stride, int nsamp, int weight,
+		 int swap, float *out)
+{
+  int i = 0;
+  __m512 scale;
+  __m512i v, f;
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_i16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 16 <= nsamp; i += 16)
+    {
+      if (stride == 1)
+	v = _mm512_cvtepi16_epi32 (_mm256_loadu_si256
+				   ((const __m256i *) (in + 2 * i)));
+      else if (stride == 2)
+	v = _mm512_srai_epi32 (_mm512_slli_epi32
+			       (_mm512_loadu_si512 (in + 4 * i), 16), 16);
+      else
+	break;
+      f = _mm512_castps_si512 (_mm512_mul_ps (_mm512_cvtepi32_ps (v),
+					      scale));
+      if (swap)
+	f = _mm512_shuffle_epi8 (f, bswap);
+      _mm512_storeu_si512 (out + i, f);
+    }
+
+  conv_i16_scalar (in + 2 * i * stride, stride, nsamp - i, weight, swap,
+		   out + i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+conv_u16_sse2 (const unsigned char *in, int stride, int nsamp, int weight,
+	       int swap, float *out)
+{
+  int i = 0;
+  __m128 scale;
+  __m128i v, f, zero = _mm_setzero_si128 (), mask = _mm_set1_epi32 (0x00FF00FF);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT || stride != 1)
+    {
+      conv_u16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 4 <= nsamp; i += 4)
+    {
+      v = _mm_unpacklo_epi16 (_mm_loadl_epi64 ((const __m128i *) (in + 2 * i)),
+			      zero);
+      f = _mm_castps_si128 (_mm_mul_ps (_mm_cvtepi32_ps (v), scale));
+      if (swap)
+	{
+	  f = _mm_or_si128 (_mm_slli_epi32 (f, 16), _mm_srli_epi32 (f, 16));
+	  f = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (f, mask), 8),
+			    _mm_and_si128 (_mm_srli_epi32 (f, 8), mask));
+	}
+      _mm_storeu_si128 ((__m128i *) (out + i), f);
+    }
+
+  conv_u16_scalar (in + 2 * i, 1, nsamp - i, weight, swap, out + i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+conv_u16_avx2 (const unsigned char *in, int stride, int nsamp, int weight,
+	       int swap, float *out)
+{
+  int i = 0;
+  __m256 scale;
+  __m256i v, f;
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT || stride != 1)
+    {
+      conv_u16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 8 <= nsamp; i += 8)
+    {
+      v = _mm256_cvtepu16_epi32 (_mm_loadu_si128
+				 ((const __m128i *) (in + 2 * i)));
+      f = _mm256_castps_si256 (_mm256_mul_ps (_mm256_cvtepi32_ps (v),
+					      scale));
+      if (swap)
+	f = _mm256_shuffle_epi8 (f, bswap);
+      _mm256_storeu_si256 ((__m256i *) (out + i), f);
+    }
+
+  conv_u16_scalar (in + 2 * i, 1, nsamp - i, weight, swap, out + i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+conv_u16_avx512 (const unsigned char *in, int stride, int nsamp, int weight,
+		 int swap, float *out)
+{
+  int i = 0;
+  __m512 scale;
+  __m512i v, f;
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT || stride != 1)
+    {
+      conv_u16_scalar (in, stride, nsamp, weight, swap, out);
+      return;
+    }
+  scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 16 <= nsamp; i += 16)
+    {
+      v = _mm512_cvtepu16_epi32 (_mm256_loadu_si256
+				 ((const __m256i *) (in + 2 * i)));
+      f = _mm512_castps_si512 (_mm512_mul_ps (_mm512_cvtepi32_ps (v),
+					      scale));
+      if (swap)
+	f = _mm512_shuffle_epi8 (f, bswap);
+      _mm512_storeu_si512 (out + i, f);
+    }
+
+  conv_u16_scalar (in + 2 * i, 1, nsamp - i, weight, swap, out + i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+conv_env_sse2 (const unsigned char *in, int nsamp, int weight, int swap,
+	       int precise, float *out)
+{
+  int i = 0;
+  __m128 scale, f;
+  __m128d lo, hi;
+  __m128i v, r, mask = _mm_set1_epi32 (0x00FF00FF);
+  const __m128 absmask = _mm_castsi128_ps (_mm_set1_epi32 (0x7FFFFFFF));
+  const __m128d absmaskd =
+    _mm_castsi128_pd (_mm_set1_epi64x (0x7FFFFFFFFFFFFFFFLL));
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_env_scalar (in, nsamp, weight, swap, precise, out);
+      return;
+    }
+  scale = _mm_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 4 <= nsamp; i += 4)
+    {
+      v = _mm_loadu_si128 ((const __m128i *) (in + 4 * i));
+      v = _mm_madd_epi16 (v, v);
+      if (precise)
+	{
+	  lo = _mm_and_pd (_mm_cvtepi32_pd (v), absmaskd);
+	  hi = _mm_and_pd (_mm_cvtepi32_pd (_mm_unpackhi_epi64 (v, v)),
+			   absmaskd);
+	  f = _mm_movelh_ps (_mm_cvtpd_ps (_mm_sqrt_pd (lo)),
+			     _mm_cvtpd_ps (_mm_sqrt_pd (hi)));
+	}
+      else
+	f = _mm_sqrt_ps (_mm_and_ps (_mm_cvtepi32_ps (v), absmask));
+      r = _mm_castps_si128 (_mm_mul_ps (f, scale));
+      if (swap)
+	{
+	  r = _mm_or_si128 (_mm_slli_epi32 (r, 16), _mm_srli_epi32 (r, 16));
+	  r = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (r, mask), 8),
+			    _mm_and_si128 (_mm_srli_epi32 (r, 8), mask));
+	}
+      _mm_storeu_si128 ((__m128i *) (out + i), r);
+    }
+
+  conv_env_scalar (in + 4 * i, nsamp - i, weight, swap, precise, out + i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+conv_env_avx2 (const unsigned char *in, int nsamp, int weight, int swap,
+	       int precise, float *out)
+{
+  int i = 0;
+  __m256 scale, f;
+  __m256i v, r;
+  const __m256 absmask =
+    _mm256_castsi256_ps (_mm256_set1_epi32 (0x7FFFFFFF));
+  const __m256d absmaskd =
+    _mm256_castsi256_pd (_mm256_set1_epi64x (0x7FFFFFFFFFFFFFFFLL));
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_env_scalar (in, nsamp, weight, swap, precise, out);
+      return;
+    }
+  scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 8 <= nsamp; i += 8)
+    {
+      v = _mm256_loadu_si256 ((const __m256i *) (in + 4 * i));
+      v = _mm256_madd_epi16 (v, v);
+      if (precise)
+	{
+	  __m256d lo = _mm256_cvtepi32_pd (_mm256_castsi256_si128 (v));
+	  __m256d hi = _mm256_cvtepi32_pd (_mm256_extracti128_si256 (v, 1));
+	  lo = _mm256_sqrt_pd (_mm256_and_pd (lo, absmaskd));
+	  hi = _mm256_sqrt_pd (_mm256_and_pd (hi, absmaskd));
+	  f = _mm256_insertf128_ps (_mm256_castps128_ps256
+				    (_mm256_cvtpd_ps (lo)),
+				    _mm256_cvtpd_ps (hi), 1);
+	}
+      else
+	f = _mm256_sqrt_ps (_mm256_and_ps (_mm256_cvtepi32_ps (v), absmask));
+      r = _mm256_castps_si256 (_mm256_mul_ps (f, scale));
+      if (swap)
+	r = _mm256_shuffle_epi8 (r, bswap);
+      _mm256_storeu_si256 ((__m256i *) (out + i), r);
+    }
+
+  conv_env_scalar (in + 4 * i, nsamp - i, weight, swap, precise, out + i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+conv_env_avx512 (const unsigned char *in, int nsamp, int weight, int swap,
+		 int precise, float *out)
+{
+  int i = 0;
+  __m512 scale, f;
+  __m512i v, r;
+  const __m512i absmask = _mm512_set1_epi32 (0x7FFFFFFF);
+  const __m512i absmaskd = _mm512_set1_epi64 (0x7FFFFFFFFFFFFFFFLL);
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+
+  if (weight < -WEIGHT_LIMIT || weight > WEIGHT_LIMIT)
+    {
+      conv_env_scalar (in, nsamp, weight, swap, precise, out);
+      return;
+    }
+  scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+
+  for (; i + 16 <= nsamp; i += 16)
+    {
+      v = _mm512_loadu_si512 (in + 4 * i);
+      v = _mm512_madd_epi16 (v, v);
+      if (precise)
+	{
+	  __m512d lo = _mm512_cvtepi32_pd (_mm512_castsi512_si256 (v));
+	  __m512d hi = _mm512_cvtepi32_pd (_mm512_extracti64x4_epi64 (v, 1));
+	  lo = _mm512_castsi512_pd (_mm512_and_si512 (_mm512_castpd_si512 (lo),
+						      absmaskd));
+	  hi = _mm512_castsi512_pd (_mm512_and_si512 (_mm512_castpd_si512 (hi),
+						      absmaskd));
+	  f = _mm512_castpd_ps (_mm512_insertf64x4
+				(_mm512_castps_pd
+				 (_mm512_castps256_ps512
+				  (_mm512_cvtpd_ps (_mm512_sqrt_pd (lo)))),
+				 _mm256_castps_pd (_mm512_cvtpd_ps
+						   (_mm512_sqrt_pd (hi))), 1));
+	}
+      else
+	f = _mm512_sqrt_ps (_mm512_castsi512_ps
+			    (_mm512_and_si512 (_mm512_castps_si512
+					       (_mm512_cvtepi32_ps (v)),
+					       absmask)));
+      r = _mm512_castps_si512 (_mm512_mul_ps (f, scale));
+      if (swap)
+	r = _mm512_shuffle_epi8 (r, bswap);
+      _mm512_storeu_si512 (out + i, r);
+    }
+
+  conv_env_scalar (in + 4 * i, nsamp - i, weight, swap, precise, out + i);
+}
+
+__attribute__ ((target ("sse2"))) NO_FMA
+static void
+shift_sse2 (const float *in, int nsamp, float shift, int swap, float *out)
+{
+  int n, lo, hi, i;
+  float a;
+  __m128 w0, w1;
+  __m128i f, mask = _mm_set1_epi32 (0x00FF00FF);
+
+  if (!shift_bounds (nsamp, shift, out, &n, &a, &lo, &hi))
+    return;
+  shift_range (in, nsamp, n, a, swap, out, 0, lo);
+  w0 = _mm_set1_ps (1.0f - a);
+  w1 = _mm_set1_ps (a);
+  for (i = lo; i + 4 <= hi; i += 4)
+    {
+      f = _mm_castps_si128 (_mm_add_ps
+			    (_mm_mul_ps (w0, _mm_loadu_ps (in + i - n)),
+			     _mm_mul_ps (w1, _mm_loadu_ps (in + i - n - 1))));
+      if (swap)
+	{
+	  f = _mm_or_si128 (_mm_slli_epi32 (f, 16), _mm_srli_epi32 (f, 16));
+	  f = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (f, mask), 8),
+			    _mm_and_si128 (_mm_srli_epi32 (f, 8), mask));
+	}
+      _mm_storeu_si128 ((__m128i *) (out + i), f);
+    }
+  shift_range (in, nsamp, n, a, swap, out, i, nsamp);
+}
+
+__attribute__ ((target ("avx2"))) NO_FMA
+static void
+shift_avx2 (const float *in, int nsamp, float shift, int swap, float *out)
+{
+  int n, lo, hi, i;
+  float a;
+  __m256 w0, w1;
+  __m256i f;
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+
+  if (!shift_bounds (nsamp, shift, out, &n, &a, &lo, &hi))
+    return;
+  shift_range (in, nsamp, n, a, swap, out, 0, lo);
+  w0 = _mm256_set1_ps (1.0f - a);
+  w1 = _mm256_set1_ps (a);
+  for (i = lo; i + 8 <= hi; i += 8)
+    {
+      f = _mm256_castps_si256 (_mm256_add_ps
+			       (_mm256_mul_ps (w0, _mm256_loadu_ps (in + i - n)),
+				_mm256_mul_ps (w1,
+					       _mm256_loadu_ps (in + i - n - 1))));
+      if (swap)
+	f = _mm256_shuffle_epi8 (f, bswap);
+      _mm256_storeu_si256 ((__m256i *) (out + i), f);
+    }
+  shift_range (in, nsamp, n, a, swap, out, i, nsamp);
+}
+
+__attribute__ ((target ("avx512f,avx512bw"))) NO_FMA
+static void
+shift_avx512 (const float *in, int nsamp, float shift, int swap, float *out)
+{
+  int n, lo, hi, i;
+  float a;
+  __m512 w0, w1;
+  __m512i f;
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+
+  if (!shift_bounds (nsamp, shift, out, &n, &a, &lo, &hi))
+    return;
+  shift_range (in, nsamp, n, a, swap, out, 0, lo);
+  w0 = _mm512_set1_ps (1.0f - a);
+  w1 = _mm512_set1_ps (a);
+  for (i = lo; i + 16 <= hi; i += 16)
+    {
+      f = _mm512_castps_si512 (_mm512_add_ps
+			       (_mm512_mul_ps (w0, _mm512_loadu_ps (in + i - n)),
+				_mm512_mul_ps (w1,
+					       _mm512_loadu_ps (in + i - n - 1))));
+      if (swap)
+	f = _mm512_shuffle_epi8 (f, bswap);
+      _mm512_storeu_si512 (out + i, f);
+    }
+  shift_range (in, nsamp, n, a, swap, out, i, nsamp);
+}
+
+
+__attribute__ ((target ("sse2"))) NO_FMA
+static void
+decim_sse2 (const float *in, int nin, int first, int factor,
+	    const float *h, int ntaps, int swap, int nout, float *out)
+{
+  int lo, hi, i, k;
+  const float *x;
+  __m128 acc, hk;
+  __m128i f, mask = _mm_set1_epi32 (0x00FF00FF);
+
+  decim_bounds (nin, first, factor, ntaps, nout, &lo, &hi);
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, 0, lo);
+  for (i = lo; i + 4 <= hi; i += 4)
+    {
+      acc = _mm_setzero_ps ();
+      x = in + first + i * factor - ntaps / 2;
+      for (k = 0; k < ntaps; k++, x++)
+	{
+	  hk = _mm_set1_ps (h[k]);
+	  acc = _mm_add_ps (acc, _mm_mul_ps (hk, _mm_setr_ps
+					     (x[0], x[factor], x[2 * factor],
+					      x[3 * factor])));
+	}
+      f = _mm_castps_si128 (acc);
+      if (swap)
+	{
+	  f = _mm_or_si128 (_mm_slli_epi32 (f, 16), _mm_srli_epi32 (f, 16));
+	  f = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (f, mask), 8),
+			    _mm_and_si128 (_mm_srli_epi32 (f, 8), mask));
+	}
+      _mm_storeu_si128 ((__m128i *) (out + i), f);
+    }
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, i, nout);
+}
+
+__attribute__ ((target ("avx2"))) NO_FMA
+static void
+decim_avx2 (const float *in, int nin, int first, int factor,
+	    const float *h, int ntaps, int swap, int nout, float *out)
+{
+  int lo, hi, i, k;
+  const float *x;
+  __m256 acc;
+  __m256i f, idx;
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+
+  decim_bounds (nin, first, factor, ntaps, nout, &lo, &hi);
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, 0, lo);
+  idx = _mm256_mullo_epi32 (_mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7),
+			    _mm256_set1_epi32 (factor));
+  for (i = lo; i + 8 <= hi; i += 8)
+    {
+      acc = _mm256_setzero_ps ();
+      x = in + first + i * factor - ntaps / 2;
+      for (k = 0; k < ntaps; k++, x++)
+	acc = _mm256_add_ps (acc, _mm256_mul_ps (_mm256_set1_ps (h[k]),
+						 _mm256_i32gather_ps (x, idx,
+								      4)));
+      f = _mm256_castps_si256 (acc);
+      if (swap)
+	f = _mm256_shuffle_epi8 (f, bswap);
+      _mm256_storeu_si256 ((__m256i *) (out + i), f);
+    }
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, i, nout);
+}
+
+__attribute__ ((target ("avx512f,avx512bw"))) NO_FMA
+static void
+decim_avx512 (const float *in, int nin, int first, int factor,
+	      const float *h, int ntaps, int swap, int nout, float *out)
+{
+  int lo, hi, i, k;
+  const float *x;
+  __m512 acc;
+  __m512i f, idx;
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+
+  decim_bounds (nin, first, factor, ntaps, nout, &lo, &hi);
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, 0, lo);
+  idx = _mm512_mullo_epi32 (_mm512_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+					       10, 11, 12, 13, 14, 15),
+			    _mm512_set1_epi32 (factor));
+  for (i = lo; i + 16 <= hi; i += 16)
+    {
+      acc = _mm512_setzero_ps ();
+      x = in + first + i * factor - ntaps / 2;
+      for (k = 0; k < ntaps; k++, x++)
+	acc = _mm512_add_ps (acc, _mm512_mul_ps (_mm512_set1_ps (h[k]),
+						 _mm512_i32gather_ps (idx, x,
+								      4)));
+      f = _mm512_castps_si512 (acc);
+      if (swap)
+	f = _mm512_shuffle_epi8 (f, bswap);
+      _mm512_storeu_si512 (out + i, f);
+    }
+  decim_range (in, nin, first, factor, h, ntaps, swap, out, i, nout);
+}
+
+/*
+ * Sample format kernels.  IBM packing works on the float bits: the
+ * fraction shift of 0 to 3 is two masked shifts with SSE2 and a per lane
+ * shift (vpsrlvd) with AVX2 and AVX-512.
+ */
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+bswap32_sse2 (__m128i f)
+{
+  const __m128i mask = _mm_set1_epi32 (0x00FF00FF);
+
+  f = _mm_or_si128 (_mm_slli_epi32 (f, 16), _mm_srli_epi32 (f, 16));
+  return _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (f, mask), 8),
+		       _mm_and_si128 (_mm_srli_epi32 (f, 8), mask));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+bswap16_sse2 (__m128i f)
+{
+  return _mm_or_si128 (_mm_slli_epi16 (f, 8), _mm_srli_epi16 (f, 8));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+cvt_sse2 (const float *in, __m128 scale, __m128 lo, __m128 hi)
+{
+  __m128 v = _mm_mul_ps (_mm_loadu_ps (in), scale);
+
+  return _mm_cvtps_epi32 (_mm_max_ps (_mm_min_ps (v, hi), lo));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+pack_i32_sse2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m128 scale = _mm_set1_ps (ldexpf (1.0f, weight));
+  const __m128 lo = _mm_set1_ps (I32_MIN_F), hi = _mm_set1_ps (I32_MAX_F);
+  __m128i x;
+  int i;
+
+  for (i = 0; i + 4 <= nsamp; i += 4)
+    {
+      x = cvt_sse2 (in + i, scale, lo, hi);
+      if (swap)
+	x = bswap32_sse2 (x);
+      _mm_storeu_si128 ((__m128i *) (o + 4 * i), x);
+    }
+  pack_i32_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+pack_i16_sse2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m128 scale = _mm_set1_ps (ldexpf (1.0f, weight));
+  const __m128 lo = _mm_set1_ps (-32768.0f), hi = _mm_set1_ps (32767.0f);
+  __m128i a, b, x;
+  int i;
+
+  for (i = 0; i + 8 <= nsamp; i += 8)
+    {
+      a = cvt_sse2 (in + i, scale, lo, hi);
+      b = cvt_sse2 (in + i + 4, scale, lo, hi);
+      x = _mm_packs_epi32 (a, b);
+      if (swap)
+	x = bswap16_sse2 (x);
+      _mm_storeu_si128 ((__m128i *) (o + 2 * i), x);
+    }
+  pack_i16_scalar (in + i, nsamp - i, weight, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+pack_i8_sse2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m128 scale = _mm_set1_ps (ldexpf (1.0f, weight));
+  const __m128 lo = _mm_set1_ps (-128.0f), hi = _mm_set1_ps (127.0f);
+  __m128i a, b, c, d;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      a = cvt_sse2 (in + i, scale, lo, hi);
+      b = cvt_sse2 (in + i + 4, scale, lo, hi);
+      c = cvt_sse2 (in + i + 8, scale, lo, hi);
+      d = cvt_sse2 (in + i + 12, scale, lo, hi);
+      _mm_storeu_si128 ((__m128i *) (o + i),
+			_mm_packs_epi16 (_mm_packs_epi32 (a, b),
+					 _mm_packs_epi32 (c, d)));
+    }
+  pack_i8_scalar (in + i, nsamp - i, weight, swap, o + i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+pack_ibm_sse2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m128i one = _mm_set1_epi32 (1), two = _mm_set1_epi32 (2);
+  const __m128i three = _mm_set1_epi32 (3);
+  const __m128i ff = _mm_set1_epi32 (0xff);
+  const __m128i signbit = _mm_set1_epi32 ((int) 0x80000000u);
+  const __m128i fmask = _mm_set1_epi32 (0x007fffff);
+  const __m128i hidden = _mm_set1_epi32 (0x00800000);
+  const __m128i big = _mm_set1_epi32 (0x7fffffff);
+  __m128i f, sign, e, frac, t, s, m, r, z, inf;
+  int i;
+
+  for (i = 0; i + 4 <= nsamp; i += 4)
+    {
+      f = _mm_loadu_si128 ((const __m128i *) (in + i));
+      sign = _mm_and_si128 (f, signbit);
+      e = _mm_and_si128 (_mm_srli_epi32 (f, 23), ff);
+      frac = _mm_or_si128 (_mm_and_si128 (f, fmask), hidden);
+      t = _mm_sub_epi32 (e, _mm_set1_epi32 (126));
+      s = _mm_and_si128 (_mm_sub_epi32 (_mm_setzero_si128 (), t), three);
+      m = _mm_cmpeq_epi32 (_mm_and_si128 (s, one), one);
+      frac = _mm_or_si128 (_mm_and_si128 (m, _mm_srli_epi32 (frac, 1)),
+			   _mm_andnot_si128 (m, frac));
+      m = _mm_cmpeq_epi32 (_mm_and_si128 (s, two), two);
+      frac = _mm_or_si128 (_mm_and_si128 (m, _mm_srli_epi32 (frac, 2)),
+			   _mm_andnot_si128 (m, frac));
+      r = _mm_add_epi32 (_mm_srai_epi32 (_mm_add_epi32 (t, s), 2),
+			 _mm_set1_epi32 (64));
+      r = _mm_or_si128 (sign, _mm_or_si128 (_mm_slli_epi32 (r, 24), frac));
+      z = _mm_cmpeq_epi32 (e, _mm_setzero_si128 ());
+      inf = _mm_cmpeq_epi32 (e, ff);
+      r = _mm_andnot_si128 (z, r);
+      r = _mm_or_si128 (_mm_andnot_si128 (inf, r),
+			_mm_and_si128 (inf, _mm_or_si128 (sign, big)));
+      if (swap)
+	r = bswap32_sse2 (r);
+      _mm_storeu_si128 ((__m128i *) (o + 4 * i), r);
+    }
+  pack_ibm_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+copy_i16_sse2 (const unsigned char *in, int stride, int nsamp, int swap,
+	       void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  __m128i a, b, x;
+  int i = 0;
+
+  if (stride == 1)
+    for (; i + 8 <= nsamp; i += 8)
+      {
+	x = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+	if (swap)
+	  x = bswap16_sse2 (x);
+	_mm_storeu_si128 ((__m128i *) (o + 2 * i), x);
+      }
+  else if (stride == 2)
+    for (; i + 8 <= nsamp; i += 8)
+      {
+	a = _mm_loadu_si128 ((const __m128i *) (in + 4 * i));
+	b = _mm_loadu_si128 ((const __m128i *) (in + 4 * i + 16));
+	a = _mm_srai_epi32 (_mm_slli_epi32 (a, 16), 16);
+	b = _mm_srai_epi32 (_mm_slli_epi32 (b, 16), 16);
+	x = _mm_packs_epi32 (a, b);
+	if (swap)
+	  x = bswap16_sse2 (x);
+	_mm_storeu_si128 ((__m128i *) (o + 2 * i), x);
+      }
+  copy_i16_scalar (in + 2 * i * stride, stride, nsamp - i, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("sse2")))
+static float
+peak_sse2 (const float *in, int nsamp)
+{
+  const __m128 abs = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+  __m128 m = _mm_setzero_ps ();
+  float lane[4], p;
+  int i, k;
+
+  for (i = 0; i + 4 <= nsamp; i += 4)
+    m = _mm_max_ps (_mm_and_ps (_mm_loadu_ps (in + i), abs), m);
+  _mm_storeu_ps (lane, m);
+  p = peak_scalar (in + i, nsamp - i);
+  for (k = 0; k < 4; k++)
+    p = lane[k] > p ? lane[k] : p;
+  return p;
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+cvt_avx2 (const float *in, __m256 scale, __m256 lo, __m256 hi)
+{
+  __m256 v = _mm256_mul_ps (_mm256_loadu_ps (in), scale);
+
+  return _mm256_cvtps_epi32 (_mm256_max_ps (_mm256_min_ps (v, hi), lo));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pack_i32_avx2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m256 scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+  const __m256 lo = _mm256_set1_ps (I32_MIN_F);
+  const __m256 hi = _mm256_set1_ps (I32_MAX_F);
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+  __m256i x;
+  int i;
+
+  for (i = 0; i + 8 <= nsamp; i += 8)
+    {
+      x = cvt_avx2 (in + i, scale, lo, hi);
+      if (swap)
+	x = _mm256_shuffle_epi8 (x, bswap);
+      _mm256_storeu_si256 ((__m256i *) (o + 4 * i), x);
+    }
+  pack_i32_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pack_i16_avx2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m256 scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+  const __m256 lo = _mm256_set1_ps (-32768.0f);
+  const __m256 hi = _mm256_set1_ps (32767.0f);
+  const __m256i bswap = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14,
+					  1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14);
+  __m256i x;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      x = _mm256_packs_epi32 (cvt_avx2 (in + i, scale, lo, hi),
+			      cvt_avx2 (in + i + 8, scale, lo, hi));
+      x = _mm256_permute4x64_epi64 (x, 0xD8);	/* packs works per lane */
+      if (swap)
+	x = _mm256_shuffle_epi8 (x, bswap);
+      _mm256_storeu_si256 ((__m256i *) (o + 2 * i), x);
+    }
+  pack_i16_scalar (in + i, nsamp - i, weight, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pack_i8_avx2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m256 scale = _mm256_set1_ps (ldexpf (1.0f, weight));
+  const __m256 lo = _mm256_set1_ps (-128.0f), hi = _mm256_set1_ps (127.0f);
+  __m256i x;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      x = _mm256_packs_epi32 (cvt_avx2 (in + i, scale, lo, hi),
+			      cvt_avx2 (in + i + 8, scale, lo, hi));
+      x = _mm256_permute4x64_epi64 (x, 0xD8);
+      _mm_storeu_si128 ((__m128i *) (o + i),
+			_mm_packs_epi16 (_mm256_castsi256_si128 (x),
+					 _mm256_extracti128_si256 (x, 1)));
+    }
+  pack_i8_scalar (in + i, nsamp - i, weight, swap, o + i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pack_ibm_avx2 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m256i ff = _mm256_set1_epi32 (0xff);
+  const __m256i signbit = _mm256_set1_epi32 ((int) 0x80000000u);
+  const __m256i big = _mm256_set1_epi32 (0x7fffffff);
+  const __m256i bswap = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12,
+					  3, 2, 1, 0, 7, 6, 5, 4,
+					  11, 10, 9, 8, 15, 14, 13, 12);
+  __m256i f, sign, e, frac, t, s, r;
+  int i;
+
+  for (i = 0; i + 8 <= nsamp; i += 8)
+    {
+      f = _mm256_loadu_si256 ((const __m256i *) (in + i));
+      sign = _mm256_and_si256 (f, signbit);
+      e = _mm256_and_si256 (_mm256_srli_epi32 (f, 23), ff);
+      frac = _mm256_or_si256 (_mm256_and_si256
+			      (f, _mm256_set1_epi32 (0x007fffff)),
+			      _mm256_set1_epi32 (0x00800000));
+      t = _mm256_sub_epi32 (e, _mm256_set1_epi32 (126));
+      s = _mm256_and_si256 (_mm256_sub_epi32 (_mm256_setzero_si256 (), t),
+			    _mm256_set1_epi32 (3));
+      r = _mm256_add_epi32 (_mm256_srai_epi32 (_mm256_add_epi32 (t, s), 2),
+			    _mm256_set1_epi32 (64));
+      r = _mm256_or_si256 (sign,
+			   _mm256_or_si256 (_mm256_slli_epi32 (r, 24),
+					    _mm256_srlv_epi32 (frac, s)));
+      r = _mm256_andnot_si256 (_mm256_cmpeq_epi32
+			       (e, _mm256_setzero_si256 ()), r);
+      r = _mm256_blendv_epi8 (r, _mm256_or_si256 (sign, big),
+			      _mm256_cmpeq_epi32 (e, ff));
+      if (swap)
+	r = _mm256_shuffle_epi8 (r, bswap);
+      _mm256_storeu_si256 ((__m256i *) (o + 4 * i), r);
+    }
+  pack_ibm_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+copy_i16_avx2 (const unsigned char *in, int stride, int nsamp, int swap,
+	       void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m256i bswap = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14,
+					  1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14);
+  __m256i a, b, x;
+  int i = 0;
+
+  for (; i + 16 <= nsamp; i += 16)
+    {
+      if (stride == 1)
+	x = _mm256_loadu_si256 ((const __m256i *) (in + 2 * i));
+      else if (stride == 2)
+	{
+	  a = _mm256_loadu_si256 ((const __m256i *) (in + 4 * i));
+	  b = _mm256_loadu_si256 ((const __m256i *) (in + 4 * i + 32));
+	  a = _mm256_srai_epi32 (_mm256_slli_epi32 (a, 16), 16);
+	  b = _mm256_srai_epi32 (_mm256_slli_epi32 (b, 16), 16);
+	  x = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a, b), 0xD8);
+	}
+      else
+	break;
+      if (swap)
+	x = _mm256_shuffle_epi8 (x, bswap);
+      _mm256_storeu_si256 ((__m256i *) (o + 2 * i), x);
+    }
+  copy_i16_scalar (in + 2 * i * stride, stride, nsamp - i, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("avx2")))
+static float
+peak_avx2 (const float *in, int nsamp)
+{
+  const __m256 abs = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7fffffff));
+  __m256 m = _mm256_setzero_ps ();
+  float lane[8], p;
+  int i, k;
+
+  for (i = 0; i + 8 <= nsamp; i += 8)
+    m = _mm256_max_ps (_mm256_and_ps (_mm256_loadu_ps (in + i), abs), m);
+  _mm256_storeu_ps (lane, m);
+  p = peak_scalar (in + i, nsamp - i);
+  for (k = 0; k < 8; k++)
+    p = lane[k] > p ? lane[k] : p;
+  return p;
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static inline __m512i
+cvt_avx512 (const float *in, __m512 scale, __m512 lo, __m512 hi)
+{
+  __m512 v = _mm512_mul_ps (_mm512_loadu_ps (in), scale);
+
+  return _mm512_cvtps_epi32 (_mm512_max_ps (_mm512_min_ps (v, hi), lo));
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+pack_i32_avx512 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m512 scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+  const __m512 lo = _mm512_set1_ps (I32_MIN_F);
+  const __m512 hi = _mm512_set1_ps (I32_MAX_F);
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+  __m512i x;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      x = cvt_avx512 (in + i, scale, lo, hi);
+      if (swap)
+	x = _mm512_shuffle_epi8 (x, bswap);
+      _mm512_storeu_si512 (o + 4 * i, x);
+    }
+  pack_i32_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+pack_i16_avx512 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m512 scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+  const __m512 lo = _mm512_set1_ps (-32768.0f);
+  const __m512 hi = _mm512_set1_ps (32767.0f);
+  const __m256i bswap = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14,
+					  1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14);
+  __m256i x;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      x = _mm512_cvtsepi32_epi16 (cvt_avx512 (in + i, scale, lo, hi));
+      if (swap)
+	x = _mm256_shuffle_epi8 (x, bswap);
+      _mm256_storeu_si256 ((__m256i *) (o + 2 * i), x);
+    }
+  pack_i16_scalar (in + i, nsamp - i, weight, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+pack_i8_avx512 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m512 scale = _mm512_set1_ps (ldexpf (1.0f, weight));
+  const __m512 lo = _mm512_set1_ps (-128.0f), hi = _mm512_set1_ps (127.0f);
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    _mm_storeu_si128 ((__m128i *) (o + i),
+		      _mm512_cvtsepi32_epi8 (cvt_avx512 (in + i, scale, lo,
+							 hi)));
+  pack_i8_scalar (in + i, nsamp - i, weight, swap, o + i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+pack_ibm_avx512 (const float *in, int nsamp, int weight, int swap, void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m512i ff = _mm512_set1_epi32 (0xff);
+  const __m512i bswap = _mm512_set4_epi32 (0x0C0D0E0F, 0x08090A0B,
+					   0x04050607, 0x00010203);
+  __m512i f, sign, e, frac, t, s, r;
+  __mmask16 z, inf;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    {
+      f = _mm512_loadu_si512 (in + i);
+      sign = _mm512_and_si512 (f, _mm512_set1_epi32 ((int) 0x80000000u));
+      e = _mm512_and_si512 (_mm512_srli_epi32 (f, 23), ff);
+      frac = _mm512_or_si512 (_mm512_and_si512
+			      (f, _mm512_set1_epi32 (0x007fffff)),
+			      _mm512_set1_epi32 (0x00800000));
+      t = _mm512_sub_epi32 (e, _mm512_set1_epi32 (126));
+      s = _mm512_and_si512 (_mm512_sub_epi32 (_mm512_setzero_si512 (), t),
+			    _mm512_set1_epi32 (3));
+      r = _mm512_add_epi32 (_mm512_srai_epi32 (_mm512_add_epi32 (t, s), 2),
+			    _mm512_set1_epi32 (64));
+      r = _mm512_or_si512 (sign,
+			   _mm512_or_si512 (_mm512_slli_epi32 (r, 24),
+					    _mm512_srlv_epi32 (frac, s)));
+      z = _mm512_cmpeq_epi32_mask (e, _mm512_setzero_si512 ());
+      inf = _mm512_cmpeq_epi32_mask (e, ff);
+      r = _mm512_mask_mov_epi32 (r, z, _mm512_setzero_si512 ());
+      r = _mm512_mask_mov_epi32 (r, inf,
+				 _mm512_or_si512 (sign,
+						  _mm512_set1_epi32
+						  (0x7fffffff)));
+      if (swap)
+	r = _mm512_shuffle_epi8 (r, bswap);
+      _mm512_storeu_si512 (o + 4 * i, r);
+    }
+  pack_ibm_scalar (in + i, nsamp - i, weight, swap, o + 4 * i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static void
+copy_i16_avx512 (const unsigned char *in, int stride, int nsamp, int swap,
+		 void *out)
+{
+  unsigned char *o = (unsigned char *) out;
+  const __m512i bswap = _mm512_set4_epi32 (0x0E0F0C0D, 0x0A0B0809,
+					   0x06070405, 0x02030001);
+  __m512i x;
+  __m256i y;
+  int i = 0;
+
+  if (stride == 1)
+    for (; i + 32 <= nsamp; i += 32)
+      {
+	x = _mm512_loadu_si512 (in + 2 * i);
+	if (swap)
+	  x = _mm512_shuffle_epi8 (x, bswap);
+	_mm512_storeu_si512 (o + 2 * i, x);
+      }
+  else if (stride == 2)
+    for (; i + 16 <= nsamp; i += 16)
+      {
+	y = _mm512_cvtepi32_epi16 (_mm512_loadu_si512 (in + 4 * i));
+	if (swap)
+	  y = _mm256_shuffle_epi8 (y, _mm512_castsi512_si256 (bswap));
+	_mm256_storeu_si256 ((__m256i *) (o + 2 * i), y);
+      }
+  copy_i16_scalar (in + 2 * i * stride, stride, nsamp - i, swap, o + 2 * i);
+}
+
+__attribute__ ((target ("avx512f,avx512bw")))
+static float
+peak_avx512 (const float *in, int nsamp)
+{
+  __m512 m = _mm512_setzero_ps ();
+  float p, q;
+  int i;
+
+  for (i = 0; i + 16 <= nsamp; i += 16)
+    m = _mm512_max_ps (_mm512_abs_ps (_mm512_loadu_ps (in + i)), m);
+  p = _mm512_reduce_max_ps (m);
+  q = peak_scalar (in + i, nsamp - i);
+  return q > p ? q : p;
+}
+
+#endif /* CONV_X86 */
+
+/*
+ * Dispatch
+ */
+
+conv_i16_fn conv_i16_f32 = conv_i16_scalar;
+conv_i16_fn conv_u16_f32 = conv_u16_scalar;
+conv_env_fn conv_ana_env = conv_env_scalar;
+conv_shift_fn conv_shift_f32 = shift_scalar;
+conv_decim_fn conv_decim_f32 = decim_scalar;
+conv_pack_fn conv_f32_ibm = pack_ibm_scalar;
+conv_pack_fn conv_f32_i32 = pack_i32_scalar;
+conv_pack_fn conv_f32_i16 = pack_i16_scalar;
+conv_pack_fn conv_f32_i8 = pack_i8_scalar;
+conv_copy_fn conv_i16_i16 = copy_i16_scalar;
+conv_peak_fn conv_peak_f32 = peak_scalar;
+static const char *isa_name = "scalar";
+
+int
+conv_select (const char *isa)
+{
+  if (strcmp (isa, "scalar") == 0)
+    {
+      conv_i16_f32 = conv_i16_scalar;
+      conv_u16_f32 = conv_u16_scalar;
+      conv_ana_env = conv_env_scalar;
+      conv_shift_f32 = shift_scalar;
+      conv_decim_f32 = decim_scalar;
+      conv_f32_ibm = pack_ibm_scalar;
+      conv_f32_i32 = pack_i32_scalar;
+      conv_f32_i16 = pack_i16_scalar;
+      conv_f32_i8 = pack_i8_scalar;
+      conv_i16_i16 = copy_i16_scalar;
+      conv_peak_f32 = peak_scalar;
+      isa_name = "scalar";
+      return 1;
+    }
+#if CONV_X86
+  __builtin_cpu_init ();
+  if (strcmp (isa, "sse2") == 0 && __builtin_cpu_supports ("sse2"))
+    {
+      conv_i16_f32 = conv_i16_sse2;
+      conv_u16_f32 = conv_u16_sse2;
+      conv_ana_env = conv_env_sse2;
+      conv_shift_f32 = shift_sse2;
+      conv_decim_f32 = decim_sse2;
+      conv_f32_ibm = pack_ibm_sse2;
+      conv_f32_i32 = pack_i32_sse2;
+      conv_f32_i16 = pack_i16_sse2;
+      conv_f32_i8 = pack_i8_sse2;
+      conv_i16_i16 = copy_i16_sse2;
+      conv_peak_f32 = peak_sse2;
+      isa_name = "sse2";
+      return 1;
+    }
+  if (strcmp (isa, "avx2") == 0 && __builtin_cpu_supports ("avx2"))
+    {
+      conv_i16_f32 = conv_i16_avx2;
+      conv_u16_f32 = conv_u16_avx2;
+      conv_ana_env = conv_env_avx2;
+      conv_shift_f32 = shift_avx2;
+      conv_decim_f32 = decim_avx2;
+      conv_f32_ibm = pack_ibm_avx2;
+      conv_f32_i32 = pack_i32_avx2;
+      conv_f32_i16 = pack_i16_avx2;
+      conv_f32_i8 = pack_i8_avx2;
+      conv_i16_i16 = copy_i16_avx2;
+      conv_peak_f32 = peak_avx2;
+      isa_name = "avx2";
+      return 1;
+    }
+  if (strcmp (isa, "avx512") == 0 && __builtin_cpu_supports ("avx512f")
+      && __builtin_cpu_supports ("avx512bw"))
+    {
+      conv_i16_f32 = conv_i16_avx512;
+      conv_u16_f32 = conv_u16_avx512;
+      conv_ana_env = conv_env_avx512;
+      conv_shift_f32 = shift_avx512;
+      conv_decim_f32 = decim_avx512;
+      conv_f32_ibm = pack_ibm_avx512;
+      conv_f32_i32 = pack_i32_avx512;
+      conv_f32_i16 = pack_i16_avx512;
+      conv_f32_i8 = pack_i8_avx512;
+      conv_i16_i16 = copy_i16_avx512;
+      conv_peak_f32 = peak_avx512;
+      isa_name = "avx512";
+      return 1;
+    }
+#endif
+  return 0;
+}
+
+/*
+ * Pick the widest supported kernel.  JSF2SEGY_ISA=scalar|sse2|avx2|avx512
+ * forces a variant (used to check that they agree).
+ */
+
+void
+conv_init (void)
+{
+  const char *env = getenv ("JSF2SEGY_ISA");
+
+  if (env != NULL && conv_select (env))
+    return;
+  if (conv_select ("avx512") || conv_select ("avx2") || conv_select ("sse2"))
+    return;
+  conv_select ("scalar");
+}
+
+const char *
+conv_isa (void)
+{
+  return isa_name;
+}
+
+/*
+ * Power of two for conv_f32_i32 ... i8 that brings peak up (or down) to
+ * fill a signed integer of bits bits without overflowing it; 0 for a
+ * dead trace.  Kept to the exact range of the kernels.
+ */
+
+int
+conv_int_weight (float peak, int bits)
+{
+  int e, w;
+
+  if (!(peak > 0.0f) || isinf (peak))
+    return 0;
+  frexpf (peak, &e);		/* peak < 2^e */
+  w = bits - 1 - e;
+  return w < -WEIGHT_LIMIT ? -WEIGHT_LIMIT : w > WEIGHT_LIMIT ? WEIGHT_LIMIT : w;
+}
+
+/*
+ * Anti-alias filter for decimation by factor: a Hamming windowed sinc
+ * of CONV_TAPS (factor) taps, cut off at 0.9 of the decimated Nyquist
+ * and scaled to unit gain at 0 Hz.  Returns the number of taps, 1 (a
+ * plain pick) for a factor of 1.
+ */
+
+int
+conv_decim_taps (int factor, float *h)
+{
+  int k, n, half;
+  double fc, x, sum = 0.0, w[CONV_TAPS (CONV_DECIM_MAX)];
+
+  if (factor <= 1)
+    {
+      h[0] = 1.0f;
+      return 1;
+    }
+  if (factor > CONV_DECIM_MAX)
+    factor = CONV_DECIM_MAX;
+  n = CONV_TAPS (factor);
+  half = n / 2;
+  fc = 0.45 / factor;		/* cycles per input sample */
+  for (k = 0; k < n; k++)
+    {
+      x = k - half;
+      w[k] = (x == 0.0 ? 2.0 * fc : sin (2.0 * M_PI * fc * x) / (M_PI * x))
+	* (0.54 - 0.46 * cos (2.0 * M_PI * k / (n - 1)));
+      sum += w[k];
+    }
+  for (k = 0; k < n; k++)
+    h[k] = (float) (w[k] / sum);
+  return n;
+}
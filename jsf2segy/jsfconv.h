@@ -0,0 +1,93 @@
+/*
+ * jsfconv.h
+ *
+ * Whole trace sample conversion kernels.  Each kernel reads JSF int16
+ * samples (little-endian), scales them by 2^weight and stores IEEE
+ * floats, byte swapped when swap is set.  SSE2, AVX2 and AVX-512
+ * variants are selected once at startup by conv_init(); the scalar
+ * variant produces bit-identical output and is used everywhere else.
+ *
+ * conv_u16_f32() is conv_i16_f32() for unsigned samples, the sidescan
+ * envelope magnitudes.
+ *
+ * conv_ana_env() turns interleaved (real, imaginary) analytic samples
+ * into the envelope sqrt (re^2 + im^2) * 2^weight.  By default the
+ * square root is single precision; with precise set it is taken in
+ * double precision and matches the original per sample ldexp/sqrt code.
+ *
+ * conv_shift_f32() delays a float trace by shift samples (negative
+ * advances it), interpolating linearly between samples for the fraction
+ * and filling with zeros, for static corrections.  in is host order and
+ * must not overlap out; out is byte swapped when swap is set.
+ *
+ * conv_decim_f32() low-pass filters and decimates a host order float
+ * trace: out[i] is the ntaps FIR filter h centred on in[first + i *
+ * factor], inputs outside 0 .. nin - 1 taken as zero, so it also cuts a
+ * window out of the trace and zero fills where the window runs past
+ * it.  conv_decim_taps() designs h for a factor; with factor 1 it is a
+ * single tap of 1, a plain window.  in must not overlap out.
+ *
+ * SEG Y sample formats other than IEEE float (5): conv_f32_ibm() packs
+ * host order floats as IBM floats (format 1), conv_f32_i32(),
+ * conv_f32_i16() and conv_f32_i8() as integers (formats 2, 3 and 8)
+ * scaled by 2^weight, rounded and saturated.  They may pack in place.
+ * conv_peak_f32() is the largest magnitude of a trace and
+ * conv_int_weight() the weight that makes it fill an integer of a given
+ * size.  conv_i16_i16() copies JSF int16 samples unchanged (format 3
+ * passthrough), every stride'th one.
+ */
+
+#ifndef _JSFCONV_H_
+#define _JSFCONV_H_
+
+#define CONV_DECIM_MAX	64	/* largest decimation factor */
+#define CONV_TAPS(f)	(8 * (f) + 1)	/* anti-alias taps at factor f */
+
+/*
+ * in	  JSF sample bytes
+ * stride 1 for Env/Real data, 2 to take the real part of Ana data
+ * nsamp  number of output samples
+ * weight power of two applied to each sample (-Weighting from the JSF header)
+ * swap	  byte swap each output float
+ */
+
+typedef void (*conv_i16_fn) (const unsigned char *in, int stride, int nsamp,
+			     int weight, int swap, float *out);
+
+typedef void (*conv_env_fn) (const unsigned char *in, int nsamp, int weight,
+			     int swap, int precise, float *out);
+
+typedef void (*conv_shift_fn) (const float *in, int nsamp, float shift,
+			       int swap, float *out);
+
+typedef void (*conv_decim_fn) (const float *in, int nin, int first,
+			       int factor, const float *h, int ntaps,
+			       int swap, int nout, float *out);
+
+typedef void (*conv_pack_fn) (const float *in, int nsamp, int weight,
+			      int swap, void *out);
+
+typedef void (*conv_copy_fn) (const unsigned char *in, int stride, int nsamp,
+			      int swap, void *out);
+
+typedef float (*conv_peak_fn) (const float *in, int nsamp);
+
+extern conv_i16_fn conv_i16_f32;
+extern conv_i16_fn conv_u16_f32;
+extern conv_env_fn conv_ana_env;
+extern conv_shift_fn conv_shift_f32;
+extern conv_decim_fn conv_decim_f32;
+extern conv_pack_fn conv_f32_ibm;
+extern conv_pack_fn conv_f32_i32;
+extern conv_pack_fn conv_f32_i16;
+extern conv_pack_fn conv_f32_i8;
+extern conv_copy_fn conv_i16_i16;
+extern conv_peak_fn conv_peak_f32;
+
+void conv_init (void);
+int conv_select (const char *isa);
+const char *conv_isa (void);
+int conv_int_weight (float peak, int bits);
+int conv_decim_taps (int factor, float *h);
+
+#endif /* _JSFCONV_H_ */
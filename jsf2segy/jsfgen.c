@@ -0,0 +1,302 @@
+/*
+ * jsfgen.c
+ *
+ * Synthetic JSF file generator, for benchmarks (make bench) and for
+ * trying jsf2segy out without survey data.  Writes pings until the file
+ * reaches the size asked for.  Each ping is, in order:
+ *
+ *   - with -a, one each of the NMEA (GGA), pitch/roll, pressure and DVL
+ *     sensor messages, every -a pings
+ *   - with -S, a port and a starboard low frequency sidescan message,
+ *     numbered -P more than the subbottom ping (Edgetech sonars count
+ *     the two apart)
+ *   - one subbottom message for each data format letter in -f
+ *     (e Envelope, a Analytic, r Real)
+ *
+ * With -c N the subbottom record length halves every N pings and comes
+ * back N pings later, so that every product sees record length changes.
+ * Samples are pseudo-random noise from a fixed seed, so a given set of
+ * options always writes the same file.
+ *
+ * Usage:	jsfgen [-s MB] [-n samples] [-f ear] [-S samples] [-P N]
+ *		[-a N] [-c N] -o out.jsf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "byteio.h"
+
+#define SONAR_MSG	80
+#define SIDESCAN_MSG	82
+#define NMEA_MSG	2002
+#define PITCH_ROLL_MSG	2020
+#define PRESS_MSG	2060
+#define DOPPLER_MSG	2080
+
+#define HDRLEN		16	/* JSF message header */
+#define SONARLEN	240	/* sonar trace header */
+#define NOISE		(1 << 20)	/* bytes of noise samples are cut from */
+#define PING_SEC	0.125	/* time between pings */
+#define T0		1500000000	/* time of the first ping */
+
+static unsigned char noise[NOISE];
+static size_t noise_at;
+
+/*
+ * Next n bytes of noise, 4 byte aligned so analytic pairs stay pairs
+ */
+
+static const unsigned char *
+samples (size_t n)
+{
+  const unsigned char *p;
+
+  if (noise_at + n > NOISE)
+    noise_at = 0;
+  p = noise + noise_at;
+  noise_at = (noise_at + n + 3) & ~(size_t) 3;
+  if (noise_at >= NOISE)
+    noise_at = 0;
+  return p;
+}
+
+static void
+put_header (FILE * f, unsigned int type, int subsystem, int channel,
+	    size_t size)
+{
+  unsigned char h[HDRLEN];
+
+  memset (h, 0, sizeof (h));
+  st_le16 (h, 0x1601);
+  h[2] = 1;			/* protocol version */
+  st_le16 (h + 4, (uint16_t) type);
+  h[6] = 2;			/* command: data */
+  h[7] = (unsigned char) subsystem;
+  h[8] = (unsigned char) channel;
+  st_le32 (h + 12, (uint32_t) size);
+  fwrite (h, 1, HDRLEN, f);
+}
+
+/*
+ * Sonar trace header for ping at time t
+ */
+
+static void
+sonar_header (unsigned char *h, int ping, double t, int fmt, int nsamp,
+	      int interval_ns)
+{
+  uint32_t sec = (uint32_t) t;
+  uint32_t ms = (uint32_t) ((t - sec) * 1000.0 + 0.5);
+
+  memset (h, 0, SONARLEN);
+  st_le32 (h, sec);
+  st_le32 (h + 8, (uint32_t) ping);
+  st_le16 (h + 34, (uint16_t) fmt);
+  st_le16 (h + 38, 12);		/* offset */
+  st_le32 (h + 80, (uint32_t) (-704000 + ping));	/* coarse X, Y */
+  st_le32 (h + 84, (uint32_t) (415000 + ping));
+  st_le16 (h + 114, (uint16_t) nsamp);
+  st_le32 (h + 116, (uint32_t) interval_ns);
+  st_le16 (h + 120, 7);		/* gain */
+  st_le16 (h + 126, 200);	/* start, end frequency (10 Hz) */
+  st_le16 (h + 128, 1200);
+  st_le16 (h + 130, 20);	/* sweep length, ms */
+  st_le32 (h + 136, 5432);	/* depth, mm */
+  st_le32 (h + 144, 98765);	/* altitude, mm */
+  st_le16 (h + 168, (uint16_t) (-(ping % 12) + 3));	/* weighting */
+  st_le16 (h + 186, (uint16_t) (sec / 3600 % 24));
+  st_le16 (h + 188, (uint16_t) (sec / 60 % 60));
+  st_le16 (h + 190, (uint16_t) (sec % 60));
+  st_le16 (h + 196, 123);	/* day */
+  st_le16 (h + 198, 2017);	/* year */
+  st_le32 (h + 200, (sec % 86400) * 1000 + ms);
+}
+
+static void
+put_sonar (FILE * f, int type, int subsystem, int channel, int ping,
+	   double t, int fmt, int nsamp, int interval_ns)
+{
+  unsigned char h[SONARLEN];
+  size_t bytes = (size_t) nsamp * (fmt == 1 ? 4 : 2);
+
+  put_header (f, (unsigned int) type, subsystem, channel, SONARLEN + bytes);
+  sonar_header (h, ping, t, fmt, nsamp, interval_ns);
+  fwrite (h, 1, SONARLEN, f);
+  fwrite (samples (bytes), 1, bytes, f);
+}
+
+/*
+ * Sensor messages all start with the time and its milliseconds
+ */
+
+static void
+sensor_time (unsigned char *p, double t)
+{
+  uint32_t sec = (uint32_t) t;
+
+  st_le32 (p, sec);
+  st_le32 (p + 4, (uint32_t) ((t - sec) * 1000.0 + 0.5));
+}
+
+static void
+put_sensors (FILE * f, int ping, double t)
+{
+  unsigned char p[76];
+  char nmea[96];
+  double lat = 41.5 + ping * 1e-5, lon = 70.6 + ping * 2e-5;
+  unsigned int sum = 0;
+  int n, k;
+
+  n = snprintf (nmea, sizeof (nmea),
+		"$GPGGA,%02d%02d%02d.00,%02d%07.4f,N,%03d%07.4f,W,1,08,1.0,0.0,M,0.0,M,,",
+		(int) ((uint32_t) t / 3600 % 24), (int) ((uint32_t) t / 60 % 60),
+		(int) ((uint32_t) t % 60), (int) lat, (lat - (int) lat) * 60.0,
+		(int) lon, (lon - (int) lon) * 60.0);
+  for (k = 1; k < n; k++)
+    sum ^= (unsigned char) nmea[k];
+  n += snprintf (nmea + n, sizeof (nmea) - n, "*%02X", sum);
+  put_header (f, NMEA_MSG, 100, 0, 12 + (size_t) n);
+  memset (p, 0, sizeof (p));
+  sensor_time (p, t);
+  p[8] = 1;			/* source */
+  fwrite (p, 1, 12, f);
+  fwrite (nmea, 1, (size_t) n, f);
+
+  memset (p, 0, sizeof (p));
+  sensor_time (p, t);
+  st_le16 (p + 24, (uint16_t) (int16_t) (ping % 200 - 100));	/* pitch */
+  st_le16 (p + 26, (uint16_t) (int16_t) (100 - ping % 200));	/* roll */
+  st_le16 (p + 32, (uint16_t) (int16_t) (ping % 500 - 250));	/* heave */
+  st_le16 (p + 34, (uint16_t) (ping * 7 % 36000));	/* heading */
+  st_le32 (p + 36, (1 << 6) | (1 << 7) | (1 << 8) | (1 << 9));
+  put_header (f, PITCH_ROLL_MSG, 100, 0, 48);
+  fwrite (p, 1, 48, f);
+
+  memset (p, 0, sizeof (p));
+  sensor_time (p, t);
+  st_le32 (p + 24, 1 << 5);
+  st_le32 (p + 36, (uint32_t) (5000 + ping % 1000));	/* depth, mm */
+  put_header (f, PRESS_MSG, 100, 0, 76);
+  fwrite (p, 1, 76, f);
+
+  memset (p, 0, sizeof (p));
+  sensor_time (p, t);
+  st_le32 (p + 12, 1 << 5);
+  for (k = 0; k < 4; k++)
+    st_le32 (p + 16 + 4 * k, (uint32_t) (1000 + ping % 100 + k));	/* cm */
+  put_header (f, DOPPLER_MSG, 100, 0, 74);
+  fwrite (p, 1, 74, f);
+}
+
+static void
+usage (const char *prog)
+{
+  fprintf (stderr,
+	   "Usage: %s [-s MB] [-n samples] [-f formats] [-S samples] [-P N]"
+	   " [-a N] [-c N] -o out.jsf\n"
+	   "\t-s size of the file in MB (default 256)\n"
+	   "\t-n subbottom samples per ping (default 8000)\n"
+	   "\t-f subbottom data formats per ping, e Envelope, a Analytic,\n"
+	   "\t   r Real (default ear)\n"
+	   "\t-S sidescan samples per channel, 0 for none (default 2000)\n"
+	   "\t-P add N to the sidescan ping numbers (default 0)\n"
+	   "\t-a sensor messages every N pings, 0 for none (default 1)\n"
+	   "\t-c record length change every N pings (default 0, none)\n",
+	   prog);
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *out = NULL, *fmts = "ear", *c;
+  long long size = 256LL << 20;
+  int nsamp = 8000, ss = 2000, ss_from = 0, aux = 1, change = 0;
+  int ping, ns, fmt, opt;
+  uint32_t x = 2463534242u;
+  size_t k;
+  FILE *f;
+  double t;
+
+  while ((opt = getopt (argc, argv, "s:n:f:S:P:a:c:o:")) != -1)
+    {
+      switch (opt)
+	{
+	case 's':
+	  size = (long long) (atof (optarg) * 1048576.0);
+	  break;
+	case 'n':
+	  nsamp = atoi (optarg);
+	  break;
+	case 'f':
+	  fmts = optarg;
+	  break;
+	case 'S':
+	  ss = atoi (optarg);
+	  break;
+	case 'P':
+	  ss_from = atoi (optarg);
+	  break;
+	case 'a':
+	  aux = atoi (optarg);
+	  break;
+	case 'c':
+	  change = atoi (optarg);
+	  break;
+	case 'o':
+	  out = optarg;
+	  break;
+	default:
+	  usage (argv[0]);
+	}
+    }
+  if (out == NULL || nsamp < 2 || nsamp > 32767 || ss < 0 || ss > 65535
+      || aux < 0 || change < 0 || size <= 0)
+    usage (argv[0]);
+  for (c = fmts; *c != '\0'; c++)
+    if (*c != 'e' && *c != 'a' && *c != 'r')
+      usage (argv[0]);
+
+  for (k = 0; k < NOISE; k++)
+    {
+      x ^= x << 13;		/* xorshift32 */
+      x ^= x >> 17;
+      x ^= x << 5;
+      noise[k] = (unsigned char) x;
+    }
+
+  if ((f = fopen (out, "wb")) == NULL)
+    {
+      perror (out);
+      exit (EXIT_FAILURE);
+    }
+  setvbuf (f, NULL, _IOFBF, 1 << 20);
+
+  for (ping = 1; ftello (f) < size; ping++)
+    {
+      t = T0 + ping * PING_SEC;
+      ns = change && (ping - 1) / change % 2 ? nsamp / 2 : nsamp;
+      if (aux && ping % aux == 0)
+	put_sensors (f, ping, t - PING_SEC / 2);
+      if (ss)
+	{
+	  put_sonar (f, SIDESCAN_MSG, 20, 0, ss_from + ping, t, 0, ss, 20000);
+	  put_sonar (f, SIDESCAN_MSG, 20, 1, ss_from + ping, t, 0, ss, 20000);
+	}
+      for (c = fmts; *c != '\0'; c++)
+	{
+	  fmt = *c == 'e' ? 0 : *c == 'a' ? 1 : 3;
+	  put_sonar (f, SONAR_MSG, 0, 0, ping, t, fmt, ns, 23000);
+	}
+    }
+  if (ferror (f) || fclose (f) == EOF)
+    {
+      perror (out);
+      exit (EXIT_FAILURE);
+    }
+  fprintf (stderr, "%s: %d pings\n", out, ping - 1);
+  exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,298 @@
+/*
+ * jsfidx.c
+ *
+ * Build, save and load the JSF message index.  See jsfidx.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "byteio.h"
+#include "jsfread.h"
+#include "jsfidx.h"
+
+#define SONAR_MSG	80	/* subbottom and sidescan sonar data */
+#define SIDESCAN_MSG	82	/* sidescan sonar data */
+#define SONAR_PEEK	204	/* sonar header bytes the index needs */
+
+/*
+ * Sidecar name for a .jsf file: the file name plus ".jsfidx".  The
+ * caller frees it.
+ */
+
+char *
+jsfidx_name (const char *jsfname)
+{
+  char *name;
+
+  name = (char *) malloc (strlen (jsfname) + sizeof (JSFIDX_SUFFIX));
+  if (name != NULL)
+    {
+      strcpy (name, jsfname);
+      strcat (name, JSFIDX_SUFFIX);
+    }
+  return name;
+}
+
+static int
+add_entry (JSFIndex * idx, const JSFIndexEntry * e)
+{
+  JSFIndexEntry *n;
+  size_t alloc;
+
+  if (idx->count == idx->alloc)
+    {
+      alloc = idx->alloc ? 2 * idx->alloc : 4096;
+      n = (JSFIndexEntry *) realloc (idx->ent, alloc * sizeof (*n));
+      if (n == NULL)
+	return -1;
+      idx->ent = n;
+      idx->alloc = alloc;
+    }
+  idx->ent[idx->count++] = *e;
+  return 0;
+}
+
+/*
+ * One pass over the message headers of jsfname.  Returns 0, or -1 with
+ * errno set (EINVAL for a message without the 0x1601 marker).
+ */
+
+int
+jsfidx_build (const char *jsfname, JSFIndex * idx)
+{
+  JSFReader r;
+  JSFMessage m;
+  JSFIndexEntry e;
+  const unsigned char *sh;
+  struct stat st;
+  int ret;
+
+  memset (idx, 0, sizeof (*idx));
+  if (jsf_open (&r, jsfname, JSF_READ) == -1)
+    return -1;
+  if (fstat (r.fd, &st) == -1)
+    {
+      jsf_close (&r);
+      return -1;
+    }
+  idx->file_size = (uint64_t) st.st_size;
+  idx->file_mtime = (int64_t) st.st_mtime;
+
+  errno = 0;
+  m.offset = 0;
+  while ((ret = jsf_next (&r, &m)) == 1)
+    {
+      if (ld_le16 (m.hdr) != 0x1601)
+	{
+	  ret = -1;
+	  errno = EINVAL;
+	  break;
+	}
+
+      /*
+       * A message cut short at the end of the file (acquisition stopped
+       * mid write) ends the index, so indexed runs stop cleanly before it.
+       */
+
+      if (m.offset + JSF_MSGHDRLEN + (off_t) m.size > st.st_size)
+	{
+	  ret = 0;
+	  break;
+	}
+      memset (&e, 0, sizeof (e));
+      e.offset = m.offset;
+      e.size = (uint32_t) m.size;
+      e.type = m.type;
+      e.subsystem = m.subsystem;
+      e.channel = m.channel;
+      e.format = -1;
+      if ((m.type == SONAR_MSG || m.type == SIDESCAN_MSG)
+	  && m.size >= SONAR_PEEK)
+	{
+	  if ((sh = jsf_read (&r, SONAR_PEEK)) == NULL)
+	    {
+	      ret = -1;
+	      errno = EINVAL;
+	      break;
+	    }
+	  e.time = ld_le32 (sh);
+	  e.format = (int16_t) ld_le16 (sh + 34);
+	  e.msec = (uint16_t) (ld_le32 (sh + 200) % 1000);
+	}
+      if (add_entry (idx, &e) == -1)
+	{
+	  ret = -1;
+	  break;
+	}
+    }
+  if (ret == -1 && m.offset + JSF_MSGHDRLEN > st.st_size)
+    ret = 0;			/* short header at the end of the file */
+  jsf_close (&r);
+  if (ret == -1)
+    {
+      if (errno == 0)
+	errno = EINVAL;
+      jsfidx_free (idx);
+      return -1;
+    }
+  return 0;
+}
+
+int
+jsfidx_write (const char *idxname, const JSFIndex * idx)
+{
+  unsigned char *buf, *p;
+  size_t len, k;
+  int fd, ret = 0;
+
+  len = JSFIDX_HDRLEN + idx->count * JSFIDX_ENTLEN;
+  if ((buf = (unsigned char *) calloc (len, 1)) == NULL)
+    return -1;
+
+  memcpy (buf, JSFIDX_MAGIC, 8);
+  st_le64 (buf + 8, idx->file_size);
+  st_le64 (buf + 16, (uint64_t) idx->file_mtime);
+  st_le32 (buf + 24, (uint32_t) idx->count);
+
+  for (k = 0, p = buf + JSFIDX_HDRLEN; k < idx->count;
+       k++, p += JSFIDX_ENTLEN)
+    {
+      st_le64 (p, (uint64_t) idx->ent[k].offset);
+      st_le32 (p + 8, idx->ent[k].size);
+      st_le32 (p + 12, idx->ent[k].time);
+      st_le16 (p + 16, idx->ent[k].type);
+      st_le16 (p + 18, (uint16_t) idx->ent[k].format);
+      st_le16 (p + 20, idx->ent[k].msec);
+      p[22] = idx->ent[k].subsystem;
+      p[23] = idx->ent[k].channel;
+    }
+
+  if ((fd = open (idxname, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+    ret = -1;
+  else
+    {
+      if (write (fd, buf, len) != (ssize_t) len)
+	ret = -1;
+      if (close (fd) == -1)
+	ret = -1;
+    }
+  free (buf);
+  return ret;
+}
+
+/*
+ * Load idxname if it exists and was built from the file open on jsf_fd
+ * as it is now (same size and modification time).  Returns 0 if the
+ * index can be used, -1 otherwise.
+ */
+
+int
+jsfidx_load (const char *idxname, int jsf_fd, JSFIndex * idx)
+{
+  unsigned char hdr[JSFIDX_HDRLEN], *buf = NULL, *p;
+  struct stat st, ist;
+  size_t k, len;
+  int fd;
+
+  memset (idx, 0, sizeof (*idx));
+  if (fstat (jsf_fd, &st) == -1)
+    return -1;
+  if ((fd = open (idxname, O_RDONLY)) == -1)
+    return -1;
+  if (fstat (fd, &ist) == -1
+      || read (fd, hdr, JSFIDX_HDRLEN) != JSFIDX_HDRLEN
+      || memcmp (hdr, JSFIDX_MAGIC, 8) != 0
+      || ld_le64 (hdr + 8) != (uint64_t) st.st_size
+      || (int64_t) ld_le64 (hdr + 16) != (int64_t) st.st_mtime)
+    goto stale;
+
+  idx->count = ld_le32 (hdr + 24);
+  len = idx->count * JSFIDX_ENTLEN;
+  if ((size_t) ist.st_size != JSFIDX_HDRLEN + len)
+    goto stale;
+  if (idx->count == 0)
+    {
+      close (fd);
+      return 0;
+    }
+  buf = (unsigned char *) malloc (len);
+  idx->ent = (JSFIndexEntry *) malloc (idx->count * sizeof (JSFIndexEntry));
+  if (buf == NULL || idx->ent == NULL
+      || read (fd, buf, len) != (ssize_t) len)
+    goto stale;
+
+  for (k = 0, p = buf; k < idx->count; k++, p += JSFIDX_ENTLEN)
+    {
+      idx->ent[k].offset = (off_t) ld_le64 (p);
+      idx->ent[k].size = ld_le32 (p + 8);
+      idx->ent[k].time = ld_le32 (p + 12);
+      idx->ent[k].type = ld_le16 (p + 16);
+      idx->ent[k].format = (int16_t) ld_le16 (p + 18);
+      idx->ent[k].msec = ld_le16 (p + 20);
+      idx->ent[k].subsystem = p[22];
+      idx->ent[k].channel = p[23];
+    }
+  idx->alloc = idx->count;
+  idx->file_size = (uint64_t) st.st_size;
+  idx->file_mtime = (int64_t) st.st_mtime;
+  free (buf);
+  close (fd);
+  return 0;
+
+stale:
+  free (buf);
+  jsfidx_free (idx);
+  close (fd);
+  return -1;
+}
+
+void
+jsfidx_free (JSFIndex * idx)
+{
+  free (idx->ent);
+  memset (idx, 0, sizeof (*idx));
+}
+
+/*
+ * Bytes of SEG Y traces (240 byte header plus samples of sample_bytes
+ * each) that the
+ * subbottom pings from entry from onwards will produce before the next
+ * record length change.  fmt_mask has bit n set for each wanted data
+ * format n; pings of other formats are passed over, record length and
+ * all.  Used only as a preallocation hint.
+ */
+
+size_t
+jsfidx_run_bytes (const JSFIndex * idx, size_t from, unsigned int fmt_mask,
+		  size_t sample_bytes)
+{
+  const JSFIndexEntry *e;
+  size_t k, bytes = 0, nsamp;
+  uint32_t size;
+
+  if (from >= idx->count)
+    return 0;
+  size = idx->ent[from].size;
+  for (k = from; k < idx->count; k++)
+    {
+      e = &idx->ent[k];
+      if (e->type != SONAR_MSG || e->subsystem != 0)
+	continue;
+      if (e->format < 0 || e->format > 31
+	  || !(fmt_mask & (1u << e->format)))
+	continue;
+      if (e->size != size)
+	break;
+      if (e->size < 240)
+	continue;
+      nsamp = (e->size - 240) / (e->format == 1 ? 4 : 2);
+      bytes += 240 + nsamp * sample_bytes;
+    }
+  return bytes;
+}
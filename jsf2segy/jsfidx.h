@@ -0,0 +1,73 @@
+/*
+ * jsfidx.h
+ *
+ * Persistent JSF message index (.jsfidx sidecar).
+ *
+ * The index is built in one pass over the 16 byte message headers,
+ * skipping each payload by its size; only the first bytes of the 240
+ * byte sonar headers are read, for the ping time and data format.  It
+ * lets later runs of jsf2segy go straight to the subbottom messages and
+ * size their output files before writing them.
+ *
+ * File layout, all integers little-endian:
+ *
+ *   header (32 bytes)
+ *     0-7	"JSFIDX01"
+ *     8-15	size of the indexed .jsf file
+ *     16-23	modification time of the indexed .jsf file (seconds)
+ *     24-27	number of entries
+ *     28-31	reserved
+ *
+ *   entry (24 bytes, one per message)
+ *     0-7	file offset of the 16 byte message header
+ *     8-11	payload size (JSF header bytes 12-15)
+ *     12-15	ping time, seconds since 1970 (sonar header bytes 0-3)
+ *     16-17	message type (JSF header bytes 4-5)
+ *     18-19	data format (sonar header bytes 34-35), -1 if not sonar
+ *     20-21	milliseconds of the ping time (sonar header bytes 200-203)
+ *     22	subsystem (JSF header byte 7)
+ *     23	channel (JSF header byte 8)
+ */
+
+#ifndef _JSFIDX_H_
+#define _JSFIDX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define JSFIDX_MAGIC	"JSFIDX01"
+#define JSFIDX_SUFFIX	".jsfidx"
+#define JSFIDX_HDRLEN	32
+#define JSFIDX_ENTLEN	24
+
+typedef struct
+{
+  off_t offset;			/* file offset of the message header */
+  uint32_t size;		/* payload bytes */
+  uint32_t time;		/* ping time, seconds since 1970 */
+  uint16_t type;		/* message type */
+  int16_t format;		/* sonar data format, -1 if not sonar */
+  uint16_t msec;		/* milliseconds of the ping time */
+  uint8_t subsystem;
+  uint8_t channel;
+} JSFIndexEntry;
+
+typedef struct
+{
+  JSFIndexEntry *ent;
+  size_t count;
+  size_t alloc;
+  uint64_t file_size;		/* .jsf size and mtime when indexed */
+  int64_t file_mtime;
+} JSFIndex;
+
+char *jsfidx_name (const char *jsfname);
+int jsfidx_build (const char *jsfname, JSFIndex * idx);
+int jsfidx_write (const char *idxname, const JSFIndex * idx);
+int jsfidx_load (const char *idxname, int jsf_fd, JSFIndex * idx);
+void jsfidx_free (JSFIndex * idx);
+size_t jsfidx_run_bytes (const JSFIndex * idx, size_t from,
+			 unsigned int fmt_mask, size_t sample_bytes);
+
+#endif /* _JSFIDX_H_ */
@@ -0,0 +1,311 @@
+/*
+ * jsfmap.c
+ *
+ * JSF sonar header to SEG Y trace header mapping, its file and its
+ * compiled form.  See jsfmap.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <stdint.h>
+#include "byteio.h"
+#include "jsfmap.h"
+
+static const char *type_name[] = { "i16", "u16", "i32", "u32", "f32" };
+
+static const MapField *
+field_of (const HeaderMap * m, const char *name)
+{
+  const MapField *f;
+
+  for (f = m->fields; f->name != NULL; f++)
+    if (strcasecmp (f->name, name) == 0)
+      return f;
+  return NULL;
+}
+
+static int
+type_size (int type)
+{
+  return type == MAP_I16 || type == MAP_U16 ? 2 : 4;
+}
+
+/*
+ * Put e in the table, in place of any entry for the same field; with
+ * none, take that entry out.  Returns -1 if the table is full.
+ */
+
+static int
+set_entry (HeaderMap * m, const MapEntry * e, int none)
+{
+  int k;
+
+  for (k = 0; k < m->nent; k++)
+    if (strcasecmp (m->ent[k].field, e->field) == 0)
+      break;
+  if (none)
+    {
+      if (k < m->nent)
+	m->ent[k] = m->ent[--m->nent];
+      return 0;
+    }
+  if (k == MAP_MAX)
+    return -1;
+  m->ent[k] = *e;
+  if (k == m->nent)
+    m->nent++;
+  return 0;
+}
+
+/*
+ * The table of the n entries ent over fields.  Returns -1 if an entry
+ * names a field that is not there.
+ */
+
+int
+map_init (HeaderMap * m, const MapField * fields, const MapEntry * ent,
+	  int n)
+{
+  const MapField *f;
+  MapEntry e;
+  int k;
+
+  memset (m, 0, sizeof (*m));
+  m->fields = fields;
+  for (k = 0; k < n; k++)
+    {
+      if ((f = field_of (m, ent[k].field)) == NULL)
+	return -1;
+      e = ent[k];
+      e.field = f->name;
+      if (set_entry (m, &e, 0) == -1)
+	return -1;
+    }
+  return 0;
+}
+
+/*
+ * Changes to the table from path.  Returns -1 after saying what is wrong
+ * with it.
+ */
+
+int
+map_load (HeaderMap * m, const char *path)
+{
+  const MapField *f;
+  MapEntry e;
+  FILE *fp;
+  char line[256], name[64], src[64], type[64], scale[64], *end;
+  int lineno = 0, n, none, k, ret = 0;
+
+  if ((fp = fopen (path, "r")) == NULL)
+    {
+      perror (path);
+      return -1;
+    }
+  while (fgets (line, sizeof (line), fp) != NULL)
+    {
+      lineno++;
+      if ((end = strchr (line, '#')) != NULL)
+	*end = '\0';
+      n = sscanf (line, "%63s %63s %63s %63s", name, src, type, scale);
+      if (n <= 0)
+	continue;
+      if ((f = field_of (m, name)) == NULL)
+	{
+	  fprintf (stderr, "%s:%d: no trace header field %s\n", path, lineno,
+		   name);
+	  ret = -1;
+	  continue;
+	}
+      e.field = f->name;
+      e.src = -1;
+      e.type = f->size == 2 ? MAP_I16 : MAP_I32;
+      e.scale = 1.0;
+      none = n >= 2 && strcasecmp (src, "none") == 0;
+      if (n >= 2 && strcasecmp (src, "const") == 0)
+	{
+	  e.type = MAP_CONST;
+	  if (n != 3 || (e.scale = strtod (type, &end), *end != '\0'))
+	    {
+	      fprintf (stderr, "%s:%d: const takes a value\n", path, lineno);
+	      ret = -1;
+	      continue;
+	    }
+	}
+      else if (!none)
+	{
+	  if (n < 2 || (e.src = (int) strtol (src, &end, 0), *end != '\0')
+	      || e.src < 0)
+	    {
+	      fprintf (stderr, "%s:%d: expected a JSF offset, const or none\n",
+		       path, lineno);
+	      ret = -1;
+	      continue;
+	    }
+	  if (n >= 3)
+	    {
+	      for (k = 0; k < MAP_CONST; k++)
+		if (strcasecmp (type, type_name[k]) == 0)
+		  break;
+	      if (k == MAP_CONST)
+		{
+		  fprintf (stderr, "%s:%d: type %s is not one of i16, u16, "
+			   "i32, u32, f32\n", path, lineno, type);
+		  ret = -1;
+		  continue;
+		}
+	      e.type = k;
+	    }
+	  if (n >= 4 && (e.scale = strtod (scale, &end), *end != '\0'))
+	    {
+	      fprintf (stderr, "%s:%d: bad scale %s\n", path, lineno, scale);
+	      ret = -1;
+	      continue;
+	    }
+	  if (e.src + type_size (e.type) > MAP_HDRLEN)
+	    {
+	      fprintf (stderr, "%s:%d: offset %d is past the %d byte sonar "
+		       "header\n", path, lineno, e.src, MAP_HDRLEN);
+	      ret = -1;
+	      continue;
+	    }
+	}
+      if (set_entry (m, &e, none) == -1)
+	{
+	  fprintf (stderr, "%s:%d: more than %d fields\n", path, lineno,
+		   MAP_MAX);
+	  ret = -1;
+	}
+    }
+  fclose (fp);
+  return ret;
+}
+
+static void
+store (unsigned char *p, int size, int little, int64_t v)
+{
+  if (size == 2 && little)
+    st_le16 (p, (uint16_t) v);
+  else if (size == 2)
+    st_be16 (p, (uint16_t) v);
+  else if (little)
+    st_le32 (p, (uint32_t) v);
+  else
+    st_be32 (p, (uint32_t) v);
+}
+
+/*
+ * The template and operations of the table, for SEG Y big-endian or
+ * (little) little-endian
+ */
+
+void
+map_compile (HeaderMap * m, int little)
+{
+  const MapEntry *e;
+  const MapField *f;
+  MapOp op[MAP_MAX];
+  int k, kind, n = 0;
+
+  memset (m->templ, 0, sizeof (m->templ));
+  memset (m->nkind, 0, sizeof (m->nkind));
+  m->little = little;
+  for (k = 0; k < m->nent; k++)
+    {
+      e = &m->ent[k];
+      f = field_of (m, e->field);
+      if (e->type == MAP_CONST)
+	{
+	  store (m->templ + f->offset, f->size, little, llrint (e->scale));
+	  continue;
+	}
+      op[n].type = (unsigned char) e->type;
+      op[n].src = (unsigned short) e->src;
+      op[n].dst = f->offset;
+      op[n].size = f->size;
+      op[n].scale = e->scale;
+      if (e->type != MAP_F32 && e->scale == 1.0
+	  && type_size (e->type) == f->size)
+	op[n].kind = f->size == 2 ? (little ? MAP_COPY16 : MAP_SWAP16)
+	  : (little ? MAP_COPY32 : MAP_SWAP32);
+      else if (e->type != MAP_F32 && e->scale == rint (e->scale)
+	       && fabs (e->scale) < 2147483648.0)
+	{
+	  op[n].kind = MAP_SCALE;
+	  op[n].iscale = (int64_t) e->scale;
+	}
+      else
+	op[n].kind = MAP_CONVERT;
+      m->nkind[op[n].kind]++;
+      n++;
+    }
+
+  /*
+   * In runs of a kind, in the order of map_apply()
+   */
+
+  m->nop = 0;
+  for (kind = 0; kind < MAP_NKIND; kind++)
+    for (k = 0; k < n; k++)
+      if (op[k].kind == kind)
+	m->op[m->nop++] = op[k];
+}
+
+/*
+ * The mapped fields of trace header th from JSF sonar header jsf; the
+ * rest of th is the template's
+ */
+
+void
+map_apply (const HeaderMap * m, const unsigned char *jsf, unsigned char *th)
+{
+  const MapOp *op = m->op, *end;
+  const unsigned char *s;
+  int64_t v;
+  double x;
+
+  memcpy (th, m->templ, MAP_HDRLEN);
+  for (end = op + m->nkind[MAP_COPY16]; op < end; op++)
+    memcpy (th + op->dst, jsf + op->src, 2);
+  for (end = op + m->nkind[MAP_COPY32]; op < end; op++)
+    memcpy (th + op->dst, jsf + op->src, 4);
+  for (end = op + m->nkind[MAP_SWAP16]; op < end; op++)
+    st_be16 (th + op->dst, ld_le16 (jsf + op->src));
+  for (end = op + m->nkind[MAP_SWAP32]; op < end; op++)
+    st_be32 (th + op->dst, ld_le32 (jsf + op->src));
+  for (end = op + m->nkind[MAP_SCALE]; op < end; op++)
+    {
+      s = jsf + op->src;
+      v = op->type == MAP_I16 ? (int16_t) ld_le16 (s)
+	: op->type == MAP_U16 ? (int64_t) ld_le16 (s)
+	: op->type == MAP_I32 ? (int32_t) ld_le32 (s) : (int64_t) ld_le32 (s);
+      store (th + op->dst, op->size, m->little, v * op->iscale);
+    }
+  for (end = op + m->nkind[MAP_CONVERT]; op < end; op++)
+    {
+      s = jsf + op->src;
+      switch (op->type)
+	{
+	case MAP_I16:
+	  x = (int16_t) ld_le16 (s);
+	  break;
+	case MAP_U16:
+	  x = ld_le16 (s);
+	  break;
+	case MAP_I32:
+	  x = (int32_t) ld_le32 (s);
+	  break;
+	case MAP_U32:
+	  x = ld_le32 (s);
+	  break;
+	default:
+	  x = ld_lef32 (s);
+	  break;
+	}
+      store (th + op->dst, op->size, m->little, llrint (x * op->scale));
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * jsfmap.h
+ *
+ * JSF sonar header to SEG Y trace header mapping.
+ *
+ * The mapping is a table: for each SEG Y trace header field either a
+ * JSF sonar header field (its byte offset, type and a scale factor) or
+ * a constant.  jsf2segy has its own table built in and --header-map
+ * reads changes to it from a file, one field a line:
+ *
+ *	# field		source	type	scale
+ *	elev		136	i32
+ *	stfreq		126	u16	10
+ *	tbasis		const	4
+ *	offset		none
+ *
+ * Types are i16, u16, i32, u32 and f32, little-endian as in JSF; the
+ * type defaults to a signed integer of the field's size and the scale to
+ * 1.  A line for a field already in the table replaces it, none drops
+ * it.  The value is scaled, rounded to an integer and stored in the
+ * field, keeping its low bits if it does not fit.
+ *
+ * map_compile() turns the table into a template trace header, the
+ * constants filled in, and a list of operations, one per mapped field:
+ * a two or four byte copy (or byte reversal, for the other byte order)
+ * where the source is an integer of the field's size unscaled, an
+ * integer multiply for a whole scale, else a load, scale, round and
+ * store.  map_apply() then builds the mapped part of a
+ * trace header with a 240 byte copy and those operations, a loop over
+ * each kind in turn with no decision per field.
+ */
+
+#ifndef _JSFMAP_H_
+#define _JSFMAP_H_
+
+#include <stdint.h>
+
+#define MAP_HDRLEN	240	/* SEG Y trace header, JSF sonar header */
+#define MAP_MAX		64	/* fields mapped */
+
+#define MAP_I16		0	/* source types */
+#define MAP_U16		1
+#define MAP_I32		2
+#define MAP_U32		3
+#define MAP_F32		4
+#define MAP_CONST	5	/* no source, scale is the value */
+
+#define MAP_COPY16	0	/* compiled operations: same byte order, copy */
+#define MAP_COPY32	1
+#define MAP_SWAP16	2	/* the other byte order, reverse */
+#define MAP_SWAP32	3
+#define MAP_SCALE	4	/* integer load, multiply, store */
+#define MAP_CONVERT	5	/* load, scale, round, store */
+#define MAP_NKIND	6
+
+typedef struct
+{
+  const char *name;
+  unsigned short offset;	/* in the SEG Y trace header */
+  unsigned short size;		/* 2 or 4 */
+} MapField;
+
+typedef struct
+{
+  const char *field;		/* SEG Y trace header field */
+  int src;			/* JSF sonar header offset, -1 constant */
+  int type;			/* MAP_I16 ... MAP_CONST */
+  double scale;			/* or the constant */
+} MapEntry;
+
+typedef struct
+{
+  unsigned char kind;
+  unsigned char type;
+  unsigned short src;
+  unsigned short dst;
+  unsigned short size;
+  int64_t iscale;		/* MAP_SCALE */
+  double scale;
+} MapOp;
+
+typedef struct
+{
+  const MapField *fields;	/* the fields there are, NULL name ended */
+  MapEntry ent[MAP_MAX];
+  int nent;
+  MapOp op[MAP_MAX];		/* in runs of the same kind */
+  int nop;
+  int nkind[MAP_NKIND];		/* ops of each kind */
+  int little;			/* SEG Y rev 2 little-endian */
+  unsigned char templ[MAP_HDRLEN];
+} HeaderMap;
+
+int map_init (HeaderMap * m, const MapField * fields, const MapEntry * ent,
+	      int n);
+int map_load (HeaderMap * m, const char *path);
+void map_compile (HeaderMap * m, int little);
+void map_apply (const HeaderMap * m, const unsigned char *jsf,
+		unsigned char *th);
+
+#endif /* _JSFMAP_H_ */
@@ -0,0 +1,187 @@
+/*
+ * jsfmesgtype.c
+ *
+ * Message inventory of Edgetech .jsf files: for each message type (and
+ * subsystem) in a file, its name, how many messages there are and how
+ * many bytes they take.  Only the 16 byte message headers are read;
+ * every payload is passed over by its size, through a mapping of the
+ * file by default, so the time taken goes with the number of messages
+ * rather than the size of the file.
+ *
+ * Usage:	jsfmesgtype [-r] file.jsf ...
+ *		-r read() the headers instead of mapping the file
+ *		A file of - is standard input, read as a stream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "libjsf.h"
+
+#define NTYPES		256	/* distinct (type, subsystem) tallied */
+
+typedef struct
+{
+  unsigned short type;
+  unsigned char subsystem;
+  unsigned long messages;
+  unsigned long long bytes;	/* headers and payloads */
+} Tally;
+
+/*
+ * Message types of the JSF Data File Description
+ */
+
+static const struct
+{
+  unsigned short type;
+  const char *name;
+} type_name[] =
+{
+  {80, "Sonar Data"},
+  {82, "Side Scan Data"},
+  {86, "4400-SAS Processed Data"},
+  {182, "System Information"},
+  {426, "File Timestamp"},
+  {428, "File Padding"},
+  {2002, "NMEA String"},
+  {2020, "Pitch Roll Data"},
+  {2040, "Miscellaneous Analog Sensors"},
+  {2060, "Pressure Sensor Reading"},
+  {2080, "Doppler Velocity Log Data"},
+  {2090, "Situation Message"},
+  {2091, "Situation Comprehensive Message"},
+  {2100, "Cable Counter Data"},
+  {2101, "Kilometer of Pipe Data"},
+  {2111, "Container Timestamp"},
+  {9001, "Discover-2 General Prefix"},
+  {9002, "Discover-2 Situation Data"},
+  {9003, "Discover-2 Acoustic Prefix"},
+};
+
+static const char *
+name_of (unsigned short type, unsigned char subsystem)
+{
+  size_t k;
+
+  if (type == JSF_SONAR)
+    return subsystem == 0 ? "Sonar Data (subbottom)"
+      : subsystem == 20 ? "Sonar Data (low frequency sidescan)"
+      : subsystem == 21 ? "Sonar Data (high frequency sidescan)"
+      : "Sonar Data";
+  for (k = 0; k < sizeof (type_name) / sizeof (type_name[0]); k++)
+    if (type_name[k].type == type)
+      return type_name[k].name;
+  return "";
+}
+
+static int
+by_type (const void *a, const void *b)
+{
+  const Tally *x = (const Tally *) a, *y = (const Tally *) b;
+
+  if (x->type != y->type)
+    return x->type < y->type ? -1 : 1;
+  return x->subsystem < y->subsystem ? -1 : x->subsystem > y->subsystem;
+}
+
+/*
+ * List the messages of path.  Returns 0, or -1 if it could not be read
+ * to the end.
+ */
+
+static int
+inventory (const char *path, int mode)
+{
+  Tally tally[NTYPES + 1];	/* the last one for any more */
+  JSFReader r;
+  JSFMessage m;
+  unsigned long long bytes = 0;
+  unsigned long messages = 0;
+  int ntally = 0, bad = 0, k, ret;
+
+  if (jsf_open (&r, path, mode) == -1)
+    {
+      perror (path);
+      return -1;
+    }
+  memset (tally, 0, sizeof (tally));
+  m.offset = 0;
+  while ((ret = jsf_next (&r, &m)) == 1)
+    {
+      if (ld_le16 (m.hdr) != JSF_MARKER)
+	{
+	  fprintf (stderr, "%s: no message marker at byte %lld\n", path,
+		   (long long) m.offset);
+	  ret = -1;
+	  bad = 1;
+	  break;
+	}
+      for (k = 0; k < ntally; k++)
+	if (tally[k].type == m.type && tally[k].subsystem == m.subsystem)
+	  break;
+      if (k == ntally && ntally < NTYPES)
+	{
+	  tally[k].type = m.type;
+	  tally[k].subsystem = m.subsystem;
+	  ntally++;
+	}
+      tally[k].messages++;
+      tally[k].bytes += JSF_MSGHDRLEN + (unsigned long long) m.size;
+      messages++;
+      bytes += JSF_MSGHDRLEN + (unsigned long long) m.size;
+    }
+  if (ret == -1 && !bad)
+    fprintf (stderr, "%s: cannot read the message header at byte %lld\n",
+	     path, (long long) m.offset);
+  jsf_close (&r);
+
+  qsort (tally, (size_t) ntally, sizeof (Tally), by_type);
+  fprintf (stdout, "%s: %lu messages, %llu bytes\n", path, messages, bytes);
+  fprintf (stdout, "  %5s %4s %12s %16s  %s\n", "type", "sub", "messages",
+	   "bytes", "name");
+  for (k = 0; k < ntally; k++)
+    fprintf (stdout, "  %5u %4u %12lu %16llu  %s\n", tally[k].type,
+	     tally[k].subsystem, tally[k].messages, tally[k].bytes,
+	     name_of (tally[k].type, tally[k].subsystem));
+  if (tally[NTYPES].messages)
+    fprintf (stdout, "  %10s %12lu %16llu\n", "others",
+	     tally[NTYPES].messages, tally[NTYPES].bytes);
+  return ret == -1 ? -1 : 0;
+}
+
+static void
+usage (const char *prog)
+{
+  fprintf (stderr,
+	   "Usage: %s [-r] file.jsf ...\n"
+	   "\tLists the message types of each file, with their counts\n"
+	   "\t-r read() the message headers instead of mapping the file\n",
+	   prog);
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int mode = JSF_MMAP, opt, k, status = EXIT_SUCCESS;
+
+  while ((opt = getopt (argc, argv, "r")) != -1)
+    {
+      switch (opt)
+	{
+	case 'r':
+	  mode = JSF_READ;
+	  break;
+	default:
+	  usage (argv[0]);
+	}
+    }
+  if (optind >= argc)
+    usage (argv[0]);
+  for (k = optind; k < argc; k++)
+    if (inventory (argv[k], mode) == -1)
+      status = EXIT_FAILURE;
+  exit (status);
+}
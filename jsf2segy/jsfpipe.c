@@ -0,0 +1,227 @@
+/*
+ * jsfpipe.c
+ *
+ * Reader / converter pool / ordered writer pipeline.  See jsfpipe.h.
+ *
+ * Slots form a ring indexed by submission sequence number.  One mutex
+ * and one condition variable guard the three counters:
+ *
+ *   seq_read	next slot the reader will submit
+ *   seq_conv	next slot a worker will take
+ *   seq_write	next slot the writer will write
+ *
+ * seq_write <= seq_conv <= seq_read always holds.  A slot is FREE until
+ * submitted, FULL until converted and DONE until written.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "jsfpipe.h"
+
+#define SLOT_FREE	0
+#define SLOT_FULL	1
+#define SLOT_DONE	2
+
+#define SLOT(pp, seq) ((pp)->slots + ((seq) % (pp)->nslots) * (pp)->slot_size)
+#define STATE(pp, seq) (pp)->state[(seq) % (pp)->nslots]
+
+static void *
+worker_main (void *arg)
+{
+  JSFPipe *pp = (JSFPipe *) arg;
+  unsigned long seq;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pp->lock);
+      while (pp->seq_conv == pp->seq_read && !pp->finished)
+	pthread_cond_wait (&pp->cond, &pp->lock);
+      if (pp->seq_conv == pp->seq_read)
+	{
+	  pthread_mutex_unlock (&pp->lock);
+	  return NULL;
+	}
+      seq = pp->seq_conv++;
+      pthread_cond_broadcast (&pp->cond);	/* room for the reader */
+      pthread_mutex_unlock (&pp->lock);
+
+      pp->convert (pp->arg, SLOT (pp, seq));
+
+      pthread_mutex_lock (&pp->lock);
+      STATE (pp, seq) = SLOT_DONE;
+      pthread_cond_broadcast (&pp->cond);
+      pthread_mutex_unlock (&pp->lock);
+    }
+}
+
+static void *
+writer_main (void *arg)
+{
+  JSFPipe *pp = (JSFPipe *) arg;
+  unsigned long seq;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pp->lock);
+      for (;;)
+	{
+	  seq = pp->seq_write;
+	  if (seq < pp->seq_read && STATE (pp, seq) == SLOT_DONE)
+	    break;
+	  if (seq == pp->seq_read && pp->finished)
+	    {
+	      pthread_mutex_unlock (&pp->lock);
+	      return NULL;
+	    }
+	  pthread_cond_wait (&pp->cond, &pp->lock);
+	}
+      pthread_mutex_unlock (&pp->lock);
+
+      pp->write (pp->arg, SLOT (pp, seq));
+
+      pthread_mutex_lock (&pp->lock);
+      STATE (pp, seq) = SLOT_FREE;
+      pp->seq_write++;
+      pthread_cond_broadcast (&pp->cond);
+      pthread_mutex_unlock (&pp->lock);
+    }
+}
+
+/*
+ * Returns 0, or -1 if the slots or threads cannot be had.  pipe_free()
+ * cleans up either way.
+ */
+
+int
+pipe_start (JSFPipe * pp, size_t slot_size, int workers, int conv_depth,
+	    int write_depth, pipe_fn convert, pipe_fn write, void *arg)
+{
+  int k;
+
+  memset (pp, 0, sizeof (*pp));
+  if (workers < 0)
+    workers = 0;
+  if (conv_depth < 1)
+    conv_depth = 1;
+  if (write_depth < 1)
+    write_depth = 1;
+
+  pp->slot_size = slot_size;
+  pp->conv_depth = conv_depth;
+  pp->nslots = workers ? conv_depth + write_depth : 1;
+  pp->convert = convert;
+  pp->write = write;
+  pp->arg = arg;
+  pp->slots = (unsigned char *) calloc ((size_t) pp->nslots, slot_size);
+  pp->state = (int *) calloc ((size_t) pp->nslots, sizeof (int));
+  if (pp->slots == NULL || pp->state == NULL)
+    return -1;
+  if (!workers)
+    return 0;
+
+  pthread_mutex_init (&pp->lock, NULL);
+  pthread_cond_init (&pp->cond, NULL);
+  pp->started = 1;
+
+  if ((pp->pool = (pthread_t *) calloc ((size_t) workers,
+					sizeof (pthread_t))) == NULL)
+    return -1;
+  if (pthread_create (&pp->writer, NULL, writer_main, pp) != 0)
+    return -1;
+  pp->started = 2;
+  for (k = 0; k < workers; k++)
+    {
+      if (pthread_create (&pp->pool[k], NULL, worker_main, pp) != 0)
+	return -1;
+      pp->workers++;
+    }
+  return 0;
+}
+
+/*
+ * Reader: wait for the next free slot.
+ */
+
+void *
+pipe_next (JSFPipe * pp)
+{
+  unsigned long seq = pp->seq_read;
+
+  if (!pp->workers)
+    return SLOT (pp, seq);
+
+  pthread_mutex_lock (&pp->lock);
+  while (STATE (pp, seq) != SLOT_FREE
+	 || seq - pp->seq_conv >= (unsigned long) pp->conv_depth)
+    pthread_cond_wait (&pp->cond, &pp->lock);
+  pthread_mutex_unlock (&pp->lock);
+  return SLOT (pp, seq);
+}
+
+/*
+ * Reader: hand the slot from pipe_next() to the workers.
+ */
+
+void
+pipe_submit (JSFPipe * pp)
+{
+  unsigned long seq = pp->seq_read;
+
+  if (!pp->workers)
+    {
+      pp->convert (pp->arg, SLOT (pp, seq));
+      pp->write (pp->arg, SLOT (pp, seq));
+      pp->seq_read = pp->seq_conv = ++pp->seq_write;
+      return;
+    }
+
+  pthread_mutex_lock (&pp->lock);
+  STATE (pp, seq) = SLOT_FULL;
+  pp->seq_read++;
+  pthread_cond_broadcast (&pp->cond);
+  pthread_mutex_unlock (&pp->lock);
+}
+
+/*
+ * Reader: no more slots.  Returns once everything submitted is written.
+ */
+
+void
+pipe_finish (JSFPipe * pp)
+{
+  int k;
+
+  if (pp->started < 2)
+    return;
+
+  pthread_mutex_lock (&pp->lock);
+  pp->finished = 1;
+  pthread_cond_broadcast (&pp->cond);
+  pthread_mutex_unlock (&pp->lock);
+
+  for (k = 0; k < pp->workers; k++)
+    pthread_join (pp->pool[k], NULL);
+  pthread_join (pp->writer, NULL);
+  pp->started = 1;
+}
+
+void
+pipe_free (JSFPipe * pp, pipe_fn release)
+{
+  int k;
+
+  pipe_finish (pp);
+  if (pp->slots != NULL && release != NULL)
+    for (k = 0; k < pp->nslots; k++)
+      release (pp->arg, pp->slots + (size_t) k * pp->slot_size);
+  if (pp->started)
+    {
+      pthread_mutex_destroy (&pp->lock);
+      pthread_cond_destroy (&pp->cond);
+    }
+  free (pp->pool);
+  free (pp->slots);
+  free (pp->state);
+  memset (pp, 0, sizeof (*pp));
+}
@@ -0,0 +1,62 @@
+/*
+ * jsfpipe.h
+ *
+ * Reader / converter pool / ordered writer pipeline.
+ *
+ * The caller's thread is the reader: it takes a free slot with
+ * pipe_next(), fills it and hands it on with pipe_submit().  A pool of
+ * worker threads runs the convert function on submitted slots, and a
+ * single writer thread runs the write function on converted slots in
+ * the order they were submitted.  Slots are reused, so anything a slot
+ * allocates for itself (buffers) persists from one use to the next.
+ *
+ * At most conv_depth slots wait for a worker and the ring holds
+ * conv_depth + write_depth slots in all, which bounds how far the writer
+ * may fall behind.  With no workers everything runs in the caller's
+ * thread, inside pipe_submit(), in submission order.
+ *
+ * Each conversion has its own JSFPipe, so several can run at once.  The
+ * arg given to pipe_start() is passed to convert and write with every
+ * slot; pipe_free() hands each slot to release before freeing the ring.
+ */
+
+#ifndef _JSFPIPE_H_
+#define _JSFPIPE_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+typedef void (*pipe_fn) (void *arg, void *slot);
+
+typedef struct
+{
+  unsigned char *slots;
+  int *state;
+  size_t slot_size;
+  int nslots;
+  int conv_depth;
+  int workers;
+  int started;			/* threads running */
+  pipe_fn convert;
+  pipe_fn write;
+  void *arg;
+
+  unsigned long seq_read;	/* next slot the reader will submit */
+  unsigned long seq_conv;	/* next slot a worker will take */
+  unsigned long seq_write;	/* next slot the writer will write */
+  int finished;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t writer;
+  pthread_t *pool;
+} JSFPipe;
+
+int pipe_start (JSFPipe * pp, size_t slot_size, int workers, int conv_depth,
+		int write_depth, pipe_fn convert, pipe_fn write, void *arg);
+void *pipe_next (JSFPipe * pp);
+void pipe_submit (JSFPipe * pp);
+void pipe_finish (JSFPipe * pp);
+void pipe_free (JSFPipe * pp, pipe_fn release);
+
+#endif /* _JSFPIPE_H_ */
@@ -0,0 +1,510 @@
+/*
+ * jsfread.c
+ *
+ * JSF message reader with read(), mmap(), stream and io_uring backends.
+ * See jsfread.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include "byteio.h"
+#include "jsfread.h"
+#include "jsfuring.h"
+
+/*
+ * read() until n bytes or end of file.  Returns the byte count, -1 on error.
+ */
+
+static ssize_t
+read_full (int fd, unsigned char *buf, size_t n)
+{
+  size_t got = 0;
+  ssize_t k;
+
+  while (got < n)
+    {
+      k = read (fd, buf + got, n - got);
+      if (k == 0)
+	break;
+      if (k < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      got += (size_t) k;
+    }
+  return (ssize_t) got;
+}
+
+/*
+ * jsf_follow(): wait until the file is longer than have bytes.  Returns
+ * 1 to read again, 0 once told to stop or idle too long.
+ */
+
+static int
+wait_growth (JSFReader * r, off_t have)
+{
+  struct pollfd pfd;
+  struct stat st;
+  char ev[4096];
+  int waited = 0, slice, n;
+
+  if (r->caught_up != NULL)
+    r->caught_up (r->caught_up_arg);
+
+  pfd.fd = r->ifd;
+  pfd.events = POLLIN;
+  for (;;)
+    {
+      if (fstat (r->fd, &st) == 0 && st.st_size > have)
+	return 1;
+      if (r->stop != NULL && *r->stop)
+	break;
+      if (r->idle_ms > 0 && waited >= r->idle_ms)
+	break;
+      slice = 1000;
+      if (r->idle_ms > 0 && r->idle_ms - waited < slice)
+	slice = r->idle_ms - waited;
+      if ((n = poll (&pfd, r->ifd == -1 ? 0 : 1, slice)) > 0)
+	{
+	  (void) read (r->ifd, ev, sizeof (ev));	/* drain the events */
+	  waited = 0;
+	}
+      else if (n == 0)
+	waited += slice;
+      else if (errno != EINTR)
+	break;
+    }
+  r->stopped = 1;
+  return 0;
+}
+
+/*
+ * read_full(), waiting for more of the file with jsf_follow()
+ */
+
+static ssize_t
+read_more (JSFReader * r, unsigned char *buf, size_t n)
+{
+  size_t got = 0;
+  ssize_t k;
+
+  for (;;)
+    {
+      if ((k = read_full (r->fd, buf + got, n - got)) == -1)
+	return -1;
+      got += (size_t) k;
+      if (got == n || !r->follow || r->stopped
+	  || wait_growth (r, r->pos + (off_t) got) == 0)
+	return (ssize_t) got;
+    }
+}
+
+static int
+map_file (JSFReader * r)
+{
+  struct stat st;
+
+  if (fstat (r->fd, &st) == -1)
+    return -1;
+  r->map_len = (size_t) st.st_size;
+  if (r->map_len == 0)
+    return 0;			/* nothing to map, jsf_next() sees EOF */
+
+  r->map = (unsigned char *) mmap (NULL, r->map_len, PROT_READ, MAP_PRIVATE,
+				   r->fd, 0);
+  if (r->map == MAP_FAILED)
+    {
+      r->map = NULL;
+      return -1;
+    }
+
+  /*
+   * Hints only: a failure here costs nothing but speed.
+   */
+
+  (void) madvise (r->map, r->map_len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  (void) madvise (r->map, r->map_len, MADV_HUGEPAGE);
+#endif
+  return 0;
+}
+
+int
+jsf_open (JSFReader * r, const char *path, int mode)
+{
+  int fd;
+
+  if (strcmp (path, "-") == 0)
+    return jsf_fdopen (r, STDIN_FILENO, JSF_STREAM);
+  if ((fd = open (path, O_RDONLY)) == -1)
+    return -1;
+  if (jsf_fdopen (r, fd, mode) == -1)
+    {
+      close (fd);
+      return -1;
+    }
+  return 0;
+}
+
+/*
+ * Read fd, which jsf_close() closes (unless it is standard input).  On
+ * failure fd is left open.
+ */
+
+int
+jsf_fdopen (JSFReader * r, int fd, int mode)
+{
+  memset (r, 0, sizeof (*r));
+  r->ifd = -1;
+  r->fd = fd;
+  if (mode != JSF_STREAM && lseek (fd, 0, SEEK_CUR) == -1 && errno == ESPIPE)
+    mode = JSF_STREAM;		/* a named pipe or the like */
+  r->mode = mode == JSF_URING ? JSF_READ : mode;
+  if (mode == JSF_MMAP && map_file (r) == -1)
+    {
+      r->fd = -1;
+      return -1;
+    }
+  if (mode == JSF_URING)
+    (void) jsf_uring (r, 0, 0);	/* or stay with read() */
+  return 0;
+}
+
+/*
+ * Read r, open with JSF_READ, through io_uring from where it is: depth
+ * reads of bufsize bytes in flight, 0 for the defaults.  A stream stays
+ * a stream.  Returns -1, r left as it was, if io_uring is not to be had.
+ */
+
+int
+jsf_uring (JSFReader * r, int depth, size_t bufsize)
+{
+  if (r->mode == JSF_STREAM)
+    return 0;
+  if (r->mode != JSF_READ || r->follow)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  if ((r->uring = uring_open (r->fd, r->pos, depth, bufsize)) == NULL)
+    return -1;
+  r->mode = JSF_URING;
+  return 0;
+}
+
+/*
+ * Step to the next message header, skipping whatever is left of the
+ * current payload.  Returns 1 with m filled in, 0 at a clean end of
+ * file and -1 on a short header or an error.
+ */
+
+int
+jsf_next (JSFReader * r, JSFMessage * m)
+{
+  const unsigned char *hdr;
+  struct stat st;
+  ssize_t got;
+  off_t pos;
+
+  if (jsf_skip (r) == -1)
+    return -1;
+
+  m->offset = r->pos;
+  m->payload = NULL;
+  m->viewed = 0;
+  if (r->mode == JSF_MMAP)
+    {
+      if ((size_t) r->pos >= r->map_len)
+	return 0;
+      if (r->map_len - (size_t) r->pos < JSF_MSGHDRLEN)
+	return -1;
+      hdr = r->map + r->pos;
+    }
+  else if (r->mode == JSF_URING)
+    {
+      /*
+       * The views of the last message go, and with them the buffers
+       * the parser is done with
+       */
+
+      pos = r->pos;
+      if (uring_release (r->uring, pos) == -1
+	  || (got = uring_get (r->uring, pos, JSF_MSGHDRLEN, &hdr,
+			       r->hdr)) == -1)
+	return -1;
+      if (got == 0)
+	return 0;
+      if (got != JSF_MSGHDRLEN)
+	return -1;
+    }
+  else
+    {
+      got = read_more (r, r->hdr, JSF_MSGHDRLEN);
+      if (got == 0 || (got < JSF_MSGHDRLEN && r->stopped))
+	return 0;
+      if (got != JSF_MSGHDRLEN)
+	return -1;
+      hdr = r->hdr;
+    }
+  r->pos += JSF_MSGHDRLEN;
+
+  m->hdr = hdr;
+  m->type = ld_le16 (hdr + 4);
+  m->subsystem = hdr[7];
+  m->channel = hdr[8];
+  m->size = (size_t) ld_le32 (hdr + 12);
+
+  r->size = m->size;
+  r->used = 0;
+
+  /*
+   * jsf_follow(): hand out only whole messages, so that the waiting is
+   * done here, between messages
+   */
+
+  if (r->follow && !r->stopped)
+    while (fstat (r->fd, &st) == 0 && st.st_size < r->pos + (off_t) r->size)
+      if (wait_growth (r, st.st_size) == 0)
+	return 0;
+  return 1;
+}
+
+/*
+ * jsf_next(), with a view of as much of the payload as peek asks for
+ * (all of it without peek).  Returns as jsf_next(), and -1 if the view
+ * runs past the end of the file.
+ */
+
+int
+jsf_iter (JSFReader * r, JSFMessage * m, jsf_peek_fn peek, void *arg)
+{
+  size_t n;
+  int ret;
+
+  if ((ret = jsf_next (r, m)) != 1)
+    return ret;
+  n = peek != NULL ? peek (m, arg) : JSF_ALL;
+  if (n > m->size)
+    n = m->size;
+  if (n > 0 && (m->payload = jsf_read (r, n)) == NULL)
+    return -1;
+  m->viewed = n;
+  return 1;
+}
+
+/*
+ * Return the next n bytes of the current payload, or NULL if the file
+ * ends first or n runs past the payload size.
+ */
+
+const unsigned char *
+jsf_read (JSFReader * r, size_t n)
+{
+  const unsigned char *p;
+  unsigned char *nbuf;
+
+  if (n > r->size - r->used)
+    return NULL;
+
+  if (r->mode == JSF_MMAP)
+    {
+      if ((size_t) r->pos + n > r->map_len)
+	return NULL;
+      p = r->map + r->pos;
+    }
+  else
+    {
+      /*
+       * Size the buffer for the whole payload on the first read so that
+       * pointers already handed out for this message stay put.  With
+       * JSF_URING it takes what spans buffers of the pool.
+       */
+
+      if (r->size > r->bufsize)
+	{
+	  if ((nbuf = (unsigned char *) realloc (r->buf, r->size)) == NULL)
+	    return NULL;
+	  r->buf = nbuf;
+	  r->bufsize = r->size;
+	}
+      if (r->mode == JSF_URING)
+	{
+	  if (uring_get (r->uring, r->pos, n, &p, r->buf + r->used) !=
+	      (ssize_t) n)
+	    return NULL;
+	}
+      else if (read_more (r, r->buf + r->used, n) != (ssize_t) n)
+	return NULL;
+      else
+	p = r->buf + r->used;
+    }
+  r->pos += (off_t) n;
+  r->used += n;
+  return p;
+}
+
+/*
+ * Like jsf_read(), but with JSF_READ the bytes go to dst (which must
+ * hold n bytes) instead of the reader's buffer.
+ */
+
+const unsigned char *
+jsf_read_into (JSFReader * r, size_t n, unsigned char *dst)
+{
+  const unsigned char *p = dst;
+
+  if (r->mode == JSF_MMAP)
+    return jsf_read (r, n);
+
+  if (n > r->size - r->used)
+    return NULL;
+  if (r->mode == JSF_URING)
+    {
+      if (uring_get (r->uring, r->pos, n, &p, dst) != (ssize_t) n)
+	return NULL;
+      if (p != dst)
+	memcpy (dst, p, n);	/* dst must outlive the buffer */
+    }
+  else if (read_more (r, dst, n) != (ssize_t) n)
+    return NULL;
+  r->pos += (off_t) n;
+  r->used += n;
+  return dst;
+}
+
+/*
+ * JSF_STREAM: read the rest of the current payload into the scratch
+ * buffer and drop it.  A payload cut short by the end of the stream is
+ * not an error here; the next jsf_next() sees the end.
+ */
+
+static int
+skip_stream (JSFReader * r)
+{
+  size_t rest = r->size - r->used, n;
+  ssize_t got;
+
+  if (r->scratch == NULL
+      && (r->scratch = (unsigned char *) malloc (JSF_SCRATCH)) == NULL)
+    return -1;
+  while (rest > 0)
+    {
+      n = rest < JSF_SCRATCH ? rest : JSF_SCRATCH;
+      if ((got = read_more (r, r->scratch, n)) == -1)
+	return -1;
+      r->pos += got;
+      rest -= (size_t) got;
+      if ((size_t) got < n)
+	break;
+    }
+  r->used = r->size;
+  return 0;
+}
+
+/*
+ * Pass over the rest of the current payload.
+ */
+
+int
+jsf_skip (JSFReader * r)
+{
+  off_t rest = (off_t) (r->size - r->used);
+
+  if (rest == 0)
+    return 0;
+  if (r->mode == JSF_STREAM)
+    return skip_stream (r);
+  if (r->mode == JSF_READ && lseek (r->fd, rest, SEEK_CUR) == -1)
+    return -1;
+  r->pos += rest;
+  r->used = r->size;
+  return 0;
+}
+
+/*
+ * Position the reader at the message header at offset.
+ */
+
+int
+jsf_seek (JSFReader * r, off_t offset)
+{
+  if (r->mode == JSF_STREAM)
+    {
+      errno = ESPIPE;
+      return -1;
+    }
+  if (r->mode == JSF_READ && lseek (r->fd, offset, SEEK_SET) == -1)
+    return -1;
+  if (r->mode == JSF_URING && uring_seek (r->uring, offset) == -1)
+    return -1;
+  r->pos = offset;
+  r->size = r->used = 0;
+  return 0;
+}
+
+/*
+ * Follow path, open in r, as it grows.  See jsfread.h.  Not for mapped
+ * files or io_uring read-ahead, which go by the size at the start; a
+ * stream follows by itself.
+ */
+
+int
+jsf_follow (JSFReader * r, const char *path, int idle,
+	    volatile sig_atomic_t * stop, void (*caught_up) (void *arg),
+	    void *arg)
+{
+  if (r->mode == JSF_MMAP || r->mode == JSF_URING)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  if (r->mode == JSF_STREAM)
+    return 0;
+  r->follow = 1;
+  r->idle_ms = idle * 1000;
+  r->stop = stop;
+  r->caught_up = caught_up;
+  r->caught_up_arg = arg;
+
+  /*
+   * Without inotify (or a watch) growth is still seen by stat()
+   */
+
+  if ((r->ifd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC)) != -1
+      && inotify_add_watch (r->ifd, path, IN_MODIFY) == -1)
+    {
+      close (r->ifd);
+      r->ifd = -1;
+    }
+  return 0;
+}
+
+void
+jsf_close (JSFReader * r)
+{
+  if (r->ifd != -1)
+    close (r->ifd);
+  r->ifd = -1;
+  if (r->map != NULL)
+    munmap (r->map, r->map_len);
+  uring_close (r->uring);
+  if (r->fd != -1 && r->fd != STDIN_FILENO)
+    close (r->fd);
+  free (r->buf);
+  free (r->scratch);
+  r->map = NULL;
+  r->buf = NULL;
+  r->scratch = NULL;
+  r->uring = NULL;
+  r->fd = -1;
+}
@@ -0,0 +1,144 @@
+/*
+ * jsfread.h
+ *
+ * JSF message reader.  A JSF file is a sequence of messages, each a 16
+ * byte header followed by a payload whose size is at header offset 12.
+ *
+ * jsf_next() steps to the next message header, jsf_read() returns the
+ * next n bytes of the current payload and jsf_skip() passes over what is
+ * left of it.  With JSF_READ the header and payload bytes are read()
+ * into buffers owned by the reader; with JSF_MMAP the file is mapped and
+ * the pointers returned are views into the mapping, so nothing is copied
+ * and skipping a message costs no system call.
+ *
+ * jsf_read_into() is jsf_read() for bytes that must outlive the next
+ * message: with JSF_READ they are read straight into the caller's dst
+ * (with JSF_URING copied there from the buffer pool), with JSF_MMAP the
+ * view into the mapping is returned as before.
+ *
+ * jsf_iter() is an iterator over messages as views: it steps to the next
+ * message and points m->payload at the first bytes of its payload, as
+ * many as the caller's peek function asks for from the message header
+ * (JSF_ALL for all of them, 0 for none), leaving the rest to be skipped.
+ * With JSF_MMAP the view is into the mapping and nothing is read at all;
+ * otherwise it is just the bytes asked for, in the reader's buffer.  A
+ * tool that needs a few fields of some messages pays for those alone.
+ *
+ * jsf_fdopen() reads a descriptor already open, a pipe from a
+ * decompressor or a socket for instance, with any of the backends it
+ * can take: one that cannot seek is read as a stream.
+ *
+ * JSF_URING reads through io_uring (jsfuring.h): a pool of registered
+ * buffers is kept depth reads ahead of the parser, so the device stays
+ * busy while samples are converted and a store with high latency per
+ * request is read at its throughput.  Payloads that lie in one buffer
+ * are views into it, as with JSF_MMAP; those spanning buffers are copied
+ * out as with JSF_READ.  jsf_uring() switches a reader opened with
+ * JSF_READ to it with a given depth and read size; opening with
+ * JSF_URING takes the defaults.  Where io_uring is not to be had the
+ * reader stays with JSF_READ.  Not with jsf_follow().
+ *
+ * jsf_seek() repositions the reader at a message header found earlier,
+ * for instance through a message index (jsfidx.h).
+ *
+ * JSF_STREAM reads strictly forward, for pipes, decompressors and
+ * acquisition streams: payloads nobody wants are read and thrown away
+ * through a small scratch buffer instead of lseek()ed over, and
+ * jsf_seek() fails with ESPIPE.  The path "-" is standard input.  Either
+ * is read as a stream whatever mode is asked for, as is any input that
+ * cannot seek; r->mode tells which mode is in use.
+ *
+ * jsf_follow() is for a file still being written.  Where a read would
+ * come up short at the end of the file it waits for the file to grow
+ * (inotify, with a stat() each second as a fallback) and carries on, so
+ * a partly written message is waited for rather than failed; jsf_next()
+ * returns a message only once all of it is in the file.  Before
+ * each wait the caught_up callback is run.  Waiting ends when *stop is
+ * set or the file has not grown for idle seconds (0 waits for ever);
+ * r->stopped is then set and the reader ends as at the end of the file,
+ * dropping any partial message.
+ *
+ * Pointers returned by jsf_next() and jsf_read() stay valid until the
+ * next call to jsf_next().
+ */
+
+#ifndef _JSFREAD_H_
+#define _JSFREAD_H_
+
+#include <stddef.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#define JSF_MSGHDRLEN 16	/* length of the JSF message header */
+
+#define JSF_READ 0		/* read() and lseek() */
+#define JSF_MMAP 1		/* zero copy views into an mmap of the file */
+#define JSF_STREAM 2		/* forward only read(), no lseek() */
+#define JSF_URING 3		/* io_uring read-ahead into a buffer pool */
+
+#define JSF_ALL		((size_t) -1)	/* jsf_iter(): view all of a payload */
+
+#define JSF_SCRATCH	(64 * 1024)	/* JSF_STREAM: skip buffer */
+
+typedef struct
+{
+  const unsigned char *hdr;	/* 16 byte message header */
+  unsigned short type;		/* message type (80 sonar, 82 sidescan ...) */
+  unsigned char subsystem;	/* 0 subbottom, 20/21 sidescan ... */
+  unsigned char channel;	/* 0 port, 1 starboard */
+  size_t size;			/* payload bytes following the header */
+  off_t offset;			/* file offset of the header */
+  const unsigned char *payload;	/* jsf_iter(): view of the payload */
+  size_t viewed;		/* bytes of it, 0 if none */
+} JSFMessage;
+
+typedef struct
+{
+  int fd;
+  int mode;			/* JSF_READ, JSF_MMAP, JSF_STREAM or JSF_URING */
+  off_t pos;			/* file offset of the next unread byte */
+  size_t size;			/* payload size of the current message */
+  size_t used;			/* payload bytes already read or skipped */
+
+  unsigned char *map;		/* JSF_MMAP: the whole file */
+  size_t map_len;
+
+  unsigned char hdr[JSF_MSGHDRLEN];	/* JSF_READ: current header */
+  unsigned char *buf;		/* JSF_READ: current payload */
+  size_t bufsize;
+
+  unsigned char *scratch;	/* JSF_STREAM: payloads being skipped */
+
+  struct JSFUring *uring;	/* JSF_URING: read-ahead buffer pool */
+
+  int follow;			/* jsf_follow(): wait for the file to grow */
+  int stopped;			/* gave up waiting */
+  int ifd;			/* inotify instance */
+  int idle_ms;			/* give up after this long without growth */
+  volatile sig_atomic_t *stop;	/* give up when set */
+  void (*caught_up) (void *arg);
+  void *caught_up_arg;
+} JSFReader;
+
+/*
+ * jsf_iter() peek function: payload bytes to view of message m
+ */
+
+typedef size_t (*jsf_peek_fn) (const JSFMessage * m, void *arg);
+
+int jsf_open (JSFReader * r, const char *path, int mode);
+int jsf_fdopen (JSFReader * r, int fd, int mode);
+int jsf_next (JSFReader * r, JSFMessage * m);
+int jsf_iter (JSFReader * r, JSFMessage * m, jsf_peek_fn peek, void *arg);
+const unsigned char *jsf_read (JSFReader * r, size_t n);
+const unsigned char *jsf_read_into (JSFReader * r, size_t n,
+				    unsigned char *dst);
+int jsf_skip (JSFReader * r);
+int jsf_seek (JSFReader * r, off_t offset);
+int jsf_uring (JSFReader * r, int depth, size_t bufsize);
+int jsf_follow (JSFReader * r, const char *path, int idle,
+		volatile sig_atomic_t * stop, void (*caught_up) (void *arg),
+		void *arg);
+void jsf_close (JSFReader * r);
+
+#endif /* _JSFREAD_H_ */
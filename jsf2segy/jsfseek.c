@@ -0,0 +1,295 @@
+/*
+ * jsfseek.c
+ *
+ * Bisection over a JSF file for the first ping of a range.  See
+ * jsfseek.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "byteio.h"
+#include "jsfread.h"
+#include "jsfseek.h"
+
+#define SONAR_MSG	80	/* subbottom and sidescan sonar data */
+#define SUBBOTTOM	0	/* its subsystem for subbottom pings */
+#define MAX_MSG		(256 * 1024 * 1024)	/* larger sizes are noise */
+#define SCAN_BLOCK	(64 * 1024)	/* marker search read size */
+
+/*
+ * Key of a ping from the first JSFSEEK_PEEK bytes of its sonar header
+ */
+
+int64_t
+jsfseek_key (const unsigned char *sonar, int by)
+{
+  struct tm tm;
+  int64_t sec;
+
+  if (by == JSFSEEK_PING)
+    return (int64_t) ld_le32 (sonar + 8);
+  sec = (int64_t) ld_le32 (sonar);
+  if (sec == 0)
+    {
+      memset (&tm, 0, sizeof (tm));
+      tm.tm_year = (short) ld_le16 (sonar + 198) - 1900;
+      tm.tm_mday = (short) ld_le16 (sonar + 196);	/* day of the year */
+      tm.tm_hour = (short) ld_le16 (sonar + 186);
+      tm.tm_min = (short) ld_le16 (sonar + 188);
+      tm.tm_sec = (short) ld_le16 (sonar + 190);
+      sec = (int64_t) timegm (&tm);
+    }
+  return sec * 1000 + ld_le32 (sonar + 200) % 1000;
+}
+
+/*
+ * n bytes at offset at.  Returns 1, 0 if the file ends first, or -1.
+ */
+
+static int
+read_at (int fd, off_t at, void *buf, size_t n)
+{
+  size_t done = 0;
+  ssize_t got;
+
+  while (done < n)
+    {
+      got = pread (fd, (char *) buf + done, n - done, at + (off_t) done);
+      if (got == -1 && errno == EINTR)
+	continue;
+      if (got == -1)
+	return -1;
+      if (got == 0)
+	return 0;
+      done += (size_t) got;
+    }
+  return 1;
+}
+
+/*
+ * Is the marker at at a message header?  Its header goes in hdr.
+ * Returns 1 if it and the JSFSEEK_CHAIN messages after it chain by
+ * their sizes (the chain may run to the end of the file, but not past
+ * it: noise in sample data often has a size that does), 0 if not, -1
+ * on error.
+ */
+
+static int
+header_at (int fd, off_t end, off_t at, unsigned char *hdr)
+{
+  unsigned char h[JSF_MSGHDRLEN];
+  off_t next = at;
+  int k, r;
+
+  for (k = 0; k <= JSFSEEK_CHAIN; k++)
+    {
+      if (k > 0 && next >= end)
+	return next == end;
+      if (next + JSF_MSGHDRLEN > end)
+	return k > 0;
+      if ((r = read_at (fd, next, h, JSF_MSGHDRLEN)) != 1)
+	return r;
+      if (ld_le16 (h) != 0x1601 || ld_le32 (h + 12) > MAX_MSG)
+	return 0;
+      if (k == 0)
+	memcpy (hdr, h, JSF_MSGHDRLEN);
+      next += JSF_MSGHDRLEN + (off_t) ld_le32 (h + 12);
+    }
+  return 1;
+}
+
+/*
+ * First message header at or after from: its offset in *at and header
+ * in hdr.  Returns 1, 0 if there is none, or -1.
+ */
+
+static int
+sync_from (int fd, off_t end, off_t from, off_t * at, unsigned char *hdr)
+{
+  unsigned char buf[SCAN_BLOCK + 1];
+  off_t base;
+  size_t n, i;
+  int r;
+
+  for (base = from; base + 1 < end; base += SCAN_BLOCK)
+    {
+      n = end - base > SCAN_BLOCK + 1 ? SCAN_BLOCK + 1 : (size_t) (end - base);
+      if ((r = read_at (fd, base, buf, n)) != 1)
+	return r;
+      for (i = 0; i + 1 < n; i++)
+	if (buf[i] == 0x01 && buf[i + 1] == 0x16
+	    && (r = header_at (fd, end, base + (off_t) i, hdr)) != 0)
+	  {
+	    *at = base + (off_t) i;
+	    return r;
+	  }
+    }
+  return 0;
+}
+
+/*
+ * Offset of the first message header at or after from, the end of the
+ * file if there is none, or -1 on error.  For splitting a file into
+ * pieces that start on a message.
+ */
+
+off_t
+jsfseek_sync (int fd, off_t from)
+{
+  unsigned char hdr[JSF_MSGHDRLEN];
+  struct stat st;
+  off_t at;
+  int r;
+
+  if (fstat (fd, &st) == -1)
+    return -1;
+  if ((r = sync_from (fd, st.st_size, from, &at, hdr)) == -1)
+    return -1;
+  return r == 1 ? at : st.st_size;
+}
+
+/*
+ * From the message at *at (header in hdr), the first subbottom sonar
+ * data message: its offset in *at and key in *key.  Sidescan pings are
+ * passed over, their ping numbers counting apart from the subbottom's.
+ * Returns 1, 0 if the file ends first (*at is then where the last
+ * message, maybe partly written, starts), or -1.
+ */
+
+static int
+ping_from (int fd, off_t end, int by, off_t * at, unsigned char *hdr,
+	   int64_t * key)
+{
+  unsigned char sh[JSFSEEK_PEEK];
+  unsigned int type;
+  uint32_t size;
+  off_t next;
+  int r;
+
+  for (;;)
+    {
+      type = ld_le16 (hdr + 4);
+      size = ld_le32 (hdr + 12);
+      if (type == SONAR_MSG && hdr[7] == SUBBOTTOM && size >= JSFSEEK_PEEK)
+	{
+	  if ((r = read_at (fd, *at + JSF_MSGHDRLEN, sh, JSFSEEK_PEEK)) != 1)
+	    return r;
+	  *key = jsfseek_key (sh, by);
+	  return 1;
+	}
+      next = *at + JSF_MSGHDRLEN + (off_t) size;
+      if (next + JSF_MSGHDRLEN > end
+	  || (r = read_at (fd, next, hdr, JSF_MSGHDRLEN)) == 0)
+	{
+	  if (next <= end)
+	    *at = next;
+	  return 0;
+	}
+      if (r == -1)
+	return -1;
+      *at = next;
+      if (ld_le16 (hdr) != 0x1601
+	  && (r = sync_from (fd, end, next, at, hdr)) != 1)
+	return r;
+    }
+}
+
+/*
+ * Offset of the first message to read for the pings from target on in
+ * fd: that of the first subbottom sonar data message whose key is
+ * target or more, 0 if that is the first ping in the file, or if there
+ * is none, where the last message starts (the end of a complete file).
+ * Returns -1 on error.
+ */
+
+off_t
+jsfseek_find (int fd, int by, int64_t target)
+{
+  unsigned char hdr[JSF_MSGHDRLEN];
+  struct stat st;
+  off_t end, lo, hi, mid, at;
+  int64_t key;
+  int r;
+
+  if (fstat (fd, &st) == -1)
+    return -1;
+  end = st.st_size;
+
+  /*
+   * Every ping before lo is before the target
+   */
+
+  lo = 0;
+  hi = end;
+  while (hi - lo > JSFSEEK_LINEAR)
+    {
+      mid = lo + (hi - lo) / 2;
+      if ((r = sync_from (fd, end, mid, &at, hdr)) == 1)
+	r = ping_from (fd, end, by, &at, hdr, &key);
+      if (r == -1)
+	return -1;
+      if (r == 0 || at >= hi)
+	hi = mid;
+      else if (key < target)
+	lo = at + 1;
+      else
+	hi = at;
+    }
+
+  if ((r = sync_from (fd, end, lo, &at, hdr)) != 1)
+    return r == 0 ? end : -1;
+  while ((r = ping_from (fd, end, by, &at, hdr, &key)) == 1)
+    {
+      if (key >= target)
+	return lo == 0 ? 0 : at;
+      lo = at + 1;
+      at += JSF_MSGHDRLEN + (off_t) ld_le32 (hdr + 12);
+      if (at + JSF_MSGHDRLEN > end
+	  || (r = read_at (fd, at, hdr, JSF_MSGHDRLEN)) == 0)
+	return at;
+      if (r == -1)
+	return -1;
+      if (ld_le16 (hdr) != 0x1601
+	  && (r = sync_from (fd, end, at, &at, hdr)) != 1)
+	return r == 0 ? end : -1;
+    }
+  return r == 0 ? at : -1;
+}
+
+/*
+ * A --start or --end time: "YYYY-MM-DDTHH:MM:SS[.sss]" (or with a space
+ * for the T), UTC, or seconds since 1970.  Returns 0, or -1 if s is
+ * neither.
+ */
+
+int
+jsfseek_time (const char *s, int64_t * ms)
+{
+  struct tm tm;
+  double sec;
+  char *e;
+  int n = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  if (sscanf (s, "%d-%d-%d%*[T ]%d:%d:%lf%n", &tm.tm_year, &tm.tm_mon,
+	      &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &sec, &n) == 6
+      && s[n] == '\0' && sec >= 0.0 && sec < 61.0)
+    {
+      tm.tm_year -= 1900;
+      tm.tm_mon -= 1;
+      *ms = (int64_t) timegm (&tm) * 1000 + llrint (sec * 1000.0);
+      return 0;
+    }
+  sec = strtod (s, &e);
+  if (e == s || *e != '\0' || !(sec >= 0.0))
+    return -1;
+  *ms = llrint (sec * 1000.0);
+  return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * jsfseek.h
+ *
+ * Finding a ping in a JSF file without reading it from the start, for
+ * --start/--end and --first/--last.
+ *
+ * jsfseek_find() bisects the file by byte offset.  At each probe it
+ * resynchronises on the message stream: it looks forward for the 0x1601
+ * Start_Of_Message marker and takes a candidate for a message header
+ * only when the size chain holds, ie the JSFSEEK_CHAIN messages after it
+ * start with the marker too (or the file ends there), as sample data can
+ * hold the marker bytes.  From there it walks message headers to the
+ * next subbottom sonar data message (sidescan ping numbers run on
+ * their own) and compares its key, the ping time (sonar header bytes
+ * 0-3 and the milliseconds of 200-203, or the date and time fields in
+ * files without 0-3) or the ping number (bytes 8-11), with the target.
+ * Once the interval is under JSFSEEK_LINEAR bytes the rest is a walk
+ * over message headers.  Pings are taken to be in the order of both
+ * keys, as recorded.  A probe is a few pread()s, so the search costs
+ * the same in a file of any size.
+ *
+ * jsfseek_sync() is the resynchronisation on its own: the first message
+ * header at or after an offset, for --split to cut a file on message
+ * boundaries.
+ */
+
+#ifndef _JSFSEEK_H_
+#define _JSFSEEK_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define JSFSEEK_TIME	0	/* key: ping time, ms since 1970 */
+#define JSFSEEK_PING	1	/* key: ping number */
+
+#define JSFSEEK_LINEAR	(1024 * 1024)	/* bisect down to this, then walk */
+#define JSFSEEK_CHAIN	2	/* messages after a candidate to check */
+#define JSFSEEK_PEEK	204	/* sonar header bytes a key needs */
+
+int64_t jsfseek_key (const unsigned char *sonar, int by);
+off_t jsfseek_find (int fd, int by, int64_t target);
+off_t jsfseek_sync (int fd, off_t from);
+int jsfseek_time (const char *s, int64_t * ms);
+
+#endif /* _JSFSEEK_H_ */
@@ -0,0 +1,226 @@
+/*
+ * jsfstats.c
+ *
+ * Stage timing and counters of a conversion.  See jsfstats.h.
+ *
+ * A report line looks like
+ *
+ *   {<head>,"elapsed_s":12.5,"cpu_s":{"user":9.1,"system":2.0},
+ *    "bound":"input","stages":{"read":{"s":..,"calls":..,"bytes":..,
+ *    "MBps":..},...},"types":[{"type":80,"messages":..,"bytes":..,
+ *    "skipped":..},...]}
+ *
+ * CPU time is the process's, so in batch mode it covers every
+ * conversion running at the time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "jsfstats.h"
+
+static const char *stage_name[STAT_NSTAGE] = {
+  "read", "skip", "wait", "convert", "header", "write"
+};
+
+uint64_t
+stats_clock (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+void
+stats_init (JSFStats * s, int every)
+{
+  int k;
+
+  for (k = 0; k < STAT_NSTAGE; k++)
+    s->stage[k].ns = s->stage[k].calls = s->stage[k].bytes = 0;
+  s->ntype = 0;
+  s->type[STAT_TYPES].type = 0;
+  s->type[STAT_TYPES].messages = s->type[STAT_TYPES].bytes = 0;
+  s->type[STAT_TYPES].skipped = 0;
+  s->start = stats_clock ();
+  s->every = (uint64_t) every * 1000000000u;
+  s->next = s->start + s->every;
+}
+
+/*
+ * Charge the time since t0 and bytes to stage.  Returns the time now,
+ * the t0 of whatever is timed next.
+ */
+
+uint64_t
+stats_time (JSFStats * s, int stage, uint64_t t0, uint64_t bytes)
+{
+  StatStage *g = &s->stage[stage];
+  uint64_t t = stats_clock ();
+
+  __atomic_fetch_add (&g->ns, t - t0, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&g->calls, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&g->bytes, bytes, __ATOMIC_RELAXED);
+  return t;
+}
+
+/*
+ * Tally of a message type.  A file has a handful of types, so a short
+ * list searched from the front does; past STAT_TYPES of them the rest
+ * share the last entry.
+ */
+
+static StatType *
+type_of (JSFStats * s, unsigned int type)
+{
+  int k;
+
+  for (k = 0; k < s->ntype; k++)
+    if (s->type[k].type == type)
+      return &s->type[k];
+  if (s->ntype == STAT_TYPES)
+    return &s->type[STAT_TYPES];
+  s->type[k].type = type;
+  s->type[k].messages = s->type[k].bytes = s->type[k].skipped = 0;
+  s->ntype++;
+  return &s->type[k];
+}
+
+void
+stats_message (JSFStats * s, unsigned int type, uint64_t bytes)
+{
+  StatType *t = type_of (s, type);
+
+  t->messages++;
+  t->bytes += bytes;
+}
+
+void
+stats_skip (JSFStats * s, unsigned int type, uint64_t bytes)
+{
+  if (bytes)
+    type_of (s, type)->skipped += bytes;
+}
+
+/*
+ * Is a periodic report due at now?  If so the next is set up.
+ */
+
+int
+stats_due (JSFStats * s, uint64_t now)
+{
+  if (s->every == 0 || now < s->next)
+    return 0;
+  while (s->next <= now)
+    s->next += s->every;
+  return 1;
+}
+
+/*
+ * str as a JSON string
+ */
+
+void
+stats_string (FILE * f, const char *str)
+{
+  const unsigned char *c;
+
+  putc ('"', f);
+  for (c = (const unsigned char *) str; *c != '\0'; c++)
+    if (*c == '"' || *c == '\\')
+      fprintf (f, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf (f, "\\u%04x", *c);
+    else
+      putc (*c, f);
+  putc ('"', f);
+}
+
+static double
+seconds (uint64_t ns)
+{
+  return ns / 1e9;
+}
+
+/*
+ * One report line to out, head being the caller's members.  The line is
+ * put together in memory and written in one piece.  Returns -1 if it
+ * could not be.
+ */
+
+int
+stats_write (FILE * out, const JSFStats * s, const char *head, int workers)
+{
+  StatStage g[STAT_NSTAGE];
+  struct rusage ru;
+  const char *bound;
+  double in, conv, wr;
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *f;
+  int k;
+
+  if ((f = open_memstream (&buf, &len)) == NULL)
+    return -1;
+  for (k = 0; k < STAT_NSTAGE; k++)
+    {
+      g[k].ns = __atomic_load_n (&s->stage[k].ns, __ATOMIC_RELAXED);
+      g[k].calls = __atomic_load_n (&s->stage[k].calls, __ATOMIC_RELAXED);
+      g[k].bytes = __atomic_load_n (&s->stage[k].bytes, __ATOMIC_RELAXED);
+    }
+
+  /*
+   * What held the run up: reading the input, converting (spread over
+   * the converter threads) or writing the output
+   */
+
+  in = seconds (g[STAT_READ].ns + g[STAT_SKIP].ns);
+  conv = seconds (g[STAT_CONVERT].ns + g[STAT_HEADER].ns)
+    / (workers > 1 ? workers : 1);
+  wr = seconds (g[STAT_WRITE].ns);
+  bound = in >= conv && in >= wr ? "input" : conv >= wr ? "convert" : "output";
+
+  fprintf (f, "{%s,\"elapsed_s\":%.6f", head,
+	   seconds (stats_clock () - s->start));
+  if (getrusage (RUSAGE_SELF, &ru) == 0)
+    fprintf (f, ",\"cpu_s\":{\"user\":%.6f,\"system\":%.6f}",
+	     ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+	     ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+  fprintf (f, ",\"bound\":\"%s\",\"stages\":{", bound);
+  for (k = 0; k < STAT_NSTAGE; k++)
+    fprintf (f, "%s\"%s\":{\"s\":%.6f,\"calls\":%llu,\"bytes\":%llu,"
+	     "\"MBps\":%.1f}", k ? "," : "", stage_name[k], seconds (g[k].ns),
+	     (unsigned long long) g[k].calls, (unsigned long long) g[k].bytes,
+	     g[k].ns ? g[k].bytes * 1e3 / g[k].ns : 0.0);
+  fprintf (f, "},\"types\":[");
+  for (k = 0; k <= s->ntype; k++)
+    {
+      if (k == s->ntype && s->ntype < STAT_TYPES)
+	break;
+      fprintf (f, "%s{\"type\":", k ? "," : "");
+      if (k == STAT_TYPES)
+	fprintf (f, "\"other\"");
+      else
+	fprintf (f, "%u", s->type[k].type);
+      fprintf (f, ",\"messages\":%llu,\"bytes\":%llu,\"skipped\":%llu}",
+	       (unsigned long long) s->type[k].messages,
+	       (unsigned long long) s->type[k].bytes,
+	       (unsigned long long) s->type[k].skipped);
+    }
+  fprintf (f, "]}\n");
+  if (fclose (f) != 0)
+    {
+      free (buf);
+      return -1;
+    }
+
+  flockfile (out);
+  fwrite (buf, 1, len, out);
+  fflush (out);
+  funlockfile (out);
+  free (buf);
+  return ferror (out) ? -1 : 0;
+}
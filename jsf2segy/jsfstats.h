@@ -0,0 +1,72 @@
+/*
+ * jsfstats.h
+ *
+ * Stage timing and counters of a conversion, for --stats.
+ *
+ * Each stage of the pipeline adds the time it spent, the number of
+ * times it ran and the bytes it handled to its own counters: the reader
+ * (message and payload reads, skipping unwanted payloads and index
+ * seeks, waiting for a free slot), the converters (samples, trace
+ * headers) and the writer.  Times come from CLOCK_MONOTONIC, which on
+ * Linux reads the TSC through the vDSO without a system call, and are
+ * only taken when --stats is given.  The stage counters are added to
+ * with relaxed atomics, as the converters run on several threads; the
+ * per message type tallies belong to the reader alone.
+ *
+ * stats_write() puts out one JSON object per line: the caller's own
+ * members, then the elapsed and CPU time, the stages and the message
+ * types.  Several conversions may write to the same stream at once.
+ */
+
+#ifndef _JSFSTATS_H_
+#define _JSFSTATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define STAT_READ	0	/* reader: message headers, trace headers, samples */
+#define STAT_SKIP	1	/* reader: unwanted payloads, index seeks */
+#define STAT_WAIT	2	/* reader: waiting for a free pipeline slot */
+#define STAT_CONVERT	3	/* converters: samples to SEG Y floats */
+#define STAT_HEADER	4	/* converters: SEG Y trace headers */
+#define STAT_WRITE	5	/* writer: headers, traces, flushes, closes */
+#define STAT_NSTAGE	6
+
+#define STAT_TYPES	32	/* message types tallied one by one */
+
+typedef struct
+{
+  uint64_t ns;
+  uint64_t calls;
+  uint64_t bytes;
+} StatStage;
+
+typedef struct
+{
+  unsigned int type;
+  uint64_t messages;
+  uint64_t bytes;		/* header and payload */
+  uint64_t skipped;		/* payload bytes passed over unread */
+} StatType;
+
+typedef struct
+{
+  uint64_t start;		/* stats_clock() when the conversion began */
+  uint64_t every;		/* periodic report interval, ns, 0 none */
+  uint64_t next;		/* next periodic report is due */
+  StatStage stage[STAT_NSTAGE];
+  StatType type[STAT_TYPES + 1];	/* the last one for all other types */
+  int ntype;
+} JSFStats;
+
+void stats_init (JSFStats * s, int every);
+uint64_t stats_clock (void);
+uint64_t stats_time (JSFStats * s, int stage, uint64_t t0, uint64_t bytes);
+void stats_message (JSFStats * s, unsigned int type, uint64_t bytes);
+void stats_skip (JSFStats * s, unsigned int type, uint64_t bytes);
+int stats_due (JSFStats * s, uint64_t now);
+void stats_string (FILE * f, const char *str);
+int stats_write (FILE * out, const JSFStats * s, const char *head,
+		 int workers);
+
+#endif /* _JSFSTATS_H_ */
@@ -0,0 +1,426 @@
+/*
+ * jsfuring.c
+ *
+ * io_uring read-ahead buffer pool for the JSF reader.  See jsfuring.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "jsfuring.h"
+
+#define BUF_IDLE	0	/* nothing left to read into it */
+#define BUF_BUSY	1	/* read in flight */
+#define BUF_READY	2	/* read done, got bytes at off */
+
+typedef struct
+{
+  off_t off;			/* file offset of the first byte */
+  size_t want;			/* bytes asked for */
+  size_t got;			/* bytes read, 0 on error */
+  int state;
+} UringBuf;
+
+struct JSFUring
+{
+  int fd;			/* the file */
+  int ring;			/* the io_uring */
+  int fixed;			/* buffers registered, READ_FIXED */
+  off_t end;			/* file size */
+  off_t next;			/* file offset of the next read to queue */
+  int depth;
+  size_t bufsize;
+  int inflight;
+  unsigned queued;		/* reads queued but not yet submitted */
+  unsigned char *pool;		/* depth buffers of bufsize bytes */
+  UringBuf buf[URING_MAXDEPTH];
+
+  void *sq_ptr, *cq_ptr;
+  size_t sq_len, cq_len, sqes_len;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+};
+
+static int
+sys_setup (unsigned entries, struct io_uring_params *p)
+{
+  return (int) syscall (__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_enter (int ring, unsigned submit, unsigned wait, unsigned flags)
+{
+  return (int) syscall (__NR_io_uring_enter, ring, submit, wait, flags,
+			NULL, 0);
+}
+
+static int
+sys_register (int ring, unsigned op, void *arg, unsigned n)
+{
+  return (int) syscall (__NR_io_uring_register, ring, op, arg, n);
+}
+
+/*
+ * Map the submission and completion rings of u->ring
+ */
+
+static int
+map_rings (JSFUring * u, const struct io_uring_params *p)
+{
+  unsigned char *sq, *cq;
+
+  u->sq_len = p->sq_off.array + p->sq_entries * sizeof (unsigned);
+  u->cq_len = p->cq_off.cqes + p->cq_entries * sizeof (struct io_uring_cqe);
+  u->sqes_len = p->sq_entries * sizeof (struct io_uring_sqe);
+
+  u->sq_ptr = mmap (NULL, u->sq_len, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQ_RING);
+  u->cq_ptr = mmap (NULL, u->cq_len, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_CQ_RING);
+  u->sqes = (struct io_uring_sqe *) mmap (NULL, u->sqes_len,
+					  PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, u->ring,
+					  IORING_OFF_SQES);
+  if (u->sq_ptr == MAP_FAILED || u->cq_ptr == MAP_FAILED
+      || u->sqes == MAP_FAILED)
+    return -1;
+
+  sq = (unsigned char *) u->sq_ptr;
+  cq = (unsigned char *) u->cq_ptr;
+  u->sq_tail = (unsigned *) (sq + p->sq_off.tail);
+  u->sq_mask = (unsigned *) (sq + p->sq_off.ring_mask);
+  u->sq_array = (unsigned *) (sq + p->sq_off.array);
+  u->cq_head = (unsigned *) (cq + p->cq_off.head);
+  u->cq_tail = (unsigned *) (cq + p->cq_off.tail);
+  u->cq_mask = (unsigned *) (cq + p->cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *) (cq + p->cq_off.cqes);
+  return 0;
+}
+
+/*
+ * Queue a read of the next part of the file into buffer k.  At the end
+ * of the file the buffer is left idle.
+ */
+
+static void
+queue (JSFUring * u, int k)
+{
+  UringBuf *b = &u->buf[k];
+  struct io_uring_sqe *sqe;
+  unsigned tail, idx;
+
+  if (u->next >= u->end)
+    {
+      b->state = BUF_IDLE;
+      return;
+    }
+  b->off = u->next;
+  b->want = u->end - u->next < (off_t) u->bufsize
+    ? (size_t) (u->end - u->next) : u->bufsize;
+  b->got = 0;
+  b->state = BUF_BUSY;
+  u->next += (off_t) b->want;
+
+  tail = *u->sq_tail;
+  idx = tail & *u->sq_mask;
+  sqe = &u->sqes[idx];
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->opcode = u->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = u->fd;
+  sqe->addr = (unsigned long) (u->pool + (size_t) k * u->bufsize);
+  sqe->len = (unsigned) b->want;
+  sqe->off = (unsigned long long) b->off;
+  sqe->buf_index = (unsigned short) k;
+  sqe->user_data = (unsigned long long) k;
+  u->sq_array[idx] = idx;
+  __atomic_store_n (u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  u->queued++;
+  u->inflight++;
+}
+
+/*
+ * Submit what is queued and take in the completed reads, waiting for at
+ * least one if wait is set.  A failed read leaves its buffer empty, so
+ * that the bytes are pread() and the error reported there.
+ */
+
+static int
+reap (JSFUring * u, int wait)
+{
+  struct io_uring_cqe *cqe;
+  unsigned head, tail;
+  UringBuf *b;
+  int n;
+
+  if (u->queued || wait)
+    {
+      n = sys_enter (u->ring, u->queued, wait ? 1 : 0,
+		     wait ? IORING_ENTER_GETEVENTS : 0);
+      if (n == -1 && errno != EINTR)
+	return -1;
+      if (n > 0)
+	u->queued -= (unsigned) n;
+    }
+  head = *u->cq_head;
+  tail = __atomic_load_n (u->cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++)
+    {
+      cqe = &u->cqes[head & *u->cq_mask];
+      b = &u->buf[cqe->user_data];
+      b->got = cqe->res > 0 ? (size_t) cqe->res : 0;
+      b->state = BUF_READY;
+      u->inflight--;
+    }
+  __atomic_store_n (u->cq_head, head, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/*
+ * The buffer holding the file byte at pos, read or being read, or -1
+ */
+
+static int
+find (const JSFUring * u, off_t pos)
+{
+  int k;
+
+  for (k = 0; k < u->depth; k++)
+    if (u->buf[k].state != BUF_IDLE && pos >= u->buf[k].off
+	&& pos < u->buf[k].off + (off_t) u->buf[k].want)
+      return k;
+  return -1;
+}
+
+static int
+wait_for (JSFUring * u, int k)
+{
+  while (u->buf[k].state == BUF_BUSY)
+    if (reap (u, 1) == -1)
+      return -1;
+  return 0;
+}
+
+/*
+ * Read-ahead for fd from pos on: depth reads of bufsize bytes in flight
+ * (0 for the defaults).  Returns NULL, errno set, if io_uring is not to
+ * be had.
+ */
+
+JSFUring *
+uring_open (int fd, off_t pos, int depth, size_t bufsize)
+{
+  struct io_uring_params p;
+  struct iovec iov[URING_MAXDEPTH];
+  struct stat st;
+  JSFUring *u;
+  int k, err;
+
+  if (depth <= 0)
+    depth = URING_DEPTH;
+  if (depth > URING_MAXDEPTH)
+    depth = URING_MAXDEPTH;
+  if (bufsize == 0)
+    bufsize = URING_BUFSIZE;
+  bufsize = (bufsize + 4095) & ~(size_t) 4095;
+  if (fstat (fd, &st) == -1)
+    return NULL;
+  if ((u = (JSFUring *) calloc (1, sizeof (JSFUring))) == NULL)
+    return NULL;
+  u->fd = fd;
+  u->ring = -1;
+  u->depth = depth;
+  u->bufsize = bufsize;
+  u->end = st.st_size;
+  u->next = pos;
+  u->sq_ptr = u->cq_ptr = MAP_FAILED;
+  u->sqes = (struct io_uring_sqe *) MAP_FAILED;
+
+  memset (&p, 0, sizeof (p));
+  if ((u->ring = sys_setup ((unsigned) depth, &p)) == -1
+      || map_rings (u, &p) == -1
+      || posix_memalign ((void **) &u->pool, 4096,
+			 (size_t) depth * bufsize) != 0)
+    {
+      err = errno;
+      uring_close (u);
+      errno = err;
+      return NULL;
+    }
+
+  /*
+   * Registered buffers spare the kernel mapping the pages on every read;
+   * they count against the locked memory limit, so do without if need be
+   */
+
+  for (k = 0; k < depth; k++)
+    {
+      iov[k].iov_base = u->pool + (size_t) k * bufsize;
+      iov[k].iov_len = bufsize;
+    }
+  u->fixed = sys_register (u->ring, IORING_REGISTER_BUFFERS, iov,
+			   (unsigned) depth) == 0;
+
+  for (k = 0; k < depth; k++)
+    queue (u, k);
+  if (reap (u, 0) == -1)
+    {
+      err = errno;
+      uring_close (u);
+      errno = err;
+      return NULL;
+    }
+  return u;
+}
+
+/*
+ * n file bytes at pos.  *p points at them: in place in a buffer if they
+ * are all in one, otherwise copied to copy (n bytes).  Returns the
+ * number of bytes, fewer at the end of the file, or -1 on error.
+ */
+
+ssize_t
+uring_get (JSFUring * u, off_t pos, size_t n, const unsigned char **p,
+	   unsigned char *copy)
+{
+  UringBuf *b;
+  size_t done = 0, m;
+  ssize_t got;
+  off_t at;
+  int k;
+
+  if ((k = find (u, pos)) != -1)
+    {
+      b = &u->buf[k];
+      if (wait_for (u, k) == -1)
+	return -1;
+      if (pos + (off_t) n <= b->off + (off_t) b->got)
+	{
+	  *p = u->pool + (size_t) k * u->bufsize + (size_t) (pos - b->off);
+	  return (ssize_t) n;
+	}
+    }
+
+  while (done < n)
+    {
+      at = pos + (off_t) done;
+      if ((k = find (u, at)) != -1)
+	{
+	  b = &u->buf[k];
+	  if (wait_for (u, k) == -1)
+	    return -1;
+	  if (at < b->off + (off_t) b->got)
+	    {
+	      m = (size_t) (b->off + (off_t) b->got - at);
+	      if (m > n - done)
+		m = n - done;
+	      memcpy (copy + done,
+		      u->pool + (size_t) k * u->bufsize + (size_t) (at - b->off),
+		      m);
+	      done += m;
+	      continue;
+	    }
+	}
+
+      /*
+       * Not read ahead: past the pool, or the read came up short
+       */
+
+      got = pread (u->fd, copy + done, n - done, at);
+      if (got == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      if (got == 0)
+	break;
+      done += (size_t) got;
+    }
+  *p = copy;
+  return (ssize_t) done;
+}
+
+/*
+ * The caller is done with everything before pos: the buffers holding
+ * only such bytes are queued again for the file after the last read
+ * queued, or from pos on if that is further.
+ */
+
+int
+uring_release (JSFUring * u, off_t pos)
+{
+  UringBuf *b;
+  int k;
+
+  if (reap (u, 0) == -1)
+    return -1;
+  for (k = 0; k < u->depth; k++)
+    {
+      b = &u->buf[k];
+      if (b->state == BUF_BUSY
+	  || (b->state == BUF_READY && b->off + (off_t) b->want > pos))
+	continue;
+      if (u->next < pos)
+	u->next = pos;
+      queue (u, k);
+    }
+  return reap (u, 0);
+}
+
+/*
+ * Reading goes on from pos.  Forward in the file this is just a release;
+ * going back to bytes no longer held, the reads in flight are waited for
+ * and all of them queued again from pos.
+ */
+
+int
+uring_seek (JSFUring * u, off_t pos)
+{
+  int k;
+
+  if (pos >= u->next || find (u, pos) != -1)
+    return uring_release (u, pos);
+  while (u->inflight > 0)
+    if (reap (u, 1) == -1)
+      return -1;
+  u->next = pos;
+  for (k = 0; k < u->depth; k++)
+    queue (u, k);
+  return reap (u, 0);
+}
+
+void
+uring_close (JSFUring * u)
+{
+  if (u == NULL)
+    return;
+
+  /*
+   * Reads still in flight would land in the pool being freed
+   */
+
+  if (u->ring != -1)
+    {
+      while (u->inflight > 0 && u->sqes != MAP_FAILED)
+	if (reap (u, 1) == -1)
+	  break;
+      close (u->ring);
+    }
+  if (u->sqes != MAP_FAILED)
+    munmap (u->sqes, u->sqes_len);
+  if (u->cq_ptr != MAP_FAILED)
+    munmap (u->cq_ptr, u->cq_len);
+  if (u->sq_ptr != MAP_FAILED)
+    munmap (u->sq_ptr, u->sq_len);
+  free (u->pool);
+  free (u);
+}
@@ -0,0 +1,39 @@
+/*
+ * jsfuring.h
+ *
+ * io_uring read-ahead for the JSF reader (JSF_URING, jsfread.h).
+ *
+ * A pool of depth buffers of bufsize bytes each, registered with the
+ * kernel, is kept reading the file ahead of the parser: each buffer holds
+ * the next bufsize bytes after the one before, and as soon as the parser
+ * is past a buffer it is queued again for the next part of the file, so
+ * up to depth reads are in flight while the samples already read are
+ * converted.  Payloads wanted in place are views into a buffer when they
+ * lie in one; bytes spanning buffers are copied out to the caller, and
+ * anything not read ahead (past the pool, or after a jump) is pread().
+ *
+ * The ring is driven with the raw system calls, so nothing beyond the
+ * kernel headers is needed.  Where the buffers cannot be registered
+ * (locked memory limit) plain reads are queued instead.
+ */
+
+#ifndef _JSFURING_H_
+#define _JSFURING_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define URING_DEPTH	8	/* default reads in flight */
+#define URING_BUFSIZE	(1024 * 1024)	/* default bytes per read */
+#define URING_MAXDEPTH	64
+
+typedef struct JSFUring JSFUring;
+
+JSFUring *uring_open (int fd, off_t pos, int depth, size_t bufsize);
+ssize_t uring_get (JSFUring * u, off_t pos, size_t n,
+		   const unsigned char **p, unsigned char *copy);
+int uring_release (JSFUring * u, off_t pos);
+int uring_seek (JSFUring * u, off_t pos);
+void uring_close (JSFUring * u);
+
+#endif /* _JSFURING_H_ */
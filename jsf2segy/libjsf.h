@@ -0,0 +1,42 @@
+/*
+ * libjsf.h
+ *
+ * libjsf.a: the JSF parsing jsf2segy is built on, for the other tools
+ * to share.
+ *
+ *   byteio.h	little-endian field decoders for JSF headers
+ *   jsfread.h	reader context over read(), mmap() or a stream, stepping
+ *		from message to message, with jsf_iter() handing out views
+ *		of the header and as much of the payload as is wanted
+ *   jsfidx.h	.jsfidx message index sidecar
+ *   jsfseek.h	bisection for a ping by time or number, message resync
+ *
+ * A tool lists every message of a file with
+ *
+ *	JSFReader r;
+ *	JSFMessage m;
+ *
+ *	if (jsf_open (&r, path, JSF_MMAP) == -1)
+ *	  ...
+ *	while (jsf_iter (&r, &m, peek, NULL) == 1)
+ *	  ... m.type, m.subsystem, m.channel, m.hdr, m.payload ...
+ *	jsf_close (&r);
+ *
+ * where peek() returns the payload bytes it wants of each message.
+ * Link with libjsf.a (make libjsf.a).
+ */
+
+#ifndef _LIBJSF_H_
+#define _LIBJSF_H_
+
+#include "byteio.h"
+#include "jsfread.h"
+#include "jsfidx.h"
+#include "jsfseek.h"
+
+#define JSF_MARKER	0x1601	/* message header bytes 0-1 */
+#define JSF_SONAR	80	/* sonar data: subbottom and sidescan */
+#define JSF_SIDESCAN	82	/* sidescan data */
+#define JSF_SONARHDRLEN	240	/* sonar message header, before the samples */
+
+#endif /* _LIBJSF_H_ */
@@ -0,0 +1,310 @@
+/*
+ * lstjsf.c
+ *
+ * What an Edgetech .jsf file holds, before converting it: the number of
+ * subbottom pings of each data format (which of jsf2segy -e, -a, -r and
+ * -x apply) with their ping numbers, samples, sample interval and record
+ * sizes (each change of which starts a new SEG Y file), the sidescan
+ * pings of each subsystem and channel, and the time the pings span.
+ * With -l a line for each subbottom ping, with -s for each sidescan one.
+ *
+ * Only the 16 byte message headers and the first JSFSEEK_PEEK bytes of
+ * the 240 byte sonar headers are read (libjsf's jsf_iter()); payloads are
+ * passed over by their size, through a mapping of the file by default.
+ *
+ * Usage:	lstjsf [-l] [-s] [-r] file.jsf ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "libjsf.h"
+
+#define NFORMAT		16	/* subbottom data formats tallied */
+#define NSIZES		8	/* record sizes listed per format */
+#define NSIDESCAN	8	/* sidescan subsystem and channel pairs */
+
+typedef struct
+{
+  unsigned long pings;
+  unsigned long changes;	/* record size changes */
+  unsigned int ping_lo, ping_hi;
+  unsigned int nsamp_lo, nsamp_hi;
+  unsigned int dt_lo, dt_hi;	/* sample interval, ns */
+  uint32_t size;		/* record size of the last ping */
+  int nsizes;
+  uint32_t sizes[NSIZES];	/* distinct record sizes, first NSIZES */
+  unsigned long nsize[NSIZES];
+} Stats;
+
+typedef struct
+{
+  unsigned char subsystem;
+  unsigned char channel;
+  Stats s;
+} SideStats;
+
+static const char *format_name[NFORMAT] = {
+  "Envelope (-e)", "Analytic (-a, -x)", "Raw", "Real (-r)", "Pixel"
+};
+
+static int list_sb, list_ss;
+
+/*
+ * jsf_iter() peek function: the start of the sonar header of sonar
+ * messages, nothing of the rest
+ */
+
+static size_t
+peek (const JSFMessage * m, void *arg)
+{
+  (void) arg;
+  return (m->type == JSF_SONAR || m->type == JSF_SIDESCAN)
+    && m->size >= JSFSEEK_PEEK ? JSFSEEK_PEEK : 0;
+}
+
+/*
+ * Ping time, ms since 1970, as text; - for a ping without one
+ */
+
+static const char *
+when (int64_t ms)
+{
+  static char buf[64];
+  struct tm tm;
+  time_t sec = (time_t) (ms / 1000);
+
+  if (ms <= 0 || gmtime_r (&sec, &tm) == NULL)
+    return "-";
+  snprintf (buf, sizeof (buf), "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+	    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+	    tm.tm_min, tm.tm_sec, (int) (ms % 1000));
+  return buf;
+}
+
+static void
+add (Stats * s, const JSFMessage * m)
+{
+  const unsigned char *h = m->payload;
+  unsigned int ping = ld_le32 (h + 8), nsamp = ld_le16 (h + 114);
+  unsigned int dt = ld_le32 (h + 116);
+  uint32_t size = (uint32_t) m->size;
+  int k;
+
+  if (s->pings == 0)
+    {
+      s->ping_lo = s->ping_hi = ping;
+      s->nsamp_lo = s->nsamp_hi = nsamp;
+      s->dt_lo = s->dt_hi = dt;
+    }
+  else if (size != s->size)
+    s->changes++;
+  s->pings++;
+  s->size = size;
+  if (ping < s->ping_lo)
+    s->ping_lo = ping;
+  if (ping > s->ping_hi)
+    s->ping_hi = ping;
+  if (nsamp < s->nsamp_lo)
+    s->nsamp_lo = nsamp;
+  if (nsamp > s->nsamp_hi)
+    s->nsamp_hi = nsamp;
+  if (dt < s->dt_lo)
+    s->dt_lo = dt;
+  if (dt > s->dt_hi)
+    s->dt_hi = dt;
+  for (k = 0; k < s->nsizes; k++)
+    if (s->sizes[k] == size)
+      break;
+  if (k == s->nsizes && k < NSIZES)
+    s->sizes[s->nsizes++] = size;
+  if (k < NSIZES)
+    s->nsize[k]++;
+}
+
+static void
+range (const char *what, unsigned int lo, unsigned int hi)
+{
+  if (lo == hi)
+    fprintf (stdout, "  %s %u", what, lo);
+  else
+    fprintf (stdout, "  %s %u-%u", what, lo, hi);
+}
+
+static void
+report (const Stats * s)
+{
+  int k;
+
+  fprintf (stdout, "%lu pings", s->pings);
+  range ("ping", s->ping_lo, s->ping_hi);
+  range ("samples", s->nsamp_lo, s->nsamp_hi);
+  if (s->dt_lo == s->dt_hi)
+    fprintf (stdout, "  %g us\n", s->dt_lo / 1e3);
+  else
+    fprintf (stdout, "  %g-%g us\n", s->dt_lo / 1e3, s->dt_hi / 1e3);
+  fprintf (stdout, "      record sizes:");
+  for (k = 0; k < s->nsizes; k++)
+    fprintf (stdout, " %lu (%lu)", (unsigned long) s->sizes[k], s->nsize[k]);
+  if (s->nsizes == NSIZES)
+    fprintf (stdout, " ...");
+  fprintf (stdout, ", %lu changes\n", s->changes);
+}
+
+/*
+ * Inventory of path.  Returns 0, or -1 if it could not be read to the
+ * end.
+ */
+
+static int
+list (const char *path, int mode)
+{
+  static Stats sb[NFORMAT];
+  static SideStats ss[NSIDESCAN];
+  JSFReader r;
+  JSFMessage m;
+  const unsigned char *h;
+  unsigned long messages = 0, sensors = 0, other = 0;
+  unsigned long long bytes = 0;
+  int64_t t, t_lo = 0, t_hi = 0;
+  int nss = 0, fmt, k, ret, bad = 0;
+
+  if (jsf_open (&r, path, mode) == -1)
+    {
+      perror (path);
+      return -1;
+    }
+  memset (sb, 0, sizeof (sb));
+  memset (ss, 0, sizeof (ss));
+  m.offset = 0;
+  while ((ret = jsf_iter (&r, &m, peek, NULL)) == 1)
+    {
+      if (ld_le16 (m.hdr) != JSF_MARKER)
+	{
+	  fprintf (stderr, "%s: no message marker at byte %lld\n", path,
+		   (long long) m.offset);
+	  ret = -1;
+	  bad = 1;
+	  break;
+	}
+      messages++;
+      bytes += JSF_MSGHDRLEN + (unsigned long long) m.size;
+      if ((h = m.payload) == NULL)
+	{
+	  if (m.type >= 2000 && m.type < 2100)
+	    sensors++;
+	  else
+	    other++;
+	  continue;
+	}
+
+      t = jsfseek_key (h, JSFSEEK_TIME);
+      if (t > 0 && (t_lo == 0 || t < t_lo))
+	t_lo = t;
+      if (t > t_hi)
+	t_hi = t;
+      fmt = (int16_t) ld_le16 (h + 34);
+      if (m.type == JSF_SONAR && m.subsystem == 0)
+	{
+	  if (fmt >= 0 && fmt < NFORMAT)
+	    add (&sb[fmt], &m);
+	  if (list_sb)
+	    fprintf (stdout,
+		     "%12lld SB ping %8u fmt %2d samples %5u dt %6u ns size %8lu  %s\n",
+		     (long long) m.offset, ld_le32 (h + 8), fmt,
+		     ld_le16 (h + 114), ld_le32 (h + 116),
+		     (unsigned long) m.size, when (t));
+	  continue;
+	}
+      for (k = 0; k < nss; k++)
+	if (ss[k].subsystem == m.subsystem && ss[k].channel == m.channel)
+	  break;
+      if (k == nss && nss < NSIDESCAN)
+	{
+	  ss[k].subsystem = m.subsystem;
+	  ss[k].channel = m.channel;
+	  nss++;
+	}
+      if (k < NSIDESCAN)
+	add (&ss[k].s, &m);
+      if (list_ss)
+	fprintf (stdout,
+		 "%12lld SS ping %8u sub %3u chan %u samples %5u dt %6u ns size %8lu  %s\n",
+		 (long long) m.offset, ld_le32 (h + 8), m.subsystem, m.channel,
+		 ld_le16 (h + 114), ld_le32 (h + 116), (unsigned long) m.size,
+		 when (t));
+    }
+  if (ret == -1 && !bad)
+    fprintf (stderr, "%s: cannot read the message at byte %lld\n", path,
+	     (long long) m.offset);
+  jsf_close (&r);
+
+  fprintf (stdout, "%s: %lu messages, %llu bytes\n", path, messages, bytes);
+  for (fmt = 0; fmt < NFORMAT; fmt++)
+    if (sb[fmt].pings)
+      {
+	fprintf (stdout, "  Subbottom format %d %s: ", fmt,
+		 format_name[fmt] != NULL ? format_name[fmt] : "");
+	report (&sb[fmt]);
+      }
+  for (k = 0; k < nss; k++)
+    {
+      fprintf (stdout, "  Sidescan subsystem %u (%s) channel %u (%s): ",
+	       ss[k].subsystem, ss[k].subsystem == 20 ? "low frequency"
+	       : ss[k].subsystem == 21 ? "high frequency" : "other",
+	       ss[k].channel, ss[k].channel == 0 ? "port" : "starboard");
+      report (&ss[k].s);
+    }
+  if (t_hi > 0)
+    {
+      fprintf (stdout, "  Pings from %s", when (t_lo));
+      fprintf (stdout, " to %s (%.1f s)\n", when (t_hi), (t_hi - t_lo) / 1e3);
+    }
+  fprintf (stdout, "  %lu sensor messages, %lu other messages\n", sensors,
+	   other);
+  return ret == -1 ? -1 : 0;
+}
+
+static void
+usage (const char *prog)
+{
+  fprintf (stderr,
+	   "Usage: %s [-l] [-s] [-r] file.jsf ...\n"
+	   "\tLists the subbottom and sidescan pings of each file\n"
+	   "\t-l a line for each subbottom ping\n"
+	   "\t-s a line for each sidescan ping\n"
+	   "\t-r read() the headers instead of mapping the file\n", prog);
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int mode = JSF_MMAP, opt, k, status = EXIT_SUCCESS;
+
+  while ((opt = getopt (argc, argv, "lsr")) != -1)
+    {
+      switch (opt)
+	{
+	case 'l':
+	  list_sb = 1;
+	  break;
+	case 's':
+	  list_ss = 1;
+	  break;
+	case 'r':
+	  mode = JSF_READ;
+	  break;
+	default:
+	  usage (argv[0]);
+	}
+    }
+  if (optind >= argc)
+    usage (argv[0]);
+  for (k = optind; k < argc; k++)
+    if (list (argv[k], mode) == -1)
+      status = EXIT_FAILURE;
+  exit (status);
+}
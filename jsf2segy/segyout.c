@@ -0,0 +1,388 @@
+/*
+ * segyout.c
+ *
+ * Buffered, block aligned SEG Y output.  See segyout.h.
+ */
+
+#define _GNU_SOURCE		/* O_DIRECT, fallocate() */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "segyout.h"
+
+#define PMODE		0666	/* Read write permissons */
+
+/*
+ * pwritev() until everything is out; writev() for a stream
+ */
+
+static int
+pwritev_all (SegyOut * o, struct iovec *iov, int cnt, off_t pos)
+{
+  ssize_t n;
+
+  while (cnt > 0)
+    {
+      if (o->stream)
+	n = writev (o->fd, iov, cnt);
+      else
+	n = pwritev (o->fd, iov, cnt, pos);
+      if (n == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      if (n == 0)
+	{
+	  errno = EIO;
+	  return -1;
+	}
+      pos += n;
+      while (cnt > 0 && (size_t) n >= iov->iov_len)
+	{
+	  n -= iov->iov_len;
+	  iov++;
+	  cnt--;
+	}
+      if (cnt > 0)
+	{
+	  iov->iov_base = (char *) iov->iov_base + n;
+	  iov->iov_len -= n;
+	}
+    }
+  return 0;
+}
+
+/*
+ * Create path, which must not exist yet.  block is rounded up to a
+ * multiple of SEGY_ALIGN; 0 means SEGY_BLOCK.  Returns NULL with errno
+ * set on failure.
+ */
+
+SegyOut *
+segy_open (const char *path, size_t block, int direct)
+{
+  SegyOut *o;
+  int err;
+
+  if (block == 0)
+    block = SEGY_BLOCK;
+  block = (block + SEGY_ALIGN - 1) / SEGY_ALIGN * SEGY_ALIGN;
+
+  if ((o = (SegyOut *) calloc (1, sizeof (SegyOut))) == NULL)
+    return NULL;
+  if ((errno = posix_memalign ((void **) &o->buf, SEGY_ALIGN, block)) != 0)
+    {
+      free (o);
+      return NULL;
+    }
+  o->bufsize = block;
+
+  o->fd = -1;
+  if (direct)
+    {
+      o->fd = open (path, O_WRONLY | O_CREAT | O_EXCL | O_DIRECT, PMODE);
+      if (o->fd != -1)
+	o->direct = 1;
+      else if (errno == EINVAL)
+	{
+	  /*
+	   * No O_DIRECT on this file system.  The file may have been
+	   * created before the flag was refused.
+	   */
+	  (void) unlink (path);
+	  direct = 0;
+	}
+    }
+  if (!direct)
+    o->fd = open (path, O_WRONLY | O_CREAT | O_EXCL, PMODE);
+  if (o->fd == -1)
+    {
+      err = errno;
+      free (o->buf);
+      free (o);
+      errno = err;
+      return NULL;
+    }
+  return o;
+}
+
+/*
+ * Write to fd, which is already open and is closed by segy_close().
+ * Returns NULL with errno set on failure.
+ */
+
+SegyOut *
+segy_fdopen (int fd, size_t block)
+{
+  SegyOut *o;
+
+  if (block == 0)
+    block = SEGY_BLOCK;
+  if ((o = (SegyOut *) calloc (1, sizeof (SegyOut))) == NULL)
+    return NULL;
+  if ((o->buf = (unsigned char *) malloc (block)) == NULL)
+    {
+      free (o);
+      return NULL;
+    }
+  o->bufsize = block;
+  o->fd = fd;
+  o->stream = 1;
+  return o;
+}
+
+/*
+ * Write into path, which must exist, from offset pos on.  Returns NULL
+ * with errno set on failure.
+ */
+
+SegyOut *
+segy_open_at (const char *path, off_t pos, size_t block)
+{
+  SegyOut *o;
+  int err;
+
+  if (block == 0)
+    block = SEGY_BLOCK;
+  if ((o = (SegyOut *) calloc (1, sizeof (SegyOut))) == NULL)
+    return NULL;
+  if ((o->buf = (unsigned char *) malloc (block)) == NULL)
+    {
+      free (o);
+      return NULL;
+    }
+  o->bufsize = block;
+  if ((o->fd = open (path, O_WRONLY)) == -1)
+    {
+      err = errno;
+      free (o->buf);
+      free (o);
+      errno = err;
+      return NULL;
+    }
+  o->pos = pos;
+  return o;
+}
+
+/*
+ * Write out the whole blocks in buf
+ */
+
+static int
+flush_block (SegyOut * o)
+{
+  struct iovec iov;
+
+  iov.iov_base = o->buf;
+  iov.iov_len = o->fill;
+  if (pwritev_all (o, &iov, 1, o->pos) == -1)
+    return -1;
+  o->pos += o->fill;
+  o->fill = 0;
+  return 0;
+}
+
+int
+segy_write (SegyOut * o, const void *p, size_t n)
+{
+  const unsigned char *src = (const unsigned char *) p;
+  struct iovec iov[2];
+  size_t take, out;
+
+  while (n > 0)
+    {
+      if (o->fill + n < o->bufsize)
+	{
+	  memcpy (o->buf + o->fill, src, n);
+	  o->fill += n;
+	  return 0;
+	}
+
+      if (!o->direct)
+	{
+	  /*
+	   * The block and as much of the piece as makes whole blocks,
+	   * in one call and without copying the piece
+	   */
+
+	  out = (o->fill + n) / o->bufsize * o->bufsize;
+	  iov[0].iov_base = o->buf;
+	  iov[0].iov_len = o->fill;
+	  iov[1].iov_base = (void *) src;
+	  iov[1].iov_len = out - o->fill;
+	  if (pwritev_all (o, iov, 2, o->pos) == -1)
+	    return -1;
+	  src += out - o->fill;
+	  n -= out - o->fill;
+	  o->pos += out;
+	  o->fill = 0;
+	  continue;
+	}
+
+      take = o->bufsize - o->fill;
+      memcpy (o->buf + o->fill, src, take);
+      o->fill += take;
+      src += take;
+      n -= take;
+      if (flush_block (o) == -1)
+	return -1;
+    }
+  return 0;
+}
+
+/*
+ * Reserve space for a file of bytes bytes.  A hint only: failures are
+ * not errors for the caller to act on, but are returned.
+ */
+
+int
+segy_prealloc (SegyOut * o, off_t bytes)
+{
+  if (o->stream)
+    {
+      errno = ESPIPE;
+      return -1;
+    }
+  if (o->direct)
+    bytes = (bytes + SEGY_ALIGN - 1) / SEGY_ALIGN * SEGY_ALIGN;
+  return fallocate (o->fd, FALLOC_FL_KEEP_SIZE, 0, bytes);
+}
+
+/*
+ * Write the partial block in place, keeping it in buf.  With direct I/O
+ * it goes out padded to a page and the file is cut back to its length.
+ */
+
+int
+segy_flush (SegyOut * o)
+{
+  struct iovec iov;
+  size_t len = o->fill;
+
+  if (o->fill == 0)
+    return 0;
+  if (o->stream)
+    return flush_block (o);
+  if (o->direct)
+    {
+      len = (o->fill + SEGY_ALIGN - 1) / SEGY_ALIGN * SEGY_ALIGN;
+      memset (o->buf + o->fill, 0, len - o->fill);
+    }
+  iov.iov_base = o->buf;
+  iov.iov_len = len;
+  if (pwritev_all (o, &iov, 1, o->pos) == -1)
+    return -1;
+  if (o->direct && ftruncate (o->fd, o->pos + (off_t) o->fill) == -1)
+    return -1;
+  return 0;
+}
+
+/*
+ * Overwrite n bytes at offset, which must already have been passed to
+ * segy_write().  The copy in buf, if any, is patched too.
+ */
+
+int
+segy_patch (SegyOut * o, off_t offset, const void *p, size_t n)
+{
+  const unsigned char *src = (const unsigned char *) p;
+  size_t k;
+  ssize_t w;
+
+  if (o->stream)
+    {
+      errno = ESPIPE;
+      return -1;
+    }
+  if (offset + (off_t) n > o->pos + (off_t) o->fill)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  /*
+   * The part still in the block
+   */
+
+  for (k = 0; k < n; k++)
+    if (offset + (off_t) k >= o->pos)
+      o->buf[offset + (off_t) k - o->pos] = src[k];
+
+  /*
+   * The part already in the file
+   */
+
+  if (offset < o->pos)
+    {
+      if (o->direct)
+	{
+	  errno = EINVAL;
+	  return -1;
+	}
+      if (offset + (off_t) n > o->pos)
+	n = (size_t) (o->pos - offset);
+      while (n > 0)
+	{
+	  if ((w = pwrite (o->fd, src, n, offset)) == -1)
+	    {
+	      if (errno == EINTR)
+		continue;
+	      return -1;
+	    }
+	  src += w;
+	  offset += w;
+	  n -= (size_t) w;
+	}
+    }
+  return 0;
+}
+
+/*
+ * Flush what is left, close and free o.  Returns -1 with errno set if
+ * anything could not be written.
+ */
+
+int
+segy_close (SegyOut * o)
+{
+  off_t len;
+  size_t pad;
+  int ret = 0, err = 0;
+
+  len = o->pos + (off_t) o->fill;
+  if (o->fill > 0)
+    {
+      if (o->direct)
+	{
+	  pad = (o->fill + SEGY_ALIGN - 1) / SEGY_ALIGN * SEGY_ALIGN;
+	  memset (o->buf + o->fill, 0, pad - o->fill);
+	  o->fill = pad;
+	}
+      if (flush_block (o) == -1)
+	{
+	  ret = -1;
+	  err = errno;
+	}
+      else if (o->direct && ftruncate (o->fd, len) == -1)
+	{
+	  ret = -1;
+	  err = errno;
+	}
+    }
+  if (close (o->fd) == -1 && ret == 0)
+    {
+      ret = -1;
+      err = errno;
+    }
+  free (o->buf);
+  free (o);
+  errno = err;
+  return ret;
+}
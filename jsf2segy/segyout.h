@@ -0,0 +1,69 @@
+/*
+ * segyout.h
+ *
+ * Buffered SEG Y output.  Headers and traces are packed into one large
+ * block (1 MB by default) and the file is written a whole block at a
+ * time at block aligned offsets, instead of two small write()s per
+ * trace.  Network and parallel file systems do far better with that.
+ *
+ * Without direct I/O a piece too big to fit in what is left of the block
+ * is not copied: the block and the piece go out together with one
+ * pwritev(), and only the tail of the piece past the last whole block is
+ * kept.  With direct I/O (O_DIRECT) the block is page aligned and every
+ * byte goes through it; the last, partial block is written padded to a
+ * page and the file then cut back to its true length.  If the file system
+ * refuses O_DIRECT the file is written buffered instead.
+ *
+ * segy_fdopen() writes to an open descriptor instead, standard output
+ * in a pipeline for instance.  Blocks then go out in order with writev()
+ * at the descriptor's own position, so pipes work, and there is no
+ * direct I/O or preallocation.
+ *
+ * segy_open_at() writes one piece of a file that others write the rest
+ * of, from a given offset on, for --split: the file must exist, and the
+ * piece goes out buffered, without direct I/O.
+ *
+ * segy_flush() makes everything written so far visible in the file for
+ * readers following it, without giving up the block alignment: the
+ * partial block is written in place and kept, to be written again once
+ * it fills.  segy_patch() overwrites bytes already written, such as a
+ * count in the binary header.  Neither works on a stream or with direct
+ * I/O once the bytes have left the block.
+ *
+ * segy_prealloc() reserves disk space when the final size is known
+ * (from a message index), without changing the file size.
+ *
+ * Write errors may show up on a later segy_write() or only at
+ * segy_close(); each returns -1 with errno set.
+ */
+
+#ifndef _SEGYOUT_H_
+#define _SEGYOUT_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define SEGY_BLOCK	(1024 * 1024)	/* default output block */
+#define SEGY_ALIGN	4096		/* O_DIRECT buffer and length alignment */
+
+typedef struct
+{
+  int fd;
+  int direct;			/* opened with O_DIRECT */
+  int stream;			/* segy_fdopen(): write(), not pwrite() */
+  unsigned char *buf;		/* block being filled */
+  size_t bufsize;
+  size_t fill;			/* bytes in buf */
+  off_t pos;			/* file offset of buf[0] */
+} SegyOut;
+
+SegyOut *segy_open (const char *path, size_t block, int direct);
+SegyOut *segy_fdopen (int fd, size_t block);
+SegyOut *segy_open_at (const char *path, off_t pos, size_t block);
+int segy_write (SegyOut * o, const void *p, size_t n);
+int segy_prealloc (SegyOut * o, off_t bytes);
+int segy_flush (SegyOut * o);
+int segy_patch (SegyOut * o, off_t offset, const void *p, size_t n);
+int segy_close (SegyOut * o);
+
+#endif /* _SEGYOUT_H_ */